@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui network svg multimedia serialport
 config   += console
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -15,17 +15,88 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# Compile the qCDebug/qCInfo call sites out completely (qmake CONFIG+=breather_nolog).
+# Without it they stay in and reduce to a single branch while their category is disabled.
+breather_nolog: DEFINES += QT_NO_DEBUG_OUTPUT QT_NO_INFO_OUTPUT
+
 SOURCES += \
+    artworkcache.cpp \
+    audioengine.cpp \
+    audiosink.cpp \
+    benchmark.cpp \
+    breathdetector.cpp \
+    breathsensor.cpp \
+    breathsignal.cpp \
+    colorramp.cpp \
+    cyclecache.cpp \
+    deviceaudiosink.cpp \
+    deviceaudiosource.cpp \
     dialog.cpp \
+    eventlog.cpp \
+    glowcache.cpp \
+    historyexporter.cpp \
+    inputshape.cpp \
+    logging.cpp \
     main.cpp \
     mainwindow.cpp \
-    mode.cpp
+    metrics.cpp \
+    mode.cpp \
+    overlaywindow.cpp \
+    pacingschedule.cpp \
+    particlesystem.cpp \
+    phaselabel.cpp \
+    qualitygovernor.cpp \
+    rasteroverlay.cpp \
+    reminderscheduler.cpp \
+    renderer.cpp \
+    sessionclock.cpp \
+    sessionexporter.cpp \
+    sessionstats.cpp \
+    shapemorph.cpp \
+    shaperegistry.cpp \
+    wavsink.cpp \
+    wavsource.cpp
 
 HEADERS += \
+    artworkcache.h \
+    audioengine.h \
+    audiosink.h \
+    benchmark.h \
+    audiosource.h \
+    breathdetector.h \
+    breathsensor.h \
+    breathsignal.h \
+    colorramp.h \
+    cyclecache.h \
     defaults.h \
+    deviceaudiosink.h \
+    deviceaudiosource.h \
     dialog.h \
+    eventlog.h \
+    glowcache.h \
+    historyexporter.h \
+    inputshape.h \
+    logging.h \
     mainwindow.h \
-    mode.h
+    metrics.h \
+    mode.h \
+    overlaywindow.h \
+    pacingschedule.h \
+    particlesystem.h \
+    phaselabel.h \
+    qualitygovernor.h \
+    rasteroverlay.h \
+    reminderscheduler.h \
+    renderer.h \
+    ringbuffer.h \
+    sessionclock.h \
+    sessionexporter.h \
+    sessionstats.h \
+    shapemorph.h \
+    shapeprovider.h \
+    shaperegistry.h \
+    wavsink.h \
+    wavsource.h
 
 FORMS += \
     dialog.ui \
@@ -0,0 +1,195 @@
+#include "artworkcache.h"
+#include "metrics.h"
+#include "logging.h"
+#include <QPainter>
+#include <QSvgRenderer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+
+/*!
+ * \brief The ArtworkLevelBuilder class Rasterizes one level on the cache's thread pool
+ */
+class ArtworkLevelBuilder : public QRunnable
+{
+public:
+    ArtworkLevelBuilder(ArtworkCache *cache, int level) : cache(cache), level(level) {}
+
+    void run() override
+    {
+        cache->levelBuilt(level, cache->rasterize(level));
+    }
+
+private:
+    ArtworkCache *cache;
+    int level;
+};
+
+/*!
+ * \brief ArtworkCache::ArtworkCache Constructor, builds the smallest level right away
+ * \param file .svg or any image format Qt reads
+ * \param budgetBytes
+ */
+ArtworkCache::ArtworkCache(const QString &file, qint64 budgetBytes)
+    : budgetBytes(budgetBytes)
+{
+    // One level at a time per artwork, the nearest ready level is drawn meanwhile
+    builders.setMaxThreadCount(1);
+    if (QFileInfo(file).suffix().compare("svg", Qt::CaseInsensitive) == 0)
+    {
+        QFile source(file);
+        if (source.open(QIODevice::ReadOnly)) svg = source.readAll();
+        QSvgRenderer renderer(svg);
+        if (renderer.isValid()) sourceSize = renderer.defaultSize();
+        else svg.clear();
+    }
+    else
+    {
+        bitmap = QImage(file).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        sourceSize = bitmap.size();
+    }
+    if (!isValid())
+    {
+        qCWarning(lcMain) << Q_FUNC_INFO << "cannot read" << file;
+        return;
+    }
+    levelBuilt(MIN_LEVEL_PX, rasterize(MIN_LEVEL_PX));
+}
+
+/*!
+ * \brief ArtworkCache::~ArtworkCache Destructor, waits for levels still being built
+ */
+ArtworkCache::~ArtworkCache()
+{
+    mutex.lock();
+    closing = true;
+    mutex.unlock();
+    builders.waitForDone();
+    Metrics::artworkCacheBytes(-bytes);
+}
+
+/*!
+ * \brief ArtworkCache::isValid
+ * \return False if the file could not be read
+ */
+bool ArtworkCache::isValid() const
+{
+    return !sourceSize.isEmpty();
+}
+
+/*!
+ * \brief ArtworkCache::levelFor Level to draw a target size from: its longer side rounded up to a power of two
+ * \param size
+ * \return
+ */
+int ArtworkCache::levelFor(const QSize &size)
+{
+    int longer = qMax(size.width(), size.height());
+    int level = MIN_LEVEL_PX;
+    while (level < longer && level < MAX_LEVEL_PX) level *= 2;
+    return level;
+}
+
+/*!
+ * \brief ArtworkCache::rasterize Render the artwork with its longer side at the level size
+ * \param level
+ * \return
+ */
+QImage ArtworkCache::rasterize(int level) const
+{
+    QSize size = sourceSize.scaled(level, level, Qt::KeepAspectRatio);
+    if (!svg.isEmpty())
+    {
+        QImage image(size, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QSvgRenderer renderer(svg);
+        QPainter qp(&image);
+        renderer.render(&qp);
+        return image;
+    }
+    return bitmap.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+/*!
+ * \brief ArtworkCache::levelBuilt Store a rasterized level, evicting least recently used ones over the budget
+ * \param level
+ * \param image
+ */
+void ArtworkCache::levelBuilt(int level, const QImage &image)
+{
+    QMutexLocker lock(&mutex);
+    pending.remove(level);
+    if (closing || image.isNull()) return;
+    levels.insert(level, image);
+    lastUse.insert(level, ++useCounter);
+    qint64 added = image.sizeInBytes();
+    bytes += added;
+    while (bytes > budgetBytes && levels.size() > 1)
+    {
+        // Never the smallest level, it is the fallback for everything else
+        int oldest = 0;
+        quint64 oldestUse = ~quint64(0);
+        for (auto it = lastUse.constBegin(); it != lastUse.constEnd(); ++it)
+            if (it.key() != MIN_LEVEL_PX && it.key() != level && it.value() < oldestUse)
+            {
+                oldest = it.key();
+                oldestUse = it.value();
+            }
+        if (!oldest) break;
+        qint64 freed = levels.take(oldest).sizeInBytes();
+        lastUse.remove(oldest);
+        bytes -= freed;
+        added -= freed;
+    }
+    Metrics::artworkCacheBytes(added);
+}
+
+/*!
+ * \brief ArtworkCache::draw Filtered blit of the best ready level onto the rect
+ *  The painter's brush alpha is the shape transparency and applies to the artwork as a whole;
+ *  a pen, e.g. the focus outline, is drawn around the rect.
+ * \param qp
+ * \param xywh
+ */
+void ArtworkCache::draw(QPainter &qp, const QRect &xywh)
+{
+    if (!isValid() || xywh.isEmpty()) return;
+    int wanted = levelFor(xywh.size());
+    QImage image;
+    {
+        QMutexLocker lock(&mutex);
+        if (levels.isEmpty()) return;
+        int used = wanted;
+        auto exact = levels.constFind(wanted);
+        bool hit = exact != levels.constEnd();
+        Metrics::artworkLookup(hit);
+        if (hit) image = *exact;
+        else
+        {
+            if (!pending.contains(wanted))
+            {
+                pending.insert(wanted);
+                builders.start(new ArtworkLevelBuilder(this, wanted));
+            }
+            // Nearest ready level meanwhile: the next larger one if there is any, else the largest smaller one
+            auto nearest = levels.lowerBound(wanted);
+            if (nearest == levels.end()) --nearest;
+            used = nearest.key();
+            image = nearest.value();
+        }
+        lastUse[used] = ++useCounter;
+    }
+
+    qp.save();
+    qp.setRenderHint(QPainter::SmoothPixmapTransform);
+    qp.setOpacity(qp.opacity() * qp.brush().color().alphaF());
+    qp.drawImage(xywh, image);
+    qp.restore();
+    if (qp.pen().style() != Qt::NoPen)
+    {
+        qp.save();
+        qp.setBrush(Qt::NoBrush);
+        qp.drawRect(xywh);
+        qp.restore();
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef ARTWORKCACHE_H
+#define ARTWORKCACHE_H
+
+#include <QString>
+#include <QImage>
+#include <QByteArray>
+#include <QRect>
+#include <QMutex>
+#include <QMap>
+#include <QSet>
+#include <QThreadPool>
+
+class QPainter;
+
+/*!
+ * \brief The ArtworkCache class SVG or bitmap artwork drawn as a shape, from a mipmapped raster cache
+ *  Levels are the artwork rasterized with its longer side at a power of two between MIN_LEVEL_PX
+ *  and MAX_LEVEL_PX. A frame draws the smallest ready level at least as large as the target with
+ *  a filtered blit; a missing level is rasterized on the cache's own thread pool meanwhile, and the
+ *  nearest ready one is used until then. The smallest level is built up front so there is always
+ *  something to draw. Least recently used levels are dropped when over the memory budget.
+ *  Safe to draw from several threads at once.
+ */
+class ArtworkCache
+{
+public:
+    static const int MIN_LEVEL_PX = 32;
+    static const int MAX_LEVEL_PX = 2048;
+
+    ArtworkCache(const QString &file, qint64 budgetBytes);
+    ~ArtworkCache();
+
+    bool isValid() const;
+    void draw(QPainter &qp, const QRect &xywh);
+
+    static int levelFor(const QSize &size);
+
+private:
+    friend class ArtworkLevelBuilder;
+    QImage rasterize(int level) const;
+    void levelBuilt(int level, const QImage &image);
+
+    QByteArray svg;            ///< SVG source, rasterized with a fresh QSvgRenderer per level
+    QImage bitmap;             ///< Bitmap source, scaled per level
+    QSize sourceSize;          ///< Natural size, gives the aspect ratio of every level
+    qint64 budgetBytes;        ///< Upper limit for all levels together
+    QThreadPool builders;      ///< Runs this cache's level builds, so closing waits for nothing else
+
+    QMutex mutex;              ///< Guards everything below
+    QMap<int,QImage> levels;   ///< Ready levels by longer side in pixels
+    QMap<int,quint64> lastUse; ///< Use stamp of every ready level, for eviction
+    QSet<int> pending;         ///< Levels being built
+    quint64 useCounter = 0;
+    qint64 bytes = 0;          ///< Memory taken by the ready levels
+    bool closing = false;      ///< Set by the destructor, pending builds drop their result
+};
+
+#endif // ARTWORKCACHE_H
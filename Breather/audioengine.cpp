@@ -0,0 +1,257 @@
+#include "audioengine.h"
+#include "audiosink.h"
+#include "sessionclock.h"
+#include "mode.h"
+#include "logging.h"
+#include <QThread>
+#include <QMutex>
+#include <QtMath>
+#include <atomic>
+
+namespace
+{
+
+const float TONE_LOW_HZ  = 196;   ///< Pitch of the tone at a completed ratio of 0
+const float TONE_HIGH_HZ = 392;   ///< Pitch of the tone at a completed ratio of 1, an octave up
+const float TONE_GAIN    = 0.12f;
+const float CUE_GAIN     = 0.45f;
+const quint32 CUE_MS     = 120;
+
+}
+
+/*!
+ * \brief The AudioSynth class Renders blocks ahead of the sink from a snapshot of the modes
+ */
+class AudioSynth : public QThread
+{
+public:
+    AudioStream stream;
+    std::atomic<bool> running {false};
+    QMutex mutex;          ///< Guards modes and clock, which sync() replaces from the GUI thread
+    QList<Mode*> modes;    ///< Private copies, the GUI may edit its own modes at any time
+    SessionClock clock;
+    quint8 features = 0;
+    quint32 latencyMS = 0; ///< Sink latency, frames are rendered for the time they are heard
+    quint64 produced = 0;  ///< Frames rendered since start
+    quint8 lastMode = 0xFF;
+    float phase = 0;
+    QVector<qint16> cues[4];
+    const qint16 *cuePos = nullptr;
+    int cueLeft = 0;
+    qint16 block[AudioEngine::BLOCK];
+
+    ~AudioSynth() override
+    {
+        qDeleteAll(modes);
+    }
+
+    /*!
+     * \brief adopt Take a snapshot of the cycle and align its clock so active has elapsed progress now
+     *  A pacing schedule of the session clock is followed as well, its table is shared read-only.
+     */
+    void adopt(Mode *first, Mode *active, quint32 elapsedInModeMS, const SessionClock *session)
+    {
+        QList<Mode*> copies;
+        Mode *mode = first, *activeCopy = nullptr;
+        do
+        {
+            Mode *copy = new Mode(mode->getMode());
+            copy->copySettings(mode);
+            if (!copies.isEmpty()) copies.last()->setNext(copy);
+            copies.append(copy);
+            if (mode == active) activeCopy = copy;
+            mode = mode->getNext();
+        } while (mode && mode != first);
+        copies.last()->setNext(copies.first());
+
+        QMutexLocker lock(&mutex);
+        clock.setFirstMode(copies.first());
+        if (session) clock.follow(*session);
+        clock.rebase(activeCopy, elapsedInModeMS);
+        qDeleteAll(modes);
+        modes = copies;
+    }
+
+    /*!
+     * \brief startCue Mix the cue of a mode in from the next frame on
+     */
+    void startCue(Mode *mode)
+    {
+        if (!(features & AudioEngine::Cues)) return;
+        const QVector<qint16> &cue = cues[mode->getMode() & 3];
+        cuePos = cue.constData();
+        cueLeft = cue.size();
+    }
+
+    /*!
+     * \brief synthesize Render the next block for the session time its first frame will be heard at
+     */
+    void synthesize()
+    {
+        QMutexLocker lock(&mutex);
+        // Frames the sink filled with silence were heard too, skip them to stay on the session clock
+        quint64 frame = produced + stream.underrunFrames.load(std::memory_order_relaxed);
+        qint64 startMS = qint64(frame * 1000 / AudioSink::SAMPLE_RATE) + latencyMS;
+        quint32 startElapsed, endElapsed;
+        Mode *mode = clock.locate(startMS, startElapsed);
+        Mode *endMode = clock.locate(startMS + AudioEngine::BLOCK * 1000 / AudioSink::SAMPLE_RATE, endElapsed);
+
+        // Frame of the block the next phase starts on, BLOCK when it does not start in this block
+        quint32 changeAt = AudioEngine::BLOCK;
+        if (endMode != mode)
+            changeAt = AudioEngine::BLOCK - qMin<quint32>(AudioEngine::BLOCK, endElapsed * AudioSink::SAMPLE_RATE / 1000);
+        if (mode->getMode() != lastMode) startCue(mode);
+
+        float fromHz = TONE_LOW_HZ + (TONE_HIGH_HZ - TONE_LOW_HZ) * mode->getRatioCompleted(startElapsed);
+        float toHz = endMode == mode ? TONE_LOW_HZ + (TONE_HIGH_HZ - TONE_LOW_HZ) * mode->getRatioCompleted(endElapsed) : fromHz;
+        const float step = float(2 * M_PI) / AudioSink::SAMPLE_RATE;
+        for (quint32 i = 0; i < AudioEngine::BLOCK; i++)
+        {
+            if (i == changeAt) startCue(endMode);
+            float sample = 0;
+            if (features & AudioEngine::Tone)
+            {
+                phase += step * (fromHz + (toHz - fromHz) * i / AudioEngine::BLOCK);
+                if (phase > float(2 * M_PI)) phase -= float(2 * M_PI);
+                sample += TONE_GAIN * qSin(phase) * 32767;
+            }
+            if (cueLeft > 0)
+            {
+                sample += *cuePos++;
+                cueLeft--;
+            }
+            block[i] = qint16(qBound(-32768.0f, sample, 32767.0f));
+        }
+        lastMode = endMode->getMode();
+        produced += AudioEngine::BLOCK;
+    }
+
+    /*!
+     * \brief fill Render blocks until AHEAD_FRAMES are queued
+     */
+    void fill()
+    {
+        while (AudioStream::CAPACITY - stream.ring.space() + AudioEngine::BLOCK <= AudioEngine::AHEAD_FRAMES)
+        {
+            synthesize();
+            stream.ring.write(block, AudioEngine::BLOCK);
+        }
+    }
+
+protected:
+    void run() override
+    {
+        while (running.load(std::memory_order_acquire))
+        {
+            fill();
+            msleep(2);
+        }
+    }
+};
+
+/*!
+ * \brief AudioEngine::AudioEngine Constructor
+ * \param features Feature flags
+ * \param sink Taken over, deleted with the engine
+ */
+AudioEngine::AudioEngine(quint8 features, AudioSink *sink)
+    : synth(new AudioSynth)
+    , sink(sink)
+{
+    synth->features = features;
+    for (quint8 mode = 0; mode < 4; mode++)
+        synth->cues[mode] = cue(mode);
+}
+
+/*!
+ * \brief AudioEngine::~AudioEngine Destructor
+ */
+AudioEngine::~AudioEngine()
+{
+    stop();
+    delete synth;
+    delete sink;
+}
+
+/*!
+ * \brief AudioEngine::cue Synthesize the cue of a phase: a short plucked tone, higher while breathing in
+ * \param mode
+ * \return Mono samples at AudioSink::SAMPLE_RATE
+ */
+QVector<qint16> AudioEngine::cue(quint8 mode)
+{
+    static const float pitchHz[4] = { 660, 550, 440, 495 }; // Inhale, HoldIn, Exhale, HoldOut
+    QVector<qint16> samples(AudioSink::SAMPLE_RATE * CUE_MS / 1000);
+    const float hz = pitchHz[mode & 3];
+    const float attack = AudioSink::SAMPLE_RATE * 0.005f;
+    for (int i = 0; i < samples.size(); i++)
+    {
+        float t = float(i) / AudioSink::SAMPLE_RATE;
+        float envelope = qMin(1.0f, i / attack) * qExp(-t * 30);
+        samples[i] = qint16(CUE_GAIN * envelope * qSin(2 * float(M_PI) * hz * t) * 32767);
+    }
+    return samples;
+}
+
+/*!
+ * \brief AudioEngine::start Start playing from the given point of the cycle
+ * \param first Mode the cycle starts with
+ * \param active Mode active right now
+ * \param elapsedInModeMS Progress of the active mode right now
+ * \param session Session clock whose pacing schedule to follow, if any
+ * \return False when the sink could not be started
+ */
+bool AudioEngine::start(Mode *first, Mode *active, quint32 elapsedInModeMS, const SessionClock *session)
+{
+    stop();
+    if (!first || !active) return false;
+    synth->clock.start();
+    synth->adopt(first, active, elapsedInModeMS, session);
+    // The first frames are queued before the sink starts, so they are heard at session time 0 of the
+    // engine; they are rendered for the latency the sink expects to have
+    synth->latencyMS = sink->latencyMS();
+    synth->fill();
+    if (!sink->start(&synth->stream))
+    {
+        synth->stream.ring.clear();
+        return false;
+    }
+    // The backend may have settled on another buffer, the queued frames are off by the difference
+    synth->latencyMS = sink->latencyMS();
+    synth->running.store(true, std::memory_order_release);
+    synth->start(QThread::HighPriority);
+    running = true;
+    qCInfo(lcMain) << "Audio started, sink latency" << synth->latencyMS << "ms";
+    return true;
+}
+
+/*!
+ * \brief AudioEngine::stop Silence the sink and reset the sample clock
+ */
+void AudioEngine::stop()
+{
+    if (!running) return;
+    synth->running.store(false, std::memory_order_release);
+    synth->wait();
+    sink->stop();
+    synth->stream.ring.clear();
+    synth->stream.underrunFrames.store(0, std::memory_order_relaxed);
+    synth->produced = 0;
+    synth->lastMode = 0xFF;
+    synth->cueLeft = 0;
+    running = false;
+}
+
+/*!
+ * \brief AudioEngine::sync Follow changed settings or a rebased session clock
+ *  Frames already queued keep the old schedule, at most AHEAD_FRAMES of it.
+ * \param first
+ * \param active Mode active right now
+ * \param elapsedInModeMS Progress of the active mode right now
+ * \param session Session clock whose pacing schedule to follow, if any
+ */
+void AudioEngine::sync(Mode *first, Mode *active, quint32 elapsedInModeMS, const SessionClock *session)
+{
+    if (!running || !first || !active) return;
+    synth->adopt(first, active, elapsedInModeMS, session);
+}
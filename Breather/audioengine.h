@@ -0,0 +1,46 @@
+#ifndef AUDIOENGINE_H
+#define AUDIOENGINE_H
+
+#include <QVector>
+
+class Mode;
+class AudioSink;
+class AudioSynth;
+class SessionClock;
+
+/*!
+ * \brief The AudioEngine class Audio cues at phase changes and a tone whose pitch follows the breath
+ *  Audio is scheduled by sample position on a private copy of the session clock, never by the
+ *  GUI timers, so a cue lands on the sample where its phase begins however late onModeTimeout
+ *  runs. A synthesizer thread renders small blocks into preallocated buffers and hands them to
+ *  the sink through a lock-free ring; the sink's callback never blocks or allocates.
+ */
+class AudioEngine
+{
+public:
+    enum Feature : quint8
+    {
+        Cues = 0x01, ///< Short tone at the start of every phase, its pitch names the phase
+        Tone = 0x02  ///< Continuous tone gliding with the completed ratio of the phase
+    };
+
+    static const quint32 BLOCK = 240;         ///< Frames synthesized at a time, 5 ms
+    static const quint32 AHEAD_FRAMES = 2048; ///< Frames kept queued ahead of the sink, about 43 ms
+
+    AudioEngine(quint8 features, AudioSink *sink);
+    ~AudioEngine();
+
+    bool start(Mode *first, Mode *active, quint32 elapsedInModeMS, const SessionClock *session = nullptr);
+    void stop();
+    void sync(Mode *first, Mode *active, quint32 elapsedInModeMS, const SessionClock *session = nullptr);
+
+    static QVector<qint16> cue(quint8 mode);
+
+private:
+    AudioSynth *synth;
+    AudioSink *sink;
+    bool running = false;
+    Q_DISABLE_COPY(AudioEngine)
+};
+
+#endif // AUDIOENGINE_H
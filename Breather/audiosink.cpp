@@ -0,0 +1,19 @@
+#include "audiosink.h"
+#include "metrics.h"
+#include <cstring>
+
+/*!
+ * \brief AudioSink::pull Take frames for playback, padding with silence when the synthesizer fell behind
+ *  Lock and allocation free, safe to call from a real-time audio callback.
+ * \param stream
+ * \param data
+ * \param frames
+ */
+void AudioSink::pull(AudioStream *stream, qint16 *data, quint32 frames)
+{
+    quint32 got = stream->ring.read(data, frames);
+    if (got == frames) return;
+    memset(data + got, 0, (frames - got) * sizeof(qint16));
+    stream->underrunFrames.fetch_add(frames - got, std::memory_order_relaxed);
+    Metrics::audioUnderrun(frames - got);
+}
@@ -0,0 +1,44 @@
+#ifndef AUDIOSINK_H
+#define AUDIOSINK_H
+
+#include "ringbuffer.h"
+#include <QtGlobal>
+#include <atomic>
+
+/*!
+ * \brief The AudioStream struct Mono 16 bit samples on their way between two threads
+ *  Playback: the synthesizer is the only writer and the sink's callback the only reader. Capture:
+ *  the source's callback writes and the analysis reads. Neither side ever takes a lock.
+ *  Frames a sink had to fill with silence are counted in underrunFrames, the synthesizer skips as
+ *  many so its sample clock keeps following the session clock.
+ */
+struct AudioStream
+{
+    static const quint32 CAPACITY = 8192;   ///< 170 ms at 48 kHz
+    SpscRingBuffer<qint16, CAPACITY> ring;
+    std::atomic<quint64> underrunFrames {0};
+};
+
+/*!
+ * \brief The AudioSink class Where synthesized audio goes: a sound device, or a file for headless runs
+ *  A sink pulls frames from the stream at its own pace, from whatever thread its platform uses.
+ */
+class AudioSink
+{
+public:
+    static const quint32 SAMPLE_RATE = 48000;
+
+    virtual ~AudioSink() {}
+    virtual bool start(AudioStream *stream) = 0;
+    virtual void stop() = 0;
+    /*!
+     * \brief latencyMS Time from a frame leaving the stream until it is heard
+     *  Asked before start() too, for the frames queued ahead of it.
+     * \return
+     */
+    virtual quint32 latencyMS() const { return 0; }
+
+    static void pull(AudioStream *stream, qint16 *data, quint32 frames);
+};
+
+#endif // AUDIOSINK_H
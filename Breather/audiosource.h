@@ -0,0 +1,25 @@
+#ifndef AUDIOSOURCE_H
+#define AUDIOSOURCE_H
+
+#include "audiosink.h"
+
+/*!
+ * \brief The AudioSource class Where captured audio comes from: a microphone, or a file for headless runs
+ *  A source pushes mono frames into the stream from whatever thread its platform uses. Frames
+ *  that do not fit because the analysis fell behind are dropped at the source.
+ */
+class AudioSource
+{
+public:
+    virtual ~AudioSource() {}
+    virtual bool start(AudioStream *stream) = 0;
+    virtual void stop() = 0;
+    virtual quint32 sampleRate() const = 0;
+    /*!
+     * \brief isFinished Whether the source has nothing more to deliver, a microphone never is
+     * \return
+     */
+    virtual bool isFinished() const { return false; }
+};
+
+#endif // AUDIOSOURCE_H
@@ -0,0 +1,720 @@
+#include "benchmark.h"
+#include "logging.h"
+#include "metrics.h"
+#include "mainwindow.h"
+#include "mode.h"
+#include "renderer.h"
+#include "sessionclock.h"
+#include "audioengine.h"
+#include "wavsink.h"
+#include "wavsource.h"
+#include "breathdetector.h"
+#include "colorramp.h"
+#include "eventlog.h"
+#include "historyexporter.h"
+#include "particlesystem.h"
+#include "shapemorph.h"
+#include "shapeprovider.h"
+#include "shaperegistry.h"
+#include <QCoreApplication>
+#include <QGuiApplication>
+#include <QRasterWindow>
+#include <QProcess>
+#include <QImage>
+#include <QPainter>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QtEndian>
+#include <QMutex>
+#include <QRandomGenerator>
+#include <QtMath>
+#include <cstring>
+
+namespace
+{
+/*!
+ * \brief nsPerCall Average time of one call of a body, in ns
+ * \param iterations
+ * \param body Called with the iteration number
+ * \return
+ */
+template<typename Body>
+double nsPerCall(int iterations, Body body)
+{
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; i++) body(i);
+    return double(timer.nsecsElapsed()) / iterations;
+}
+
+/*!
+ * \brief logging Cost of a disabled qCDebug call site with arguments, against an empty loop
+ *  Fails when the call site costs more than MAX_DISABLED_NS over the empty loop.
+ */
+bool logging(QTextStream &out)
+{
+    const int ITERATIONS = 10000000;
+    const double MAX_DISABLED_NS = 3; // a category check and a branch, not a stream
+    if (lcMode().isDebugEnabled())
+    {
+        out << "  breather.mode debug output is enabled, nothing to measure\n";
+        return false;
+    }
+    volatile int sink = 0;
+    double empty = nsPerCall(ITERATIONS, [&](int i) { sink = i; });
+    double disabled = nsPerCall(ITERATIONS, [&](int i)
+    {
+        sink = i;
+        qCDebug(lcMode) << "scaling" << i << 1.5;
+    });
+    out << "  empty loop " << empty << " ns, disabled qCDebug " << disabled << " ns per call\n";
+    if (disabled - empty > MAX_DISABLED_NS)
+    {
+        out << "  disabled call site costs " << disabled - empty << " ns, more than " << MAX_DISABLED_NS << " ns\n";
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief backend Startup time, resident memory and frame cost of one overlay backend
+ *  Run in a fresh process each, see backends(), so the other backend leaves nothing behind.
+ *  A frame is painted and flushed synchronously, without waiting for the frame timer.
+ */
+bool backend(QTextStream &out, quint8 which)
+{
+    const int FRAMES = 300;
+    const qint64 STARTUP_TIMEOUT_MS = 10000;
+    MainWindow w(which);
+    w.start();
+    QElapsedTimer wait;
+    wait.start();
+    while (Metrics::startupNS() == 0 && wait.elapsed() < STARTUP_TIMEOUT_MS)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    if (Metrics::startupNS() == 0)
+    {
+        out << "  no frame painted\n";
+        return false;
+    }
+    out << "  startup to first frame " << Metrics::startupNS() / 1e6 << " ms, resident "
+        << Metrics::residentBytes() / 1024 << " KB\n";
+
+    QRasterWindow *raster = nullptr;
+    for (QWindow *window : QGuiApplication::topLevelWindows())
+        if (window->isVisible() && qobject_cast<QRasterWindow *>(window)) raster = qobject_cast<QRasterWindow *>(window);
+    double frame = nsPerCall(FRAMES, [&](int)
+    {
+        if (raster)
+        {
+            raster->update();
+            QEvent request(QEvent::UpdateRequest);
+            QCoreApplication::sendEvent(raster, &request);
+        }
+        else w.repaint();
+    });
+    out << "  paint and flush " << frame / 1000 << " us per frame\n";
+    return true;
+}
+
+bool widgetBackend(QTextStream &out)
+{
+    return backend(out, MainWindow::WidgetBackend);
+}
+
+bool rasterBackend(QTextStream &out)
+{
+    return backend(out, MainWindow::RasterBackend);
+}
+
+/*!
+ * \brief backends Compare both overlay backends, each measured in a child process of its own
+ */
+bool backends(QTextStream &out)
+{
+    const int CHILD_TIMEOUT_MS = 60000;
+    bool ok = true;
+    for (const char *name : {"backend-widget", "backend-raster"})
+    {
+        QProcess child;
+        child.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        child.start(QCoreApplication::applicationFilePath(), QStringList() << "--benchmark" << name);
+        bool finished = child.waitForFinished(CHILD_TIMEOUT_MS);
+        for (const QByteArray &line : child.readAllStandardOutput().split('\n'))
+            if (!line.isEmpty()) out << "  " << line << '\n';
+        ok = ok && finished && child.exitStatus() == QProcess::NormalExit && child.exitCode() == 0;
+    }
+    return ok;
+}
+
+/*!
+ * \brief The Cycle class The four modes of a running breathing cycle, linked like MainWindow links them
+ *  Inhale and exhale are ellipses, the holds rounded rectangles, so consecutive shapes overlap.
+ */
+class Cycle
+{
+public:
+    Cycle(quint32 timeMS = 3000)
+    {
+        const QColor colors[4] = { QColor(40, 120, 220), QColor(60, 180, 120), QColor(220, 120, 40), QColor(160, 60, 180) };
+        for (quint8 m = Modes::Inhale; m <= Modes::HoldOut; m++)
+        {
+            modes[m] = new Mode(m, timeMS, colors[m], 160);
+            modes[m]->setShape(m == Modes::Inhale || m == Modes::Exhale ? Shape::Ellipse : Shape::RoundedRectangle);
+            modes[m]->setChangable(m == Modes::Inhale || m == Modes::HoldIn ? Changable::Increasing : Changable::Decreasing);
+        }
+        for (quint8 m = Modes::Inhale; m <= Modes::HoldOut; m++)
+            modes[m]->setNext(modes[(m + 1) % 4]);
+        clock.setFirstMode(modes[Modes::Inhale]);
+        clock.start();
+    }
+
+    ~Cycle()
+    {
+        for (Mode *mode : modes) delete mode;
+    }
+
+    Mode *modes[4];
+    SessionClock clock;
+};
+
+/*!
+ * \brief foldRun One pass of fold() through a cycle, with the given antialiasing and morph time
+ * \return Share of pixels that differ by more than the tolerance
+ */
+double foldRun(QTextStream &out, bool antialiasing, quint32 morphMS)
+{
+    const QSize SIZE(400, 400);
+    const QPoint WINDOW(SIZE.width(), SIZE.height());
+    const qreal OPACITY = 0.6;
+    const int STEPS = 48;
+    const int TOLERANCE = 2;   ///< Levels of 255 two roundings may differ by
+    Cycle cycle;
+    Renderer plain(&cycle.clock), folded(&cycle.clock);
+    plain.setQuality(antialiasing, false, false);
+    folded.setQuality(antialiasing, false, false);
+    plain.setMorphMS(morphMS);
+    folded.setMorphMS(morphMS);
+    folded.setWindowOpacity(OPACITY);
+
+    quint64 pixels = 0, off = 0;
+    int worst = 0;
+    qint64 fadedNS = 0, foldedNS = 0;
+    QElapsedTimer timer;
+    for (int step = 0; step < STEPS; step++)
+    {
+        FrameState state = plain.frame(qint64(step) * cycle.clock.cycleMS() / STEPS);
+        QImage layer(SIZE, QImage::Format_ARGB32_Premultiplied), window(SIZE, QImage::Format_ARGB32_Premultiplied);
+        QImage direct(SIZE, QImage::Format_ARGB32_Premultiplied);
+        layer.fill(Qt::transparent);
+        window.fill(Qt::transparent);
+        direct.fill(Qt::transparent);
+
+        timer.start();
+        QPainter layerPainter(&layer);
+        plain.paint(layerPainter, WINDOW, state);
+        layerPainter.end();
+        QPainter windowPainter(&window);
+        windowPainter.setOpacity(OPACITY);
+        windowPainter.drawImage(0, 0, layer);
+        windowPainter.end();
+        fadedNS += timer.nsecsElapsed();
+
+        timer.start();
+        QPainter directPainter(&direct);
+        folded.paint(directPainter, WINDOW, state);
+        directPainter.end();
+        foldedNS += timer.nsecsElapsed();
+
+        for (int y = 0; y < SIZE.height(); y++)
+        {
+            const QRgb *a = reinterpret_cast<const QRgb *>(window.constScanLine(y));
+            const QRgb *b = reinterpret_cast<const QRgb *>(direct.constScanLine(y));
+            for (int x = 0; x < SIZE.width(); x++)
+            {
+                int diff = qMax(qMax(qAbs(qRed(a[x]) - qRed(b[x])), qAbs(qGreen(a[x]) - qGreen(b[x]))),
+                                qMax(qAbs(qBlue(a[x]) - qBlue(b[x])), qAbs(qAlpha(a[x]) - qAlpha(b[x]))));
+                worst = qMax(worst, diff);
+                if (diff > TOLERANCE) off++;
+                pixels++;
+            }
+        }
+    }
+    out << "  " << (antialiasing ? "antialiased" : "aliased") << ", morph " << morphMS << " ms: " << off << " of "
+        << pixels << " pixels differ by more than " << TOLERANCE << " levels, at most by " << worst << '\n';
+    out << "    faded window " << fadedNS / STEPS / 1000 << " us, folded alpha " << foldedNS / STEPS / 1000 << " us per frame\n";
+    return double(off) / pixels;
+}
+
+/*!
+ * \brief fold Per-pixel alpha against a faded window, for equal pixels and for frame cost
+ *  The faded window is stood in for by drawing the frame into a layer and blending that with the
+ *  window opacity, which is what the compositor does. Aliased, the fold itself is compared and
+ *  next to nothing may differ. Antialiased, the last shape's edge inside the current one is
+ *  blended by the clip's coverage instead of being composited, so up to MAX_EDGE_SHARE may differ.
+ *  Each runs without and with morphs, which at 1000 ms cover a third of every 3 s phase.
+ */
+bool fold(QTextStream &out)
+{
+    const double MAX_SHARE = 0.001;
+    const double MAX_EDGE_SHARE = 0.01;
+    const quint32 MORPH_MS = 1000;
+    bool ok = true;
+    for (quint32 morphMS : {quint32(0), MORPH_MS})
+    {
+        ok = foldRun(out, false, morphMS) <= MAX_SHARE && ok;
+        ok = foldRun(out, true, morphMS) <= MAX_EDGE_SHARE && ok;
+    }
+    return ok;
+}
+
+/*!
+ * \brief paths Bucketed path cache against building every path, with stale sizes streaming through
+ *  A star grows through its cycle of sizes, and in the last run every frame also asks for a size
+ *  it never needs again, as a window being resized does. With least recently used eviction that
+ *  frame costs one cached lookup plus one build; if the cycle's buckets were dropped it costs more.
+ */
+bool paths(QTextStream &out)
+{
+    const int FRAMES = 20000;
+    const int CYCLE_FRAMES = 300;   ///< Sizes of one cycle, about 40 buckets
+    quint8 star = ShapeRegistry::find("Star");
+    ShapeProvider *provider = ShapeRegistry::provider(star);
+    if (!provider)
+    {
+        out << "  no Star shape registered\n";
+        return false;
+    }
+    auto grown = [](int frame) { int step = frame % CYCLE_FRAMES; return QRect(0, 0, 100 + step, 100 + step); };
+    auto stale = [](int frame) { return QRect(0, 0, 1000 + frame % 4000, 2000); };
+    volatile int sink = 0;
+    double built = nsPerCall(FRAMES, [&](int i) { sink = provider->path(grown(i).size()).elementCount(); });
+    double cached = nsPerCall(FRAMES, [&](int i) { sink = ShapeRegistry::path(star, grown(i)).elementCount(); });
+    double streamed = nsPerCall(FRAMES, [&](int i)
+    {
+        sink = ShapeRegistry::path(star, grown(i)).elementCount();
+        sink = ShapeRegistry::path(star, stale(i)).elementCount();
+    });
+    out << "  built " << built << " ns, cached " << cached << " ns, cached plus a stale size "
+        << streamed << " ns per frame\n";
+    QSize bucket = ShapeRegistry::bucket(grown(0).size());
+    return ShapeRegistry::path(star, bucket) == provider->path(bucket);
+}
+
+/*!
+ * \brief morph A morphing frame's shape, lerp, color and polygon, against drawing one shape as usual
+ *  Both are drawn antialiased at the same size, the morph from an ellipse into a star, stepping
+ *  through it. A morph frame does what Renderer::morphCurrent does: look up both outlines, lerp
+ *  them, blend the colors, then draw. It may cost at most MAX_RATIO times the ellipse.
+ */
+bool morph(QTextStream &out)
+{
+    const int ITERATIONS = 2000;
+    const double MAX_RATIO = 1.25;   // timing noise between two runs of about the same work
+    const QRect FROM(40, 40, 320, 320), TO(80, 20, 240, 360);
+    const QColor FROM_COLOR(40, 120, 220, 160), TO_COLOR(220, 120, 40, 200);
+    QImage image(400, 400, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter qp(&image);
+    qp.setRenderHint(QPainter::Antialiasing);
+    qp.setPen(Qt::NoPen);
+    quint8 star = ShapeRegistry::find("Star");
+
+    double ellipse = nsPerCall(ITERATIONS, [&](int)
+    {
+        qp.setBrush(TO_COLOR);
+        Renderer::drawShape(qp, TO, Shape::Ellipse);
+    });
+    double custom = nsPerCall(ITERATIONS, [&](int)
+    {
+        qp.setBrush(TO_COLOR);
+        Renderer::drawShape(qp, TO, star);
+    });
+    QPolygonF outline;
+    double morphed = nsPerCall(ITERATIONS, [&](int i)
+    {
+        float t = float(i % 100) / 100;
+        ShapeMorph::interpolate(ShapeMorph::outline(Shape::Ellipse), FROM, ShapeMorph::outline(star), TO, t, outline);
+        qp.setBrush(ColorRamp::mix(FROM_COLOR, TO_COLOR, t));
+        qp.drawPolygon(outline);
+    });
+    qp.end();
+    out << "  ellipse " << ellipse / 1000 << " us, star " << custom / 1000 << " us, morph "
+        << morphed / 1000 << " us per shape\n";
+    if (morphed > ellipse * MAX_RATIO)
+    {
+        out << "  a morph frame costs " << morphed / ellipse << " times an ellipse, more than " << MAX_RATIO << '\n';
+        return false;
+    }
+    return outline.size() == ShapeMorph::POINTS;
+}
+
+/*!
+ * \brief particles A frame of 10k particles, placed and drawn over an inhale, against an empty frame
+ *  Antialiased into a 1280x720 image like an export, the ratio stepping as at 60 fps over 4 s.
+ *  The particles may take at most BUDGET_SHARE of a 60 fps frame, the shapes need the rest.
+ */
+bool particles(QTextStream &out)
+{
+    const int COUNT = 10000;
+    const int FRAMES = 240;
+    const double FRAME_NS = 1e9 / 60;
+    const double BUDGET_SHARE = 0.5;
+    const QRect SHAPE(440, 160, 400, 400);
+    QImage image(1280, 720, QImage::Format_ARGB32_Premultiplied);
+    ParticleSystem system(COUNT);
+    QPainter qp(&image);
+    qp.setRenderHint(QPainter::Antialiasing);
+    double empty = nsPerCall(FRAMES, [&](int) { image.fill(Qt::transparent); });
+    double painted = nsPerCall(FRAMES, [&](int i)
+    {
+        image.fill(Qt::transparent);
+        system.paint(qp, SHAPE, float(i) / FRAMES, QColor(40, 120, 220, 200));
+    });
+    qp.end();
+    int drawn = 0;
+    for (int y = 0; y < image.height(); y++)
+        for (int x = 0; x < image.width(); x++)
+            if (qAlpha(image.pixel(x, y)) && !SHAPE.contains(x, y)) drawn++;
+    out << "  " << system.count() << " particles: " << (painted - empty) / 1000 << " us per frame, clearing "
+        << empty / 1000 << " us, " << drawn << " pixels set in the last frame\n";
+    if (painted - empty > FRAME_NS * BUDGET_SHARE)
+    {
+        out << "  particles take " << (painted - empty) / FRAME_NS * 100 << "% of a 60 fps frame, more than "
+            << BUDGET_SHARE * 100 << "%\n";
+        return false;
+    }
+    return drawn > 0;
+}
+
+/*!
+ * \brief audioSync Cues played into a WAV file land on the phase changes of the session clock
+ *  Runs the audio engine in real time for a few phases of CUE_PHASE_MS each, without a sound
+ *  device. A cue's onset is its first loud sample after a stretch of silence; each one has to be
+ *  within SYNC_TOLERANCE_MS of the phase change it marks.
+ */
+bool audioSync(QTextStream &out)
+{
+    const quint32 PHASE_MS = 500;
+    const int PHASES = 5;
+    const quint32 SYNC_TOLERANCE_MS = 5;
+    const int LOUD = 1000, QUIET = 100;
+    const int SILENCE_FRAMES = AudioSink::SAMPLE_RATE / 100;   // 10 ms
+    QTemporaryDir dir;
+    QString path = dir.filePath("sync.wav");
+    Cycle cycle(PHASE_MS);
+    {
+        AudioEngine engine(AudioEngine::Cues, new WavSink(path));
+        if (!engine.start(cycle.modes[Modes::Inhale], cycle.modes[Modes::Inhale], 0))
+        {
+            out << "  audio engine did not start\n";
+            return false;
+        }
+        QThread::msleep(PHASES * PHASE_MS + PHASE_MS / 2);
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() <= 44)
+    {
+        out << "  nothing written to " << path << '\n';
+        return false;
+    }
+    QByteArray data = file.readAll().mid(44);
+    const uchar *samples = reinterpret_cast<const uchar *>(data.constData());
+    int frames = data.size() / 2;
+    QVector<int> onsets;
+    int quiet = SILENCE_FRAMES;
+    for (int i = 0; i < frames; i++)
+    {
+        int sample = qAbs(int(qFromLittleEndian<qint16>(samples + 2*i)));
+        if (sample > LOUD && quiet >= SILENCE_FRAMES) onsets.append(i);
+        quiet = sample < QUIET ? quiet + 1 : 0;
+    }
+
+    bool ok = onsets.size() >= PHASES;
+    qint64 worst = 0;
+    for (int k = 0; k < onsets.size(); k++)
+    {
+        qint64 expected = qint64(k) * PHASE_MS * AudioSink::SAMPLE_RATE / 1000;
+        worst = qMax(worst, qAbs(onsets[k] - expected));
+    }
+    quint32 worstMS = quint32(worst * 1000 / AudioSink::SAMPLE_RATE);
+    ok = ok && worstMS <= SYNC_TOLERANCE_MS;
+    out << "  " << onsets.size() << " cues in " << frames << " frames, furthest " << worstMS
+        << " ms from its phase change\n";
+    return ok;
+}
+
+/*!
+ * \brief breathFft The detector's radix-2 FFT against a direct DFT of the same Hann windowed frame
+ *  The DFT runs in double precision; every bin has to agree to within 1e-4 of the strongest one.
+ */
+bool breathFft(QTextStream &out)
+{
+    const int N = BreathDetector::FRAME;
+    const int ITERATIONS = 2000;
+    QRandomGenerator random(7);
+    QVector<float> frame(N), power(N / 2);
+    for (int i = 0; i < N; i++)
+        frame[i] = float(0.5 * qSin(2 * M_PI * 37.3 * i / N) + 0.2 * (random.generateDouble() - 0.5));
+
+    QVector<double> direct(N / 2);
+    QElapsedTimer timer;
+    timer.start();
+    for (int k = 0; k < N / 2; k++)
+    {
+        double re = 0, im = 0;
+        for (int i = 0; i < N; i++)
+        {
+            double sample = frame[i] * (0.5 - 0.5 * qCos(2 * M_PI * i / (N - 1)));
+            re += sample * qCos(2 * M_PI * k * i / N);
+            im -= sample * qSin(2 * M_PI * k * i / N);
+        }
+        direct[k] = re*re + im*im;
+    }
+    double dftNS = double(timer.nsecsElapsed());
+    double fftNS = nsPerCall(ITERATIONS, [&](int) { BreathDetector::powerSpectrum(frame.constData(), power.data()); });
+
+    double strongest = 0, worst = 0;
+    for (int k = 0; k < N / 2; k++) strongest = qMax(strongest, direct[k]);
+    for (int k = 0; k < N / 2; k++) worst = qMax(worst, qAbs(power[k] - direct[k]) / strongest);
+    out << "  FFT " << fftNS / 1000 << " us, direct DFT " << dftNS / 1000 << " us per frame, largest difference "
+        << worst << " of the strongest bin\n";
+    return worst < 1e-4;
+}
+
+/*!
+ * \brief The BreathTake struct A synthetic recording of one breath: quiet, inhale, hold, exhale, hold
+ *  Inhaling is differentiated white noise, bright; exhaling is low-passed white noise, dark; the
+ *  holds are faint white noise. Phase boundaries are in ms from the start of the file.
+ */
+struct BreathTake
+{
+    static const quint32 RATE = 16000;
+    static const int LEAD_MS = 1000, INHALE_MS = 1500, HOLD_MS = 1000, EXHALE_MS = 1500;
+
+    static quint8 modeAt(qint64 ms)
+    {
+        if (ms < LEAD_MS) return Modes::HoldOut;
+        if (ms < LEAD_MS + INHALE_MS) return Modes::Inhale;
+        if (ms < LEAD_MS + INHALE_MS + HOLD_MS) return Modes::HoldIn;
+        if (ms < LEAD_MS + INHALE_MS + HOLD_MS + EXHALE_MS) return Modes::Exhale;
+        return Modes::HoldOut;
+    }
+
+    static qint64 lengthMS()
+    {
+        return LEAD_MS + INHALE_MS + HOLD_MS + EXHALE_MS + HOLD_MS;
+    }
+
+    static bool write(const QString &path)
+    {
+        QRandomGenerator random(11);
+        int frames = int(lengthMS() * RATE / 1000);
+        QByteArray data(44 + 2*frames, 0);
+        char *h = data.data();
+        memcpy(h, "RIFF", 4);
+        qToLittleEndian<quint32>(quint32(36 + 2*frames), h + 4);
+        memcpy(h + 8, "WAVEfmt ", 8);
+        qToLittleEndian<quint32>(16, h + 16);
+        qToLittleEndian<quint16>(1, h + 20);
+        qToLittleEndian<quint16>(1, h + 22);
+        qToLittleEndian<quint32>(RATE, h + 24);
+        qToLittleEndian<quint32>(RATE * 2, h + 28);
+        qToLittleEndian<quint16>(2, h + 32);
+        qToLittleEndian<quint16>(16, h + 34);
+        memcpy(h + 36, "data", 4);
+        qToLittleEndian<quint32>(quint32(2*frames), h + 40);
+        float previous = 0, lowPassed = 0;
+        const float alpha = 1.0f - qExp(-2.0f * float(M_PI) * 500 / RATE);
+        for (int i = 0; i < frames; i++)
+        {
+            float white = float(random.generateDouble() * 2 - 1);
+            float sample;
+            switch (modeAt(qint64(i) * 1000 / RATE))
+            {
+                case Modes::Inhale: sample = 0.15f * (white - previous); break;
+                case Modes::Exhale: lowPassed += alpha * (white - lowPassed); sample = 0.6f * lowPassed; break;
+                default:            sample = 0.002f * white; break;
+            }
+            previous = white;
+            qToLittleEndian<qint16>(qint16(qBound(-32768.0f, sample * 32767, 32767.0f)), h + 44 + 2*i);
+        }
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+    }
+};
+
+/*!
+ * \brief breathWav A known recording gives the expected classifications, adherence and detection latency
+ *  Two detectors listen to the same paced file: one is told the pattern the file follows, the
+ *  other the pattern with inhale and exhale swapped. The first must score clearly higher.
+ *  Latency is from a breath starting in the file to the detector reporting it.
+ */
+bool breathWav(QTextStream &out)
+{
+    const qint64 MAX_LATENCY_MS = 500;
+    QTemporaryDir dir;
+    QString path = dir.filePath("breath.wav");
+    if (!BreathTake::write(path))
+    {
+        out << "  could not write " << path << '\n';
+        return false;
+    }
+
+    QMutex mutex;
+    QVector<QPair<qint64,quint8>> heard;   ///< Time from the start and classification
+    QElapsedTimer clock;
+    BreathDetector matched(new WavSource(path)), swapped(new WavSource(path));
+    QObject::connect(&matched, &BreathDetector::breathChanged, [&](quint8 breath)
+    {
+        QMutexLocker lock(&mutex);
+        heard.append(qMakePair(clock.elapsed(), breath));
+    });
+    clock.start();
+    if (!matched.begin() || !swapped.begin())
+    {
+        out << "  detectors did not start\n";
+        return false;
+    }
+    while (clock.elapsed() < BreathTake::lengthMS() + 500)
+    {
+        quint8 mode = BreathTake::modeAt(clock.elapsed());
+        matched.setExpected(mode);
+        swapped.setExpected(mode == Modes::Inhale ? Modes::Exhale : mode == Modes::Exhale ? Modes::Inhale : mode);
+        QThread::msleep(10);
+    }
+    matched.end();
+    swapped.end();
+
+    QVector<quint8> sequence;
+    qint64 inhaleLatency = -1, exhaleLatency = -1;
+    for (const auto &change : heard)
+    {
+        sequence.append(change.second);
+        if (change.second == BreathDetector::Inhaling && inhaleLatency < 0)
+            inhaleLatency = change.first - BreathTake::LEAD_MS;
+        if (change.second == BreathDetector::Exhaling && exhaleLatency < 0)
+            exhaleLatency = change.first - (BreathTake::LEAD_MS + BreathTake::INHALE_MS + BreathTake::HOLD_MS);
+    }
+    const QVector<quint8> expected = { BreathDetector::Inhaling, BreathDetector::Silent,
+                                       BreathDetector::Exhaling, BreathDetector::Silent };
+    out << "  heard";
+    for (quint8 breath : sequence) out << ' ' << breath;
+    out << ", adherence " << matched.adherence() << " following the file, " << swapped.adherence()
+        << " swapped, latency " << inhaleLatency << " ms inhaling, " << exhaleLatency << " ms exhaling\n";
+    return sequence == expected && matched.adherence() > 2 * swapped.adherence()
+        && inhaleLatency >= 0 && inhaleLatency <= MAX_LATENCY_MS && exhaleLatency >= 0 && exhaleLatency <= MAX_LATENCY_MS;
+}
+
+/*!
+ * \brief historyExport A year of practice exported from the event log to Parquet
+ *  Half an hour a day of 12 s cycles, every phase with its adherence event, is logged into a
+ *  fresh log and exported, which has to take less than MAX_EXPORT_MS. The log stamps events as
+ *  they are appended, so the times lie closer together than a real year's; only the time
+ *  column's deltas get smaller, every other column holds what a year holds.
+ */
+bool historyExport(QTextStream &out)
+{
+    const int DAYS = 365;
+    const int CYCLES_PER_DAY = 30 * 60 / 12;
+    const qint64 MAX_EXPORT_MS = 500;   // "well under a second"
+    QTemporaryDir dir;
+    QString logDir = dir.filePath("log"), path = dir.filePath("history.parquet");
+    {
+        EventLog log;
+        if (!log.open(logDir))
+        {
+            out << "  cannot open an event log in " << logDir << '\n';
+            return false;
+        }
+        for (int day = 0; day < DAYS; day++)
+        {
+            log.append(EventLog::SessionStarted);
+            for (int cycle = 0; cycle < CYCLES_PER_DAY; cycle++)
+                for (quint8 mode = Modes::Inhale; mode <= Modes::HoldOut; mode++)
+                {
+                    log.append(EventLog::Phase, mode, 0, 3000);
+                    log.append(EventLog::Adherence, mode, float((cycle + mode) % 100) / 100);
+                }
+            log.append(EventLog::SessionEnded);
+        }
+        out << "  " << log.count() << " events logged\n";
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = HistoryExporter::run(logDir, path);
+    qint64 exportMS = timer.elapsed();
+    out << "  exported " << QFileInfo(path).size() / 1024 << " KB in " << exportMS << " ms\n";
+    if (!ok) return false;
+    if (exportMS >= MAX_EXPORT_MS)
+    {
+        out << "  a year takes " << exportMS << " ms to export, at least " << MAX_EXPORT_MS << " ms\n";
+        return false;
+    }
+    return true;
+}
+
+typedef bool (*Function)(QTextStream &out);
+
+/*!
+ * \brief The Entry struct One benchmark that can be run by name
+ */
+struct Entry
+{
+    const char *name;
+    const char *description;
+    Function function;
+    bool inAll;         ///< Whether "all" runs it, single backend runs need a process of their own
+};
+
+const Entry entries[] =
+{
+    { "logging",        "disabled logging category",       logging,       true  },
+    { "backends",       "widget against raster overlay",   backends,      true  },
+    { "fold",           "per-pixel alpha against a faded window", fold,   true  },
+    { "paths",          "bucketed custom shape paths",     paths,         true  },
+    { "morph",          "morphing shape against one shape", morph,        true  },
+    { "particles",      "10k breath flow particles",       particles,     true  },
+    { "audio-sync",     "cues in a WAV file against the session clock", audioSync, true },
+    { "breath-fft",     "breath detector FFT against a direct DFT", breathFft, true },
+    { "breath-wav",     "breath detection from a known recording", breathWav, true },
+    { "history-export", "a year of events to Parquet",     historyExport, true },
+    { "backend-widget", "QMainWindow overlay, run alone",  widgetBackend, false },
+    { "backend-raster", "QRasterWindow overlay, run alone", rasterBackend, false }
+};
+}
+
+/*!
+ * \brief Benchmark::run Run one benchmark, or all of them
+ * \param name Benchmark name or "all"
+ * \param out Where the results are written
+ * \return Process exit code, non-zero when a check failed or the name is unknown
+ */
+int Benchmark::run(const QString &name, QTextStream &out)
+{
+    bool found = false;
+    bool passed = true;
+    for (const Entry &entry : entries)
+    {
+        if (name == "all" ? !entry.inAll : name != entry.name) continue;
+        found = true;
+        out << entry.name << ": " << entry.description << '\n';
+        out.flush();
+        bool ok = entry.function(out);
+        out << (ok ? "  ok\n" : "  FAILED\n");
+        out.flush();
+        passed = passed && ok;
+    }
+    if (!found)
+    {
+        out << "Unknown benchmark " << name << ", one of: all";
+        for (const Entry &entry : entries) out << ' ' << entry.name;
+        out << '\n';
+    }
+    return found && passed ? 0 : 1;
+}
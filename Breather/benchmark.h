@@ -0,0 +1,19 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QString>
+
+class QTextStream;
+
+/*!
+ * \brief The Benchmark class Built-in timing and equivalence checks, run with --benchmark <name>
+ *  Every benchmark checks that the fast path gives the same result as the slow one before it
+ *  times them, and fails when it does not. Nothing needs a display, they run offscreen.
+ */
+class Benchmark
+{
+public:
+    static int run(const QString &name, QTextStream &out);
+};
+
+#endif // BENCHMARK_H
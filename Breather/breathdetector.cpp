@@ -0,0 +1,258 @@
+#include "breathdetector.h"
+#include "audiosource.h"
+#include "mode.h"
+#include "metrics.h"
+#include "logging.h"
+#include <QtMath>
+#include <cstring>
+
+namespace
+{
+
+const float BAND_LOW_HZ  = 150;  ///< Breath noise band, above hum and voice fundamentals
+const float BAND_HIGH_HZ = 2500;
+const float BREATH_RATIO = 4;    ///< Band energy over the noise floor that counts as breathing, 6 dB
+const int CONFIRM_HOPS   = 4;    ///< Hops a new classification must hold before it is reported
+const float SCORE_SECONDS = 10;  ///< Time constant of the adherence score
+const float REPORT_SECONDS = 0.25f;
+
+/*!
+ * \brief The FftTables struct Bit reversal permutation, Hann window and per stage twiddles for FRAME points
+ *  Twiddles of each stage are stored contiguously, so the butterflies of a stage read them in order.
+ */
+struct FftTables
+{
+    QVector<int> reversed;
+    QVector<float> window;
+    QVector<float> cosines; ///< Stage of length len starts at len/2 - 1
+    QVector<float> sines;
+
+    FftTables()
+    {
+        const int n = BreathDetector::FRAME;
+        int bits = 0;
+        while ((1 << bits) < n) bits++;
+        reversed.resize(n);
+        window.resize(n);
+        for (int i = 0; i < n; i++)
+        {
+            int r = 0;
+            for (int b = 0; b < bits; b++) if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+            reversed[i] = r;
+            window[i] = 0.5f - 0.5f * qCos(2 * M_PI * i / (n - 1));
+        }
+        cosines.resize(n - 1);
+        sines.resize(n - 1);
+        for (int len = 2; len <= n; len <<= 1)
+            for (int j = 0; j < len / 2; j++)
+            {
+                cosines[len/2 - 1 + j] = qCos(-2 * M_PI * j / len);
+                sines[len/2 - 1 + j]   = qSin(-2 * M_PI * j / len);
+            }
+    }
+};
+
+const FftTables &tables()
+{
+    static const FftTables instance;
+    return instance;
+}
+
+}
+
+/*!
+ * \brief BreathDetector::BreathDetector Constructor
+ * \param source Taken over, deleted with the detector
+ * \param parent
+ */
+BreathDetector::BreathDetector(AudioSource *source, QObject *parent)
+    : QThread(parent)
+    , source(source)
+    , power(FRAME / 2)
+{
+    tables();
+}
+
+/*!
+ * \brief BreathDetector::~BreathDetector Destructor
+ */
+BreathDetector::~BreathDetector()
+{
+    end();
+    delete source;
+}
+
+/*!
+ * \brief BreathDetector::begin Start capturing and analysing
+ * \return False when the source could not be started
+ */
+bool BreathDetector::begin()
+{
+    end();
+    if (!source->start(&stream)) return false;
+    running.store(true, std::memory_order_release);
+    start(QThread::HighPriority);
+    return true;
+}
+
+/*!
+ * \brief BreathDetector::end Stop capturing and analysing
+ */
+void BreathDetector::end()
+{
+    running.store(false, std::memory_order_release);
+    wait();
+    source->stop();
+    stream.ring.clear();
+}
+
+/*!
+ * \brief BreathDetector::setExpected Mode the user should be following right now, safe from any thread
+ * \param mode NO_MODE while nothing is shown
+ */
+void BreathDetector::setExpected(quint8 mode)
+{
+    expected.store(mode, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief BreathDetector::adherence Share of recent time the breathing matched the pattern
+ * \return 0..1
+ */
+float BreathDetector::adherence() const
+{
+    return score.load(std::memory_order_relaxed);
+}
+
+/*!
+ * \brief BreathDetector::powerSpectrum Power of the first FRAME/2 bins of a Hann windowed frame
+ *  Iterative radix-2 FFT on separate real and imaginary arrays; the butterflies of a group touch
+ *  two contiguous runs with contiguous twiddles, so the compiler vectorizes them.
+ * \param frame FRAME samples
+ * \param power FRAME/2 values
+ */
+void BreathDetector::powerSpectrum(const float *frame, float *power)
+{
+    const FftTables &t = tables();
+    alignas(32) float re[FRAME], im[FRAME];
+    for (int i = 0; i < FRAME; i++)
+    {
+        re[t.reversed[i]] = frame[i] * t.window[i];
+        im[i] = 0;
+    }
+    for (int len = 2; len <= FRAME; len <<= 1)
+    {
+        const int half = len / 2;
+        const float *wr = t.cosines.constData() + half - 1;
+        const float *wi = t.sines.constData() + half - 1;
+        for (int i = 0; i < FRAME; i += len)
+        {
+            float *__restrict ar = re + i, *__restrict ai = im + i;
+            float *__restrict br = re + i + half, *__restrict bi = im + i + half;
+            for (int j = 0; j < half; j++)
+            {
+                float tr = br[j]*wr[j] - bi[j]*wi[j];
+                float ti = br[j]*wi[j] + bi[j]*wr[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+    for (int k = 0; k < FRAME / 2; k++)
+        power[k] = re[k]*re[k] + im[k]*im[k];
+}
+
+/*!
+ * \brief BreathDetector::analyze Classify one frame and update the adherence score
+ * \param frame
+ */
+void BreathDetector::analyze(const float *frame)
+{
+    powerSpectrum(frame, power.data());
+    const float binHz = float(source->sampleRate()) / FRAME;
+    const int low = qMax(1, int(BAND_LOW_HZ / binHz));
+    const int high = qMin(FRAME / 2, int(BAND_HIGH_HZ / binHz) + 1);
+    float energy = 0, moment = 0;
+    for (int k = low; k < high; k++)
+    {
+        energy += power[k];
+        moment += k * power[k];
+    }
+    float centroid = energy > 0 ? moment / energy * binHz : 0;
+
+    // The floor follows quiet frames quickly and loud ones very slowly
+    if (noiseFloor <= 0) noiseFloor = energy;
+    else if (energy < noiseFloor) noiseFloor += 0.1f * (energy - noiseFloor);
+    else noiseFloor += 0.001f * (energy - noiseFloor);
+
+    quint8 heard = Silent;
+    if (energy > BREATH_RATIO * noiseFloor && energy > 0)
+    {
+        if (centroidMean <= 0) centroidMean = centroid;
+        centroidMean += 0.01f * (centroid - centroidMean);
+        heard = centroid >= centroidMean ? Inhaling : Exhaling;
+    }
+
+    if (heard != candidate)
+    {
+        candidate = heard;
+        candidateHops = 0;
+    }
+    if (candidate != breath && ++candidateHops >= CONFIRM_HOPS)
+    {
+        breath = candidate;
+        qCDebug(lcBreath) << "Breath" << breath << "energy" << energy << "floor" << noiseFloor << "centroid" << centroid;
+        emit breathChanged(breath);
+    }
+
+    quint8 mode = expected.load(std::memory_order_relaxed);
+    const float hopSeconds = float(HOP) / source->sampleRate();
+    if (mode != NO_MODE)
+    {
+        bool match = (mode == Modes::Inhale && breath == Inhaling)
+                  || (mode == Modes::Exhale && breath == Exhaling)
+                  || ((mode == Modes::HoldIn || mode == Modes::HoldOut) && breath == Silent);
+        float value = score.load(std::memory_order_relaxed);
+        value += hopSeconds / SCORE_SECONDS * ((match ? 1.0f : 0.0f) - value);
+        score.store(value, std::memory_order_relaxed);
+    }
+    hops++;
+    if (hops % qMax<quint64>(1, quint64(REPORT_SECONDS / hopSeconds)) == 0)
+    {
+        Metrics::breathAdherence(adherence());
+        emit adherenceChanged(adherence());
+    }
+}
+
+/*!
+ * \brief BreathDetector::run Take hops from the stream as they arrive and analyse the frame they complete
+ */
+void BreathDetector::run()
+{
+    QVector<float> frame(FRAME, 0.0f);
+    qint16 hop[HOP];
+    while (running.load(std::memory_order_acquire))
+    {
+        quint32 queued = stream.ring.available();
+        if (queued < quint32(HOP))
+        {
+            if (source->isFinished()) break;
+            msleep(qMax<quint32>(1, HOP * 250 / qMax<quint32>(1, source->sampleRate())));
+            continue;
+        }
+        // Keep the latency bounded: skip whole hops the analysis has fallen behind by
+        if (queued > quint32(HOP * MAX_BACKLOG))
+        {
+            quint32 skip = (queued - HOP * MAX_BACKLOG) / HOP;
+            for (quint32 i = 0; i < skip; i++) stream.ring.read(hop, HOP);
+            Metrics::breathHopsSkipped(skip);
+        }
+        stream.ring.read(hop, HOP);
+        memmove(frame.data(), frame.constData() + HOP, (FRAME - HOP) * sizeof(float));
+        for (int i = 0; i < HOP; i++) frame[FRAME - HOP + i] = hop[i] * (1.0f / 32768);
+        analyze(frame.constData());
+    }
+    qCInfo(lcBreath) << "Breath detection stopped, adherence" << adherence();
+}
@@ -0,0 +1,71 @@
+#ifndef BREATHDETECTOR_H
+#define BREATHDETECTOR_H
+
+#include <QThread>
+#include <QVector>
+#include "audiosink.h"
+
+class AudioSource;
+
+/*!
+ * \brief The BreathDetector class Listens for breathing and scores how well it follows the pattern
+ *  Captured audio is cut into overlapping Hann windowed frames, transformed with a radix-2 FFT
+ *  and reduced to the energy and spectral centroid of the breath noise band. Energy well above the
+ *  tracked noise floor is breathing; a centroid above its running mean is classified as inhaling,
+ *  below as exhaling, since inhaled air is the brighter sound. The adherence score is the share of
+ *  recent time the classification matched the expected Mode, holds expecting silence.
+ *  All of it runs on this worker thread, which never lets more than MAX_BACKLOG hops queue up,
+ *  so a result is never more than a frame and that backlog behind the microphone.
+ */
+class BreathDetector : public QThread
+{
+    Q_OBJECT
+public:
+    enum Breath : quint8
+    {
+        Silent = 0,
+        Inhaling,
+        Exhaling
+    };
+    Q_ENUM(Breath)
+
+    static const int FRAME = 1024;         ///< Samples per analysed frame, a power of two
+    static const int HOP = FRAME / 2;      ///< New samples per frame
+    static const int MAX_BACKLOG = 4;      ///< Hops allowed to queue before older audio is skipped
+    static const quint8 NO_MODE = 0xFF;    ///< Expected mode while nothing is shown, adherence is not scored
+
+    BreathDetector(AudioSource *source, QObject *parent = nullptr);
+    ~BreathDetector() override;
+
+    bool begin();
+    void end();
+    void setExpected(quint8 mode);
+    float adherence() const;
+
+    static void powerSpectrum(const float *frame, float *power);
+
+signals:
+    void breathChanged(quint8 breath);
+    void adherenceChanged(float score);
+
+protected:
+    void run() override;
+
+private:
+    void analyze(const float *frame);
+
+    AudioSource *source;
+    AudioStream stream;
+    std::atomic<bool> running {false};
+    std::atomic<quint8> expected {NO_MODE};
+    std::atomic<float> score {0};
+    QVector<float> power;      ///< Spectrum of the current frame, FRAME/2 bins
+    float noiseFloor = 0;      ///< Tracked band energy while nobody breathes
+    float centroidMean = 0;    ///< Running mean of the band centroid while breathing
+    quint8 breath = Silent;    ///< Reported classification
+    quint8 candidate = Silent; ///< Classification waiting to be confirmed
+    int candidateHops = 0;
+    quint64 hops = 0;
+};
+
+#endif // BREATHDETECTOR_H
@@ -0,0 +1,199 @@
+#include "breathsensor.h"
+#include "logging.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QSerialPort>
+#include <QRandomGenerator>
+#include <QtMath>
+#ifdef Q_OS_UNIX
+#include <poll.h>
+#endif
+
+/*!
+ * \brief BreathSensor::BreathSensor Constructor, starts reading right away
+ * \param spec Input, see the class description
+ * \param parent
+ */
+BreathSensor::BreathSensor(const QString &spec, QObject *parent)
+    : QThread(parent)
+    , spec(spec)
+{
+    clock.start();
+    start(QThread::HighPriority);
+}
+
+/*!
+ * \brief BreathSensor::~BreathSensor Destructor
+ */
+BreathSensor::~BreathSensor()
+{
+    stop();
+}
+
+/*!
+ * \brief BreathSensor::stop Stop reading, reads wake up at least every 100 ms to notice
+ */
+void BreathSensor::stop()
+{
+    running.store(false, std::memory_order_release);
+    wait();
+}
+
+/*!
+ * \brief BreathSensor::level Latest breath level, safe from any thread
+ * \return 0 breathed out .. 1 breathed in
+ */
+float BreathSensor::level() const
+{
+    return currentLevel.load(std::memory_order_relaxed);
+}
+
+/*!
+ * \brief BreathSensor::hasSignal Whether samples are coming in
+ * \return
+ */
+bool BreathSensor::hasSignal() const
+{
+    return receiving.load(std::memory_order_relaxed);
+}
+
+/*!
+ * \brief BreathSensor::sample Feed one sample through the filter and publish the result
+ * \param value
+ * \param timeUS
+ */
+void BreathSensor::sample(float value, qint64 timeUS)
+{
+    quint8 turn = filter.push(value, timeUS);
+    currentLevel.store(filter.level(), std::memory_order_relaxed);
+    receiving.store(true, std::memory_order_relaxed);
+    if (turn == BreathSignal::Peak && filter.periodMS() > 0)
+    {
+        qCDebug(lcBreath) << "Breath of" << filter.periodMS() << "ms, inhaling" << filter.inhaleShare();
+        emit breathMeasured(filter.periodMS(), filter.inhaleShare());
+    }
+}
+
+/*!
+ * \brief lastNumber The last number on a line, so both "value" and "time,value" lines work
+ */
+static bool lastNumber(const QByteArray &line, float &value)
+{
+    QList<QByteArray> fields = line.trimmed().split(',');
+    if (fields.isEmpty()) return false;
+    QList<QByteArray> words = fields.last().trimmed().split(' ');
+    bool ok = false;
+    value = words.last().toFloat(&ok);
+    return ok;
+}
+
+/*!
+ * \brief BreathSensor::run Read from the configured input until stopped or it ends
+ */
+void BreathSensor::run()
+{
+    if (spec.startsWith("sim"))
+    {
+        float bpm = spec.section(':', 1).toFloat();
+        simulate(bpm > 0 ? bpm : 6);
+    }
+    else if (spec.startsWith("serial:"))
+    {
+        QString port = spec.mid(7).section('@', 0, 0);
+        qint32 baud = spec.section('@', 1).toInt();
+        readSerial(port, baud > 0 ? baud : 115200);
+    }
+    else readFile(spec);
+    receiving.store(false, std::memory_order_relaxed);
+    qCInfo(lcBreath) << "Breath sensor input ended" << spec;
+}
+
+/*!
+ * \brief BreathSensor::readSerial Read lines from a serial device
+ * \param port
+ * \param baud
+ */
+void BreathSensor::readSerial(const QString &port, qint32 baud)
+{
+    QSerialPort serial(port);
+    serial.setBaudRate(baud);
+    if (!serial.open(QIODevice::ReadOnly))
+    {
+        qCWarning(lcBreath) << "Breath sensor port could not be opened" << port << serial.errorString();
+        return;
+    }
+    while (running.load(std::memory_order_acquire))
+    {
+        if (!serial.canReadLine() && !serial.waitForReadyRead(100)) continue;
+        while (serial.canReadLine())
+        {
+            float value;
+            if (lastNumber(serial.readLine(), value)) sample(value, clock.nsecsElapsed() / 1000);
+        }
+    }
+}
+
+/*!
+ * \brief BreathSensor::readFile Read lines from standard input, a FIFO or a recorded file
+ *  Live inputs are stamped with their arrival time; recorded files are replayed at RECORDED_HZ.
+ * \param path "-" for standard input
+ */
+void BreathSensor::readFile(const QString &path)
+{
+    QFile file(path);
+    bool opened = (path == "-") ? file.open(stdin, QIODevice::ReadOnly) : file.open(QIODevice::ReadOnly);
+    if (!opened)
+    {
+        qCWarning(lcBreath) << "Breath sensor input could not be opened" << path << file.errorString();
+        return;
+    }
+    bool recorded = path != "-" && QFileInfo(path).isFile();
+    qint64 replayUS = 0;
+    while (running.load(std::memory_order_acquire))
+    {
+#ifdef Q_OS_UNIX
+        // Wait with a timeout, so a silent pipe does not keep stop() waiting. Lines QFile has
+        // already buffered are invisible to poll() on the descriptor, so those are drained first
+        if (!recorded && !file.canReadLine())
+        {
+            pollfd fd = { file.handle(), POLLIN, 0 };
+            if (poll(&fd, 1, 100) == 0) continue;
+        }
+#endif
+        QByteArray line = file.readLine();
+        if (line.isEmpty())
+        {
+            if (file.atEnd()) break;
+            continue;
+        }
+        float value;
+        if (!lastNumber(line, value)) continue;
+        if (recorded)
+        {
+            replayUS += 1000000 / RECORDED_HZ;
+            qint64 aheadUS = replayUS - clock.nsecsElapsed() / 1000;
+            if (aheadUS > 0) usleep(aheadUS);
+            sample(value, replayUS);
+        }
+        else sample(value, clock.nsecsElapsed() / 1000);
+    }
+}
+
+/*!
+ * \brief BreathSensor::simulate Stand-in belt: a slightly uneven breath with sensor noise
+ * \param breathsPerMinute
+ */
+void BreathSensor::simulate(float breathsPerMinute)
+{
+    QRandomGenerator random(1);
+    qint64 stepUS = 1000000 / SIM_HZ;
+    double phase = 0;
+    for (qint64 timeUS = 0; running.load(std::memory_order_acquire); timeUS += stepUS)
+    {
+        qint64 aheadUS = timeUS - clock.nsecsElapsed() / 1000;
+        if (aheadUS > 0) usleep(aheadUS);
+        phase += 2 * M_PI * breathsPerMinute / 60 * stepUS * 1e-6 * (0.9 + 0.2 * random.generateDouble());
+        float value = 512 + 200 * qSin(phase) + 40 * qSin(phase * 2) + float(random.bounded(20.0) - 10);
+        sample(value, timeUS);
+    }
+}
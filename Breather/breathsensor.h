@@ -0,0 +1,57 @@
+#ifndef BREATHSENSOR_H
+#define BREATHSENSOR_H
+
+#include <QThread>
+#include <QString>
+#include <QElapsedTimer>
+#include <atomic>
+#include "breathsignal.h"
+
+/*!
+ * \brief The BreathSensor class Reads a respiration belt sample stream and measures the breath live
+ *  The input is a text stream of one sample per line (the last number on a line is taken, so
+ *  "time,value" lines work too) from:
+ *   - "-"                       standard input, e.g. piped from another tool
+ *   - "serial:<port>[@<baud>]"  a serial device, 115200 baud by default
+ *   - "sim[:<breaths/min>]"     a simulated belt, for trying things out without hardware
+ *   - any other path            a FIFO, or a recorded file replayed at RECORDED_HZ
+ *  Each sample goes through BreathSignal as soon as it is read and the result is published in
+ *  atomics, so the next painted frame already shows it. The level shown lags the belt by that
+ *  handoff plus a 10 Hz low-pass, about 16 ms; the breath rhythm is measured on the
+ *  1 Hz low-pass, about 320 ms behind, where the delay only shifts the turns.
+ */
+class BreathSensor : public QThread
+{
+    Q_OBJECT
+public:
+    static const int RECORDED_HZ = 50; ///< Sample rate recorded files are replayed at
+    static const int SIM_HZ = 50;
+
+    BreathSensor(const QString &spec, QObject *parent = nullptr);
+    ~BreathSensor() override;
+
+    void stop();
+    float level() const;
+    bool hasSignal() const;
+
+signals:
+    void breathMeasured(float periodMS, float inhaleShare);
+
+protected:
+    void run() override;
+
+private:
+    void readSerial(const QString &port, qint32 baud);
+    void readFile(const QString &path);
+    void simulate(float breathsPerMinute);
+    void sample(float value, qint64 timeUS);
+
+    QString spec;
+    std::atomic<bool> running {true};
+    std::atomic<float> currentLevel {0.5f};
+    std::atomic<bool> receiving {false}; ///< A sample arrived recently
+    BreathSignal filter;
+    QElapsedTimer clock;
+};
+
+#endif // BREATHSENSOR_H
@@ -0,0 +1,108 @@
+#include "breathsignal.h"
+#include <QtMath>
+
+namespace
+{
+
+const float HYSTERESIS = 0.25f;  ///< Share of the breath depth a value must fall back to confirm a turn
+const float SMOOTHING  = 0.3f;   ///< Weight of a new breath in depth, period and inhale share
+const qint64 MIN_TURN_US = 300000; ///< Turns closer than this are noise, nobody breathes that fast
+const float DISPLAY_HZ = 10.0f;  ///< Corner of the light low-pass the level is drawn from, about 16 ms of delay
+
+}
+
+/*!
+ * \brief BreathSignal::BreathSignal Constructor
+ * \param cutoffHz Low-pass corner, breathing stays well below 1 Hz
+ */
+BreathSignal::BreathSignal(float cutoffHz)
+    : cutoffHz(cutoffHz)
+{
+}
+
+/*!
+ * \brief BreathSignal::push Take one sample, constant time
+ * \param sample Raw sensor value, any unit and offset
+ * \param timeUS Time the sample was taken, monotonic
+ * \return The turn this sample confirmed, if any
+ */
+quint8 BreathSignal::push(float sample, qint64 timeUS)
+{
+    if (lastUS < 0)
+    {
+        lastUS = timeUS;
+        stage1 = stage2 = display = high = low = peak = trough = sample;
+        highUS = lowUS = timeUS;
+        return NoTurn;
+    }
+    // One-pole coefficient for the actual sample spacing, so irregular streams filter the same
+    float dt = qMax<qint64>(1, timeUS - lastUS) * 1e-6f;
+    lastUS = timeUS;
+    float alpha = 1.0f - qExp(-2.0f * float(M_PI) * cutoffHz * dt);
+    stage1 += alpha * (sample - stage1);
+    stage2 += alpha * (stage1 - stage2);
+    display += (1.0f - qExp(-2.0f * float(M_PI) * DISPLAY_HZ * dt)) * (sample - display);
+    float value = stage2;
+
+    if (value > high) { high = value; highUS = timeUS; }
+    if (value < low)  { low = value;  lowUS = timeUS; }
+    float threshold = HYSTERESIS * qMax(depth, 1e-6f);
+    // Until a depth is known any swing counts, the first turns then set it
+    if (depth <= 0) threshold = 0.5f * (high - low);
+
+    quint8 turn = NoTurn;
+    if (rising && high - value > threshold && high - value > 0 && timeUS - troughUS > MIN_TURN_US)
+    {
+        if (peakUS >= 0) period += (period > 0 ? SMOOTHING : 1.0f) * ((highUS - peakUS) * 1e-3f - period);
+        if (troughUS >= 0 && peakUS >= 0 && highUS > peakUS)
+            inhale += SMOOTHING * (float(highUS - troughUS) / (highUS - peakUS) - inhale);
+        peak = high;
+        peakUS = highUS;
+        depth += (depth > 0 ? SMOOTHING : 1.0f) * ((peak - trough) - depth);
+        rising = false;
+        low = value;
+        lowUS = timeUS;
+        turn = Peak;
+    }
+    else if (!rising && value - low > threshold && value - low > 0 && timeUS - peakUS > MIN_TURN_US)
+    {
+        trough = low;
+        troughUS = lowUS;
+        depth += (depth > 0 ? SMOOTHING : 1.0f) * ((peak - trough) - depth);
+        rising = true;
+        high = value;
+        highUS = timeUS;
+        turn = Trough;
+    }
+    return turn;
+}
+
+/*!
+ * \brief BreathSignal::level How far in the current breath is, between the last trough and peak
+ *  Taken from the light DISPLAY_HZ stage, not the turn detection's low-pass, so it follows the belt closely.
+ * \return 0 breathed out .. 1 breathed in
+ */
+float BreathSignal::level() const
+{
+    float span = peak - trough;
+    if (span <= 0) return 0.5f;
+    return qBound(0.0f, (display - trough) / span, 1.0f);
+}
+
+/*!
+ * \brief BreathSignal::periodMS Smoothed length of a breath, 0 until two peaks were seen
+ * \return
+ */
+float BreathSignal::periodMS() const
+{
+    return period;
+}
+
+/*!
+ * \brief BreathSignal::inhaleShare Smoothed share of a breath spent breathing in
+ * \return
+ */
+float BreathSignal::inhaleShare() const
+{
+    return inhale;
+}
@@ -0,0 +1,47 @@
+#ifndef BREATHSIGNAL_H
+#define BREATHSIGNAL_H
+
+#include <QtGlobal>
+
+/*!
+ * \brief The BreathSignal class Turns raw respiration belt samples into a breath level and rhythm
+ *  Every sample costs a fixed handful of operations: a two stage one-pole low-pass, then peak and
+ *  trough tracking with a hysteresis that scales with the measured breath depth, so noise on a
+ *  shallow breath is not taken for a turn. The low-pass delays a breath by about 2/(2*pi*cutoff),
+ *  320 ms at 1 Hz, which only shifts the measured turns. The level drawn live comes from a single
+ *  10 Hz stage instead, about 16 ms behind the belt: its value is mapped onto the last trough
+ *  and peak to give a level of 0 (breathed out) to 1 (breathed in).
+ */
+class BreathSignal
+{
+public:
+    enum Turn : quint8
+    {
+        NoTurn = 0,
+        Peak,    ///< Lungs full, exhaling starts
+        Trough   ///< Lungs empty, inhaling starts
+    };
+
+    BreathSignal(float cutoffHz = 1.0f);
+
+    quint8 push(float sample, qint64 timeUS);
+    float level() const;
+    float periodMS() const;
+    float inhaleShare() const;
+
+private:
+    float cutoffHz;
+    qint64 lastUS = -1;
+    float stage1 = 0, stage2 = 0; ///< Low-pass states
+    float display = 0;            ///< Light low-pass state the level is taken from
+    float high = 0, low = 0;      ///< Extremes since the last turn
+    qint64 highUS = 0, lowUS = 0;
+    float peak = 1, trough = 0;   ///< Values at the last turns
+    qint64 peakUS = -1, troughUS = -1;
+    bool rising = true;           ///< Looking for a peak, else for a trough
+    float depth = 0;              ///< Smoothed peak to trough distance
+    float period = 0;             ///< Smoothed peak to peak time
+    float inhale = 0.5f;          ///< Smoothed share of the period spent inhaling
+};
+
+#endif // BREATHSIGNAL_H
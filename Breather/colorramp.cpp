@@ -0,0 +1,110 @@
+#include "colorramp.h"
+#include <QtMath>
+
+namespace
+{
+
+/// Resolution of the linear to sRGB table, fine enough that neighbouring 8 bit sRGB values never merge
+const int LINEAR_STEPS = 4096;
+
+/*!
+ * \brief The LinearTables struct sRGB <-> linear light conversion tables, filled on first use
+ */
+struct LinearTables
+{
+    float toLinear[256];
+    quint8 toSrgb[LINEAR_STEPS + 1];
+
+    LinearTables()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : qPow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i <= LINEAR_STEPS; i++)
+        {
+            float l = float(i) / LINEAR_STEPS;
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * qPow(l, 1 / 2.4f) - 0.055f;
+            toSrgb[i] = quint8(qBound(0, qRound(c * 255), 255));
+        }
+    }
+
+    quint8 srgb(float linear) const
+    {
+        return toSrgb[qBound(0, qRound(linear * LINEAR_STEPS), LINEAR_STEPS)];
+    }
+};
+
+const LinearTables &tables()
+{
+    static const LinearTables instance;
+    return instance;
+}
+
+/*!
+ * \brief mixRgba Blend two colors in linear light, alpha is blended linearly as it already is linear
+ */
+QRgb mixRgba(QRgb a, QRgb b, float t)
+{
+    const LinearTables &lt = tables();
+    float s = 1 - t;
+    return qRgba(lt.srgb(s*lt.toLinear[qRed(a)]   + t*lt.toLinear[qRed(b)]),
+                 lt.srgb(s*lt.toLinear[qGreen(a)] + t*lt.toLinear[qGreen(b)]),
+                 lt.srgb(s*lt.toLinear[qBlue(a)]  + t*lt.toLinear[qBlue(b)]),
+                 qRound(s*qAlpha(a) + t*qAlpha(b)));
+}
+
+}
+
+/*!
+ * \brief ColorRamp::ColorRamp Constructor, a transparent ramp
+ */
+ColorRamp::ColorRamp()
+{
+    for (int i = 0; i < SIZE; i++) lut[i] = 0;
+}
+
+/*!
+ * \brief ColorRamp::set Precompute the ramp from start to end color
+ * \param start
+ * \param end
+ */
+void ColorRamp::set(const QColor &start, const QColor &end)
+{
+    QRgb a = start.rgba(), b = end.rgba();
+    for (int i = 0; i < SIZE; i++)
+        lut[i] = qPremultiply(mixRgba(a, b, float(i) / (SIZE - 1)));
+}
+
+/*!
+ * \brief ColorRamp::premultipliedAt
+ * \param t Progress through the phase, 0 to 1
+ * \return
+ */
+QRgb ColorRamp::premultipliedAt(float t) const
+{
+    return lut[qBound(0, int(t * (SIZE - 1) + 0.5f), SIZE - 1)];
+}
+
+/*!
+ * \brief ColorRamp::colorAt
+ * \param t Progress through the phase, 0 to 1
+ * \return
+ */
+QColor ColorRamp::colorAt(float t) const
+{
+    return QColor::fromRgba(qUnpremultiply(premultipliedAt(t)));
+}
+
+/*!
+ * \brief ColorRamp::mix Blend two colors in linear light without building a ramp, e.g. across a phase boundary
+ * \param a
+ * \param b
+ * \param t
+ * \return
+ */
+QColor ColorRamp::mix(const QColor &a, const QColor &b, float t)
+{
+    return QColor::fromRgba(mixRgba(a.rgba(), b.rgba(), t));
+}
@@ -0,0 +1,31 @@
+#ifndef COLORRAMP_H
+#define COLORRAMP_H
+
+#include <QColor>
+#include <QRgb>
+
+/*!
+ * \brief The ColorRamp class Color cross-fade of one phase, blended in linear light
+ *  Blending sRGB values directly makes a fade dip in brightness halfway. The ramp is converted to
+ *  linear light, blended and converted back once per settings change into a 256 entry LUT of
+ *  premultiplied ARGB, so a frame only looks up its entry. The conversions go through tables too,
+ *  pow() only runs once per process to fill them.
+ */
+class ColorRamp
+{
+public:
+    static const int SIZE = 256;
+
+    ColorRamp();
+    void set(const QColor &start, const QColor &end);
+
+    QRgb premultipliedAt(float t) const;
+    QColor colorAt(float t) const;
+
+    static QColor mix(const QColor &a, const QColor &b, float t);
+
+private:
+    QRgb lut[SIZE]; ///< Premultiplied ARGB from start (0) to end (SIZE-1)
+};
+
+#endif // COLORRAMP_H
@@ -0,0 +1,254 @@
+#include "cyclecache.h"
+#include "mode.h"
+#include "renderer.h"
+#include "sessionclock.h"
+#include "logging.h"
+#include <QPainter>
+#include <QThread>
+#include <QElapsedTimer>
+#include <atomic>
+#include <algorithm>
+
+/*!
+ * \brief The CycleBuilder class Renders and encodes one cycle from a snapshot of the modes
+ *  The modes are copied on the GUI thread before starting, so the settings can change meanwhile;
+ *  a builder that became stale is cancelled and its result dropped.
+ */
+class CycleBuilder : public QThread
+{
+public:
+    QList<Mode*> modes;                 ///< Snapshot of the cycle, owned by the builder
+    SessionClock clock;
+    Renderer renderer {&clock};
+    QPoint size;
+    quint8 fps = 0;
+    quint64 budgetBytes = 0;
+    std::atomic<bool> cancelled {false};
+
+    QVector<QVector<quint32>> frames;   ///< Result, only complete if ok is set
+    QHash<quint8,quint32> offsetMS;
+    quint32 cycleMS = 0;
+    bool ok = false;
+
+    ~CycleBuilder()
+    {
+        qDeleteAll(modes);
+    }
+
+protected:
+    void run() override
+    {
+        QElapsedTimer buildTime;
+        buildTime.start();
+        cycleMS = clock.cycleMS();
+        int count = int(quint64(cycleMS)*fps/1000);
+        QImage image(size.x(), size.y(), QImage::Format_ARGB32_Premultiplied);
+        quint64 bytes = 0;
+        frames.reserve(count);
+        for (int i = 0; i < count; i++)
+        {
+            if (cancelled.load(std::memory_order_relaxed)) return;
+            image.fill(Qt::transparent);
+            QPainter qp(&image);
+            // Render the second cycle, so the first phase also has the previous shape underneath
+            renderer.paint(qp, size, renderer.frame(cycleMS + qint64(i)*1000/fps));
+            qp.end();
+            frames.append(QVector<quint32>());
+            CycleCache::encode(image, frames.last());
+            bytes += frames.last().size()*sizeof(quint32);
+            if (bytes > budgetBytes)
+            {
+                qCInfo(lcMain) << "cycle cache over budget after" << i+1 << "of" << count << "frames," << bytes << "bytes";
+                return;
+            }
+        }
+        ok = count > 0;
+        qCInfo(lcMain) << "cycle cache built:" << count << "frames," << bytes << "bytes in" << buildTime.elapsed() << "ms";
+    }
+};
+
+/*!
+ * \brief CycleCache::CycleCache Constructor
+ * \param budgetBytes Memory the encoded frames may take, the cache stays unused when a cycle does not fit
+ * \param parent
+ */
+CycleCache::CycleCache(quint64 budgetBytes, QObject *parent)
+    : QObject(parent)
+    , budgetBytes(budgetBytes)
+{
+}
+
+/*!
+ * \brief CycleCache::~CycleCache Destructor, waits for a running builder
+ */
+CycleCache::~CycleCache()
+{
+    if (builder)
+    {
+        builder->cancelled = true;
+        builder->wait();
+        delete builder;
+    }
+}
+
+/*!
+ * \brief CycleCache::rebuild Drop the cached cycle and render it again for new settings
+ * \param first Mode the cycle starts with
+ * \param size Window size to render for
+ * \param fps
+ * \param settings Renderer whose quality and opacity the frames are drawn with
+ */
+void CycleCache::rebuild(Mode *first, const QPoint &size, quint8 fps, const Renderer &settings)
+{
+    frames.clear();
+    if (builder)
+    {
+        // Let the stale builder finish on its own, it deletes itself
+        builder->cancelled = true;
+        disconnect(builder, nullptr, this, nullptr);
+        connect(builder, SIGNAL(finished()), builder, SLOT(deleteLater()));
+        if (builder->isFinished()) builder->deleteLater();
+        builder = nullptr;
+    }
+    if (!first || size.x() <= 0 || size.y() <= 0 || fps == 0) return;
+
+    builder = new CycleBuilder;
+    Mode *mode = first;
+    do
+    {
+        Mode *copy = new Mode(mode->getMode());
+        copy->copySettings(mode);
+        if (!builder->modes.isEmpty()) builder->modes.last()->setNext(copy);
+        builder->modes.append(copy);
+        mode = mode->getNext();
+    } while (mode && mode != first);
+    builder->modes.last()->setNext(builder->modes.first());
+    builder->clock.setFirstMode(builder->modes.first());
+    builder->renderer.copySettings(settings);
+    builder->renderer.setFocus(0);
+    builder->size = size;
+    builder->fps = fps;
+    builder->budgetBytes = budgetBytes;
+    connect(builder, SIGNAL(finished()), this, SLOT(onBuilt()));
+    builder->start(QThread::LowPriority);
+}
+
+/*!
+ * \brief CycleCache::onBuilt Take over the frames of the current builder
+ */
+void CycleCache::onBuilt()
+{
+    // A finished signal queued before the settings changed again belongs to a stale builder
+    if (!builder || sender() != builder) return;
+    if (builder->ok)
+    {
+        frames.swap(builder->frames);
+        offsetMS.clear();
+        quint32 offset = 0;
+        for (Mode *mode : builder->modes)
+        {
+            offsetMS[mode->getMode()] = offset;
+            offset += mode->getTimeMS();
+        }
+        cycleMS = builder->cycleMS;
+        fps = builder->fps;
+        size = builder->size;
+        scratch = QImage(size.x(), size.y(), QImage::Format_ARGB32_Premultiplied);
+    }
+    builder->deleteLater();
+    builder = nullptr;
+}
+
+/*!
+ * \brief CycleCache::isReady
+ * \return
+ */
+bool CycleCache::isReady() const
+{
+    return !frames.isEmpty();
+}
+
+/*!
+ * \brief CycleCache::sizeBytes Memory taken by the encoded frames
+ * \return
+ */
+quint32 CycleCache::sizeBytes() const
+{
+    quint32 bytes = 0;
+    for (const QVector<quint32> &runs : frames)
+        bytes += runs.size()*sizeof(quint32);
+    return bytes;
+}
+
+/*!
+ * \brief CycleCache::paint Blit the cached frame nearest to the given state
+ * \param qp
+ * \param size
+ * \param state
+ * \return False when the cache holds nothing for this state and the caller has to rasterize
+ */
+bool CycleCache::paint(QPainter &qp, const QPoint &size, const FrameState &state) const
+{
+    if (frames.isEmpty() || size != this->size || !state.currMode || !state.lastMode) return false;
+    auto offset = offsetMS.constFind(state.currMode->getMode());
+    if (offset == offsetMS.constEnd()) return false;
+    quint64 positionMS = (*offset + state.elapsedMS) % cycleMS;
+    int index = int((positionMS*fps + 500)/1000) % frames.size();
+    decode(frames.at(index), scratch);
+    qp.drawImage(0, 0, scratch);
+    return true;
+}
+
+/*!
+ * \brief CycleCache::encode Run-length encode a frame; flat shapes on a clear background give few runs per row
+ * \param image Premultiplied ARGB32 frame
+ * \param runs Pairs of run length and pixel value, runs may continue across rows
+ */
+void CycleCache::encode(const QImage &image, QVector<quint32> &runs)
+{
+    runs.clear();
+    for (int y = 0; y < image.height(); y++)
+    {
+        const quint32 *px = reinterpret_cast<const quint32*>(image.constScanLine(y));
+        for (int x = 0; x < image.width(); x++)
+        {
+            if (!runs.isEmpty() && runs.last() == px[x])
+                runs[runs.size()-2]++;
+            else
+            {
+                runs.append(1);
+                runs.append(px[x]);
+            }
+        }
+    }
+    runs.squeeze();
+}
+
+/*!
+ * \brief CycleCache::decode Expand runs into an image of the size they were encoded from
+ * \param runs
+ * \param image
+ */
+void CycleCache::decode(const QVector<quint32> &runs, QImage &image)
+{
+    const int width = image.width();
+    int x = 0, y = 0;
+    quint32 *line = reinterpret_cast<quint32*>(image.scanLine(0));
+    for (int i = 0; i + 1 < runs.size(); i += 2)
+    {
+        quint32 count = runs.at(i), value = runs.at(i+1);
+        while (count)
+        {
+            quint32 n = qMin<quint32>(count, width - x);
+            std::fill_n(line + x, n, value);
+            count -= n;
+            x += n;
+            if (x == width)
+            {
+                if (++y == image.height()) return;
+                x = 0;
+                line = reinterpret_cast<quint32*>(image.scanLine(y));
+            }
+        }
+    }
+}
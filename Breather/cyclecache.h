@@ -0,0 +1,54 @@
+#ifndef CYCLECACHE_H
+#define CYCLECACHE_H
+
+#include <QObject>
+#include <QPoint>
+#include <QImage>
+#include <QVector>
+#include <QHash>
+
+class Mode;
+class QPainter;
+class Renderer;
+class CycleBuilder;
+struct FrameState;
+
+/*!
+ * \brief The CycleCache class One full breathing cycle rendered ahead of time and played back
+ *  The cycle is fully determined by the settings, so after every change it is rendered again on a
+ *  background thread. Frames are kept run-length encoded within a memory budget; a live frame
+ *  then only decodes its runs into one image and blits it. Until the cycle is ready, or for
+ *  anything the cache does not hold (other window sizes, the very first phase, focus outlines),
+ *  the renderer simply rasterizes as before.
+ */
+class CycleCache : public QObject
+{
+    Q_OBJECT
+public:
+    CycleCache(quint64 budgetBytes, QObject *parent = nullptr);
+    ~CycleCache();
+
+    void rebuild(Mode *first, const QPoint &size, quint8 fps, const Renderer &settings);
+    bool isReady() const;
+    quint32 sizeBytes() const;
+
+    bool paint(QPainter &qp, const QPoint &size, const FrameState &state) const;
+
+    static void encode(const QImage &image, QVector<quint32> &runs);
+    static void decode(const QVector<quint32> &runs, QImage &image);
+
+private slots:
+    void onBuilt();
+
+private:
+    quint64 budgetBytes;              ///< Upper limit for all encoded frames together
+    CycleBuilder *builder = nullptr;  ///< Thread rendering the cycle for the latest settings
+    QVector<QVector<quint32>> frames; ///< Encoded frames: pairs of run length and premultiplied pixel
+    QHash<quint8,quint32> offsetMS;   ///< Start of every mode within the cycle, by mode number
+    quint32 cycleMS = 0;              ///< Length of the cached cycle
+    quint8 fps = 0;                   ///< Frames per second the cycle was rendered at
+    QPoint size;                      ///< Window size the frames were rendered for
+    mutable QImage scratch;           ///< Decoded frame, reused every tick
+};
+
+#endif // CYCLECACHE_H
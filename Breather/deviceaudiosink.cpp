@@ -0,0 +1,138 @@
+#include "deviceaudiosink.h"
+#include "logging.h"
+#include <QAudioOutput>
+#include <QAudioDeviceInfo>
+#include <QIODevice>
+#include <QThread>
+#include <QSemaphore>
+#include <atomic>
+
+/*!
+ * \brief The StreamDevice class Read-only device the audio backend pulls the stream through
+ */
+class StreamDevice : public QIODevice
+{
+public:
+    AudioStream *stream = nullptr;
+
+    qint64 bytesAvailable() const override
+    {
+        // Always ready, gaps are played as silence
+        return AudioStream::CAPACITY * sizeof(qint16) + QIODevice::bytesAvailable();
+    }
+
+    bool isSequential() const override
+    {
+        return true;
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        quint32 frames = quint32(maxSize / sizeof(qint16));
+        AudioSink::pull(stream, reinterpret_cast<qint16*>(data), frames);
+        return frames * sizeof(qint16);
+    }
+
+    qint64 writeData(const char *, qint64) override
+    {
+        return -1;
+    }
+};
+
+/*!
+ * \brief The AudioOutputThread class Owns the audio output and runs the event loop it is pulled from
+ */
+class AudioOutputThread : public QThread
+{
+public:
+    QAudioDeviceInfo info;
+    QAudioFormat format;
+    AudioStream *stream = nullptr;
+    std::atomic<int> bufferBytes {0}; ///< Buffer the backend settled on, known once started is released
+    QSemaphore started;
+
+protected:
+    void run() override
+    {
+        StreamDevice device;
+        device.stream = stream;
+        device.open(QIODevice::ReadOnly);
+        QAudioOutput output(info, format);
+        output.setBufferSize(int(AudioSink::SAMPLE_RATE * sizeof(qint16) * DeviceAudioSink::BUFFER_MS / 1000));
+        output.start(&device);
+        bufferBytes.store(output.bufferSize(), std::memory_order_release);
+        started.release();
+        exec();
+        output.stop();
+    }
+};
+
+/*!
+ * \brief DeviceAudioSink::DeviceAudioSink Constructor
+ */
+DeviceAudioSink::DeviceAudioSink()
+{
+}
+
+/*!
+ * \brief DeviceAudioSink::~DeviceAudioSink Destructor
+ */
+DeviceAudioSink::~DeviceAudioSink()
+{
+    stop();
+}
+
+/*!
+ * \brief DeviceAudioSink::start Open the default output device in pull mode, on the output thread
+ *  Returns once the output has started.
+ * \param stream
+ * \return False when the device does not take mono 16 bit audio at SAMPLE_RATE
+ */
+bool DeviceAudioSink::start(AudioStream *stream)
+{
+    stop();
+    QAudioFormat format;
+    format.setSampleRate(SAMPLE_RATE);
+    format.setChannelCount(1);
+    format.setSampleSize(16);
+    format.setCodec("audio/pcm");
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setSampleType(QAudioFormat::SignedInt);
+    QAudioDeviceInfo info = QAudioDeviceInfo::defaultOutputDevice();
+    if (info.isNull() || !info.isFormatSupported(format))
+    {
+        qCWarning(lcMain) << "No sound device plays mono 16 bit audio at" << SAMPLE_RATE << "Hz";
+        return false;
+    }
+    thread = new AudioOutputThread;
+    thread->info = info;
+    thread->format = format;
+    thread->stream = stream;
+    thread->start(QThread::TimeCriticalPriority);
+    thread->started.acquire();
+    qCInfo(lcMain) << "Audio on" << info.deviceName() << "buffer" << thread->bufferBytes.load() << "bytes";
+    return true;
+}
+
+/*!
+ * \brief DeviceAudioSink::stop
+ */
+void DeviceAudioSink::stop()
+{
+    if (!thread) return;
+    thread->quit();
+    thread->wait();
+    delete thread;
+    thread = nullptr;
+}
+
+/*!
+ * \brief DeviceAudioSink::latencyMS Length of the backend buffer the device plays from
+ * \return The buffer asked for until the output has started, the one it settled on after
+ */
+quint32 DeviceAudioSink::latencyMS() const
+{
+    if (!thread) return BUFFER_MS;
+    return quint32(thread->bufferBytes.load(std::memory_order_acquire) * 1000 / (SAMPLE_RATE * sizeof(qint16)));
+}
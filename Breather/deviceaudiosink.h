@@ -0,0 +1,31 @@
+#ifndef DEVICEAUDIOSINK_H
+#define DEVICEAUDIOSINK_H
+
+#include "audiosink.h"
+
+class AudioOutputThread;
+
+/*!
+ * \brief The DeviceAudioSink class Plays on the default sound device through Qt Multimedia
+ *  The device pulls in its own buffer sized chunks straight from the stream, the backend keeps
+ *  only a small buffer so cues are heard close to the phase change they mark. The output lives
+ *  in a thread of its own with its own event loop, so a busy GUI thread cannot starve it.
+ */
+class DeviceAudioSink : public AudioSink
+{
+public:
+    static const quint32 BUFFER_MS = 40;
+
+    DeviceAudioSink();
+    ~DeviceAudioSink() override;
+
+    bool start(AudioStream *stream) override;
+    void stop() override;
+    quint32 latencyMS() const override;
+
+private:
+    AudioOutputThread *thread = nullptr;
+    Q_DISABLE_COPY(DeviceAudioSink)
+};
+
+#endif // DEVICEAUDIOSINK_H
@@ -0,0 +1,96 @@
+#include "deviceaudiosource.h"
+#include "logging.h"
+#include <QAudioInput>
+#include <QAudioDeviceInfo>
+#include <QIODevice>
+
+/*!
+ * \brief The CaptureDevice class Write-only device the audio backend pushes captured frames into
+ */
+class CaptureDevice : public QIODevice
+{
+public:
+    AudioStream *stream = nullptr;
+
+protected:
+    qint64 readData(char *, qint64) override
+    {
+        return -1;
+    }
+
+    qint64 writeData(const char *data, qint64 size) override
+    {
+        quint32 frames = quint32(size / sizeof(qint16));
+        quint32 taken = stream->ring.write(reinterpret_cast<const qint16*>(data), frames);
+        // Dropped when the analysis fell behind; the backend must never be blocked
+        if (taken < frames) stream->underrunFrames.fetch_add(frames - taken, std::memory_order_relaxed);
+        return size;
+    }
+};
+
+/*!
+ * \brief DeviceAudioSource::DeviceAudioSource Constructor
+ */
+DeviceAudioSource::DeviceAudioSource()
+{
+}
+
+/*!
+ * \brief DeviceAudioSource::~DeviceAudioSource Destructor
+ */
+DeviceAudioSource::~DeviceAudioSource()
+{
+    stop();
+}
+
+/*!
+ * \brief DeviceAudioSource::start Open the default input device in push mode
+ * \param stream
+ * \return False when there is no microphone taking mono 16 bit audio at SAMPLE_RATE
+ */
+bool DeviceAudioSource::start(AudioStream *stream)
+{
+    stop();
+    QAudioFormat format;
+    format.setSampleRate(SAMPLE_RATE);
+    format.setChannelCount(1);
+    format.setSampleSize(16);
+    format.setCodec("audio/pcm");
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setSampleType(QAudioFormat::SignedInt);
+    QAudioDeviceInfo info = QAudioDeviceInfo::defaultInputDevice();
+    if (info.isNull() || !info.isFormatSupported(format))
+    {
+        qCWarning(lcBreath) << "No microphone records mono 16 bit audio at" << SAMPLE_RATE << "Hz";
+        return false;
+    }
+    device = new CaptureDevice;
+    device->stream = stream;
+    device->open(QIODevice::WriteOnly);
+    input = new QAudioInput(info, format);
+    input->setBufferSize(int(SAMPLE_RATE * sizeof(qint16) * BUFFER_MS / 1000));
+    input->start(device);
+    qCInfo(lcBreath) << "Listening on" << info.deviceName();
+    return true;
+}
+
+/*!
+ * \brief DeviceAudioSource::stop
+ */
+void DeviceAudioSource::stop()
+{
+    if (input) input->stop();
+    delete input;
+    delete device;
+    input = nullptr;
+    device = nullptr;
+}
+
+/*!
+ * \brief DeviceAudioSource::sampleRate
+ * \return
+ */
+quint32 DeviceAudioSource::sampleRate() const
+{
+    return SAMPLE_RATE;
+}
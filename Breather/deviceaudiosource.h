@@ -0,0 +1,32 @@
+#ifndef DEVICEAUDIOSOURCE_H
+#define DEVICEAUDIOSOURCE_H
+
+#include "audiosource.h"
+
+class QAudioInput;
+class CaptureDevice;
+
+/*!
+ * \brief The DeviceAudioSource class Captures the default microphone through Qt Multimedia
+ *  The backend pushes its buffers straight into the stream from its own callback.
+ */
+class DeviceAudioSource : public AudioSource
+{
+public:
+    static const quint32 SAMPLE_RATE = 16000; ///< Breath noise lies well below 8 kHz
+    static const quint32 BUFFER_MS = 20;
+
+    DeviceAudioSource();
+    ~DeviceAudioSource() override;
+
+    bool start(AudioStream *stream) override;
+    void stop() override;
+    quint32 sampleRate() const override;
+
+private:
+    QAudioInput *input = nullptr;
+    CaptureDevice *device = nullptr;
+    Q_DISABLE_COPY(DeviceAudioSource)
+};
+
+#endif // DEVICEAUDIOSOURCE_H
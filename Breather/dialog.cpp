@@ -4,11 +4,19 @@
 #include <QDebug>
 #include <QSettings>
 #include <QColorDialog>
+#include <QComboBox>
+#include <QLineEdit>
 #include <QSignalMapper>
 #include <QMetaEnum>
 #include <QDir>
 
 #include "defaults.h"
+#include "logging.h"
+#include "metrics.h"
+#include "shaperegistry.h"
+
+/// Added to a Mode in the color slots to address its fade to color instead of its color
+static const quint8 END_COLOR = 0x10;
 
 /*!
  * \brief The DialogData struct.
@@ -16,13 +24,18 @@
 struct DialogData
 {
     QHash<quint16,QRadioButton *>   mapPosition ;  ///< Map Mode and Position to Position Radio Button
-    QHash<quint16,QRadioButton *>   mapShape ;     ///< Map Mode and Shape to Shape Radio Button
+    QHash<quint16,QRadioButton *>   mapShape ;     ///< Map Mode and Shape to Shape Radio Button, Shape::FirstCustom for the custom one
+    QHash<quint8, QComboBox *>      mapCustomShape;///< Map Mode to the list of custom shapes
     QHash<quint16,QRadioButton *>   mapDirection ; ///< Map Mode and Direction to Direction Radio Button
     QHash<quint8, QDoubleSpinBox *> mapTime;       ///< Map Mode to Time Input
     QHash<quint8, QPushButton *>    mapColor;      ///< Map Mode to Color Radio Button
+    QHash<quint8, QPushButton *>    mapEndColor;   ///< Map Mode to Fade To Color Button
     QHash<quint16, QSpinBox *>      mapSize;       ///< Map Mode to Size Input
+    QHash<quint8, QLineEdit *>      mapLabel;      ///< Map Mode to the text shown inside its shape
+    QHash<quint8, QDoubleSpinBox *> mapRampTime;   ///< Map Mode to the time it ramps to
 
     QHash<quint8,QColor> colorMap; ///< Maps Mode to Color values
+    QHash<quint8,QColor> endColorMap; ///< Maps Mode to the color it fades to over its phase
     QColorDialog *colord;      ///< Pointer to Select Color Dialog Box
     QSignalMapper *mapper;     ///< Pointer to signal mapper class used to set SIGNAL-SLOT mapping to better handle color selection
     quint8 currColorToSet = 0; ///< Stores Mode enum where to store the selected Color
@@ -34,8 +47,14 @@ struct DialogData
     QHash<quint8,quint8>  stateShape;     ///< Store the last saved shape of a mode
     QHash<quint8,quint8>  statePosition;  ///< Store the last saved position of a mode
     QHash<quint8,QColor>  stateColor;     ///< Store the last saved color of a mode
+    QHash<quint8,QColor>  stateEndColor;  ///< Store the last saved fade to color of a mode
     QHash<quint8,quint16> stateTime;      ///< Store the last saved time of a mode
     QHash<quint8,QPointF> stateSize;      ///< Store the last saved size of a mode
+    QHash<quint8,QString> stateLabel;     ///< Store the last saved label of a mode
+    bool stateCountdown = false;          ///< Store the last saved countdown setting
+    QHash<quint8,quint16> stateRampTime;  ///< Store the last saved time a mode ramps to
+    bool stateRamp = false;               ///< Store the last saved ramp setting
+    quint16 stateRampMinutes = 10;        ///< Store the last saved ramp length
 
 };
 
@@ -52,6 +71,7 @@ Dialog::Dialog(QWidget *parent) :
     connect(ui->buttonSave,SIGNAL(released()), this, SLOT(on_SaveClicked()));
     connect(ui->buttonReset,SIGNAL(released()), this, SLOT(on_ResetClicked()));
     connect(ui->buttonDiscard,SIGNAL(released()), this, SLOT(on_DiscardClicked()));
+    connect(ui->colorEndClear,SIGNAL(released()), this, SLOT(on_EndColorsCleared()));
     setHashMapping();
     loadSavedSettings();
 
@@ -64,6 +84,8 @@ Dialog::Dialog(QWidget *parent) :
     {
         dptr->mapper->setMapping(dptr->mapColor[mode], (int)mode);
         connect(dptr->mapColor[mode],SIGNAL(released()),dptr->mapper,SLOT(map()));
+        dptr->mapper->setMapping(dptr->mapEndColor[mode], (int)(mode | END_COLOR));
+        connect(dptr->mapEndColor[mode],SIGNAL(released()),dptr->mapper,SLOT(map()));
     }
 
     connect(dptr->mapper,SIGNAL(mapped(int)),this,SLOT(on_ColorSelectClicked(int)) );
@@ -80,6 +102,18 @@ Dialog::Dialog(QWidget *parent) :
     for (QSpinBox * instance : dptr->mapSize.values())
         connect(instance,SIGNAL(valueChanged(int)),this,SLOT(on_SomethingToggled()));
 
+    for (QComboBox * instance : dptr->mapCustomShape.values())
+        connect(instance,SIGNAL(currentIndexChanged(int)),this,SLOT(on_SomethingToggled()));
+
+    for (QLineEdit * instance : dptr->mapLabel.values())
+        connect(instance,SIGNAL(textChanged(QString)),this,SLOT(on_SomethingToggled()));
+    connect(ui->labelCountdown,SIGNAL(toggled(bool)),this,SLOT(on_SomethingToggled()));
+
+    for (QDoubleSpinBox * instance : dptr->mapRampTime.values())
+        connect(instance,SIGNAL(valueChanged(double)),this,SLOT(on_SomethingToggled()));
+    connect(ui->rampEnabled,SIGNAL(toggled(bool)),this,SLOT(on_SomethingToggled()));
+    connect(ui->rampMinutes,SIGNAL(valueChanged(int)),this,SLOT(on_SomethingToggled()));
+
     connect(ui->transparancyShape,SIGNAL(valueChanged(int)),this,SLOT(on_ShapeTransparancyChanged(int)));
     connect(ui->transparancyWindow,SIGNAL(valueChanged(int)),this,SLOT(on_WindowTransparancyChanged(int)));
 }
@@ -129,6 +163,19 @@ void Dialog::setHashMapping()
     dptr->mapShape[Modes::Inhale << 8 | Shape::Ellipse]          = ui->InhEllipse;
     dptr->mapShape[Modes::Inhale << 8 | Shape::Rectangle]        = ui->InhRectangle;
     dptr->mapShape[Modes::Inhale << 8 | Shape::RoundedRectangle] = ui->InhRoundedRect;
+    dptr->mapShape[Modes::Inhale << 8 | Shape::FirstCustom]      = ui->InhCustom;
+    dptr->mapShape[Modes::HoldIn << 8 | Shape::FirstCustom]      = ui->HoldCustom;
+
+    dptr->mapCustomShape[Modes::Inhale] = ui->InhCustomShape;
+    dptr->mapCustomShape[Modes::HoldIn] = ui->HoldCustomShape;
+    for (QComboBox *instance : dptr->mapCustomShape.values())
+    {
+        for (quint8 shape : ShapeRegistry::customShapes())
+            instance->addItem(ShapeRegistry::name(shape), shape);
+        instance->setEnabled(instance->count() > 0);
+    }
+    ui->InhCustom->setEnabled(ui->InhCustomShape->count() > 0);
+    ui->HoldCustom->setEnabled(ui->HoldCustomShape->count() > 0);
 
 
     dptr->mapDirection[Modes::Inhale << 8 | Direction::Horizontal] = ui->InhOnlyHorizontal;
@@ -150,6 +197,21 @@ void Dialog::setHashMapping()
     dptr->mapColor[Modes::HoldIn] = ui->colorSetHoldIn;
     dptr->mapColor[Modes::HoldOut]= ui->colorSetHoldOut;
 
+    dptr->mapEndColor[Modes::Inhale] = ui->colorEndInhale;
+    dptr->mapEndColor[Modes::Exhale] = ui->colorEndExhale;
+    dptr->mapEndColor[Modes::HoldIn] = ui->colorEndHoldIn;
+    dptr->mapEndColor[Modes::HoldOut]= ui->colorEndHoldOut;
+
+    dptr->mapLabel[Modes::Inhale] = ui->labelTextInhale;
+    dptr->mapLabel[Modes::Exhale] = ui->labelTextExhale;
+    dptr->mapLabel[Modes::HoldIn] = ui->labelTextHoldIn;
+    dptr->mapLabel[Modes::HoldOut]= ui->labelTextHoldOut;
+
+    dptr->mapRampTime[Modes::Inhale] = ui->rampInhale;
+    dptr->mapRampTime[Modes::Exhale] = ui->rampExhale;
+    dptr->mapRampTime[Modes::HoldIn] = ui->rampHoldIn;
+    dptr->mapRampTime[Modes::HoldOut]= ui->rampHoldOut;
+
     dptr->mapSize[Modes::Inhale << 8 | Direction::Horizontal] = ui->sizeInhHorizontal;
     dptr->mapSize[Modes::Inhale << 8 | Direction::Vertical  ] = ui->sizeInhVertical;
     dptr->mapSize[Modes::HoldIn << 8 | Direction::Horizontal] = ui->sizeHoldInHorizontal;
@@ -191,24 +253,33 @@ bool Dialog::getRadioButtonState(QRadioButton *instance) const
  */
 void Dialog::loadSavedSettings()
 {
-    qInfo() << Q_FUNC_INFO;
+    qCInfo(lcDialog) << Q_FUNC_INFO;
     QSettings settings(QString(qApp->applicationName()));
     settings.setPath(QSettings::IniFormat,QSettings::UserScope,QDir::currentPath());
     settings.beginGroup("InhaleExhale");
     setRadioButton(dptr->mapPosition[Modes::Inhale << 8 | settings.value("Position",Position::TopLeft).toInt()]);
-    setRadioButton(dptr->mapShape[Modes::Inhale << 8 | settings.value("Shape",Shape::Ellipse).toInt()]);
+    setShape(Modes::Inhale, settings.contains("ShapeName") ? ShapeRegistry::find(settings.value("ShapeName").toString())
+                                                           : settings.value("Shape",Shape::Ellipse).toInt());
     setRadioButton(dptr->mapDirection[Modes::Inhale << 8 | settings.value("Direction",Direction::Horizontal).toInt()]);
     dptr->mapTime.value(Modes::Inhale)->setValue(settings.value("timeInh", 0).toFloat() * MSEC_TO_SEC);
     dptr->mapTime.value(Modes::Exhale)->setValue(settings.value("timeExh", 0).toFloat() * MSEC_TO_SEC);
     on_ColorSelected(Modes::Inhale, QColor(settings.value("colorInh", "#ff00ff").toString()));
     on_ColorSelected(Modes::Exhale, QColor(settings.value("colorExh", "#ffff00").toString()));
+    // A missing or invalid fade to color means none, a mode keeps its color for the whole phase
+    on_ColorSelected(Modes::Inhale | END_COLOR, QColor(settings.value("endColorInh").toString()));
+    on_ColorSelected(Modes::Exhale | END_COLOR, QColor(settings.value("endColorExh").toString()));
+    dptr->mapLabel.value(Modes::Inhale)->setText(settings.value("labelInh").toString());
+    dptr->mapLabel.value(Modes::Exhale)->setText(settings.value("labelExh").toString());
+    // Without a ramp target a mode ramps to its own time, i.e. stays
+    dptr->mapRampTime.value(Modes::Inhale)->setValue(settings.value("rampInh", settings.value("timeInh", 0)).toFloat() * MSEC_TO_SEC);
+    dptr->mapRampTime.value(Modes::Exhale)->setValue(settings.value("rampExh", settings.value("timeExh", 0)).toFloat() * MSEC_TO_SEC);
     QStringList point = settings.value("scalingInh","1,1").toString().split(",");
 //    dptr->userScaling[Modes::Inhale] = (point.length() == 2) ? QPointF(point.at(0).toFloat(), point.at(1).toFloat()) : QPointF(1,1);
     setUserScaling(Modes::Inhale, (point.length() == 2) ? QPointF(point.at(0).toFloat(), point.at(1).toFloat()) : QPointF(1,1));
     point = settings.value("scalingExh","1,1").toString().split(",");
 //    dptr->userScaling[Modes::Exhale] = (point.length() == 2) ? QPointF(point.at(0).toFloat(), point.at(1).toFloat()) : QPointF(1,1);
     setUserScaling(Modes::Exhale, (point.length() == 2) ? QPointF(point.at(0).toFloat(), point.at(1).toFloat()) : QPointF(1,1));
-    qInfo() << Q_FUNC_INFO << settings.value("scalingInh","1,1").toString()
+    qCInfo(lcDialog) << Q_FUNC_INFO << settings.value("scalingInh","1,1").toString()
             << settings.value("scalingExh","1,1").toString() << point
             << dptr->userScaling[Modes::Inhale] << dptr->userScaling[Modes::Exhale];
 
@@ -216,13 +287,20 @@ void Dialog::loadSavedSettings()
 
     settings.beginGroup("HoldInOut");
     setRadioButton(dptr->mapPosition[Modes::HoldIn << 8 | settings.value("Position",Position::TopLeft).toInt()]);
-    setRadioButton(dptr->mapShape[Modes::HoldIn << 8 | settings.value("Shape",Shape::Ellipse).toInt()]);
+    setShape(Modes::HoldIn, settings.contains("ShapeName") ? ShapeRegistry::find(settings.value("ShapeName").toString())
+                                                           : settings.value("Shape",Shape::Ellipse).toInt());
     setRadioButton(dptr->mapDirection[Modes::HoldIn << 8 | settings.value("Direction",Direction::Vertical).toInt()]);
     dptr->mapTime.value(Modes::HoldIn)->setValue(settings.value("timeHoldIn", 0).toFloat()* MSEC_TO_SEC);
     dptr->mapTime.value(Modes::HoldOut)->setValue(settings.value("timeHoldOut", 0).toFloat()* MSEC_TO_SEC);
 
     on_ColorSelected(Modes::HoldIn, QColor(settings.value("colorHoldIn", "#00ffff").toString()));
     on_ColorSelected(Modes::HoldOut, QColor(settings.value("colorHoldOut", "#00ff00").toString()));
+    on_ColorSelected(Modes::HoldIn | END_COLOR, QColor(settings.value("endColorHoldIn").toString()));
+    on_ColorSelected(Modes::HoldOut | END_COLOR, QColor(settings.value("endColorHoldOut").toString()));
+    dptr->mapLabel.value(Modes::HoldIn)->setText(settings.value("labelHoldIn").toString());
+    dptr->mapLabel.value(Modes::HoldOut)->setText(settings.value("labelHoldOut").toString());
+    dptr->mapRampTime.value(Modes::HoldIn)->setValue(settings.value("rampHoldIn", settings.value("timeHoldIn", 0)).toFloat() * MSEC_TO_SEC);
+    dptr->mapRampTime.value(Modes::HoldOut)->setValue(settings.value("rampHoldOut", settings.value("timeHoldOut", 0)).toFloat() * MSEC_TO_SEC);
     point = settings.value("scalingHoldIn","1,1").toString().split(",");
 //    dptr->userScaling[Modes::HoldIn] = (point.length() == 2) ? QPointF(point.at(0).toFloat(), point.at(1).toFloat()) : QPointF(1,1);
     setUserScaling(Modes::HoldIn, (point.length() == 2) ? QPointF(point.at(0).toFloat(), point.at(1).toFloat()) : QPointF(1,1));
@@ -236,9 +314,12 @@ void Dialog::loadSavedSettings()
     dptr->transparancyWindow = settings.value("transparancyWindow","50").toDouble() ;
     setShapeTransparency(dptr->transparancyShape);
     setWindowTransparency(dptr->transparancyWindow);
+    ui->labelCountdown->setChecked(settings.value("countdown", false).toBool());
+    ui->rampEnabled->setChecked(settings.value("ramp", false).toBool());
+    ui->rampMinutes->setValue(settings.value("rampMinutes", 10).toInt());
     settings.endGroup();
 
-    qInfo() << Q_FUNC_INFO << settings.value("scalingHoldIn","1,1").toString()
+    qCInfo(lcDialog) << Q_FUNC_INFO << settings.value("scalingHoldIn","1,1").toString()
             << settings.value("scalingHoldOut","1,1").toString() << point
              << dptr->userScaling[Modes::HoldIn] << dptr->userScaling[Modes::HoldOut];
 
@@ -253,6 +334,10 @@ void Dialog::loadSavedSettings()
     dptr->stateColor[Modes::Exhale]  = getColor(Modes::Exhale);
     dptr->stateColor[Modes::HoldIn]  = getColor(Modes::HoldIn);
     dptr->stateColor[Modes::HoldOut] = getColor(Modes::HoldOut);
+    dptr->stateEndColor[Modes::Inhale]  = getEndColor(Modes::Inhale);
+    dptr->stateEndColor[Modes::Exhale]  = getEndColor(Modes::Exhale);
+    dptr->stateEndColor[Modes::HoldIn]  = getEndColor(Modes::HoldIn);
+    dptr->stateEndColor[Modes::HoldOut] = getEndColor(Modes::HoldOut);
 
     dptr->stateTime[Modes::Inhale]  = getTimeMS(Modes::Inhale);
     dptr->stateTime[Modes::Exhale]  = getTimeMS(Modes::Exhale);
@@ -264,6 +349,19 @@ void Dialog::loadSavedSettings()
     dptr->stateSize[Modes::HoldIn]  = getUserScaling(Modes::HoldIn);
     dptr->stateSize[Modes::HoldOut] = getUserScaling(Modes::HoldOut);
 
+    dptr->stateLabel[Modes::Inhale]  = getLabel(Modes::Inhale);
+    dptr->stateLabel[Modes::Exhale]  = getLabel(Modes::Exhale);
+    dptr->stateLabel[Modes::HoldIn]  = getLabel(Modes::HoldIn);
+    dptr->stateLabel[Modes::HoldOut] = getLabel(Modes::HoldOut);
+    dptr->stateCountdown = getCountdown();
+
+    dptr->stateRampTime[Modes::Inhale]  = getRampTimeMS(Modes::Inhale);
+    dptr->stateRampTime[Modes::Exhale]  = getRampTimeMS(Modes::Exhale);
+    dptr->stateRampTime[Modes::HoldIn]  = getRampTimeMS(Modes::HoldIn);
+    dptr->stateRampTime[Modes::HoldOut] = getRampTimeMS(Modes::HoldOut);
+    dptr->stateRamp = getRamp();
+    dptr->stateRampMinutes = getRampMinutes();
+
 }
 
 /*!
@@ -271,17 +369,28 @@ void Dialog::loadSavedSettings()
  */
 void Dialog::saveSettings()
 {
-    qInfo() << Q_FUNC_INFO;
+    qCInfo(lcDialog) << Q_FUNC_INFO;
     QSettings settings(QString(qApp->applicationName()));
     settings.setPath(QSettings::IniFormat,QSettings::UserScope,QDir::currentPath());
     settings.beginGroup("InhaleExhale");
     settings.setValue("Position",getPosition(Modes::Inhale));
     settings.setValue("Shape",getShape(Modes::Inhale));
+    // Custom shape numbers depend on the plugins found at startup, so they are stored by name
+    if (getShape(Modes::Inhale) >= Shape::FirstCustom) settings.setValue("ShapeName",ShapeRegistry::name(getShape(Modes::Inhale)));
+    else settings.remove("ShapeName");
     settings.setValue("Direction",getDirection(Modes::Inhale));
     settings.setValue("timeInh",getTimeMS(Modes::Inhale));
     settings.setValue("timeExh",getTimeMS(Modes::Exhale));
     settings.setValue("colorInh",getColor(Modes::Inhale).name());
     settings.setValue("colorExh",getColor(Modes::Exhale).name());
+    if (getEndColor(Modes::Inhale).isValid()) settings.setValue("endColorInh",getEndColor(Modes::Inhale).name());
+    else settings.remove("endColorInh");
+    if (getEndColor(Modes::Exhale).isValid()) settings.setValue("endColorExh",getEndColor(Modes::Exhale).name());
+    else settings.remove("endColorExh");
+    settings.setValue("labelInh",getLabel(Modes::Inhale));
+    settings.setValue("labelExh",getLabel(Modes::Exhale));
+    settings.setValue("rampInh",getRampTimeMS(Modes::Inhale));
+    settings.setValue("rampExh",getRampTimeMS(Modes::Exhale));
     settings.setValue("scalingInh",QString::number(getUserScaling(Modes::Inhale).x())+","+QString::number(getUserScaling(Modes::Inhale).y()));
     settings.setValue("scalingExh",QString::number(getUserScaling(Modes::Exhale).x())+","+QString::number(getUserScaling(Modes::Exhale).y()));
     settings.endGroup();
@@ -289,11 +398,21 @@ void Dialog::saveSettings()
     settings.beginGroup("HoldInOut");
     settings.setValue("Position",getPosition(Modes::HoldIn));
     settings.setValue("Shape",getShape(Modes::HoldIn));
+    if (getShape(Modes::HoldIn) >= Shape::FirstCustom) settings.setValue("ShapeName",ShapeRegistry::name(getShape(Modes::HoldIn)));
+    else settings.remove("ShapeName");
     settings.setValue("Direction",getDirection(Modes::HoldIn));
     settings.setValue("timeHoldIn",getTimeMS(Modes::HoldIn));
     settings.setValue("timeHoldOut",getTimeMS(Modes::HoldOut));
     settings.setValue("colorHoldIn",getColor(Modes::HoldIn).name());
     settings.setValue("colorHoldOut",getColor(Modes::HoldOut).name());
+    if (getEndColor(Modes::HoldIn).isValid()) settings.setValue("endColorHoldIn",getEndColor(Modes::HoldIn).name());
+    else settings.remove("endColorHoldIn");
+    if (getEndColor(Modes::HoldOut).isValid()) settings.setValue("endColorHoldOut",getEndColor(Modes::HoldOut).name());
+    else settings.remove("endColorHoldOut");
+    settings.setValue("labelHoldIn",getLabel(Modes::HoldIn));
+    settings.setValue("labelHoldOut",getLabel(Modes::HoldOut));
+    settings.setValue("rampHoldIn",getRampTimeMS(Modes::HoldIn));
+    settings.setValue("rampHoldOut",getRampTimeMS(Modes::HoldOut));
     settings.setValue("scalingHoldIn",QString::number(getUserScaling(Modes::HoldIn).x())+","+QString::number(getUserScaling(Modes::HoldIn).y()));
     settings.setValue("scalingHoldOut",QString::number(getUserScaling(Modes::HoldOut).x())+","+QString::number(getUserScaling(Modes::HoldOut).y()));
     settings.endGroup();
@@ -301,7 +420,11 @@ void Dialog::saveSettings()
     settings.beginGroup("Global");
     settings.setValue("transparancyShape", ui->transparancyShape->value()) ;
     settings.setValue("transparancyWindow", ui->transparancyWindow->value()) ;
+    settings.setValue("countdown", getCountdown());
+    settings.setValue("ramp", getRamp());
+    settings.setValue("rampMinutes", getRampMinutes());
     settings.endGroup();
+    Metrics::settingsWritten();
 
     dptr->stateDirection[Modes::Inhale] = getDirection(Modes::Inhale);
     dptr->stateDirection[Modes::HoldIn] = getDirection(Modes::HoldIn);
@@ -314,6 +437,10 @@ void Dialog::saveSettings()
     dptr->stateColor[Modes::Exhale]  = getColor(Modes::Exhale);
     dptr->stateColor[Modes::HoldIn]  = getColor(Modes::HoldIn);
     dptr->stateColor[Modes::HoldOut] = getColor(Modes::HoldOut);
+    dptr->stateEndColor[Modes::Inhale]  = getEndColor(Modes::Inhale);
+    dptr->stateEndColor[Modes::Exhale]  = getEndColor(Modes::Exhale);
+    dptr->stateEndColor[Modes::HoldIn]  = getEndColor(Modes::HoldIn);
+    dptr->stateEndColor[Modes::HoldOut] = getEndColor(Modes::HoldOut);
 
     dptr->stateTime[Modes::Inhale]  = getTimeMS(Modes::Inhale);
     dptr->stateTime[Modes::Exhale]  = getTimeMS(Modes::Exhale);
@@ -325,6 +452,19 @@ void Dialog::saveSettings()
     dptr->stateSize[Modes::HoldIn]  = getUserScaling(Modes::HoldIn);
     dptr->stateSize[Modes::HoldOut] = getUserScaling(Modes::HoldOut);
 
+    dptr->stateLabel[Modes::Inhale]  = getLabel(Modes::Inhale);
+    dptr->stateLabel[Modes::Exhale]  = getLabel(Modes::Exhale);
+    dptr->stateLabel[Modes::HoldIn]  = getLabel(Modes::HoldIn);
+    dptr->stateLabel[Modes::HoldOut] = getLabel(Modes::HoldOut);
+    dptr->stateCountdown = getCountdown();
+
+    dptr->stateRampTime[Modes::Inhale]  = getRampTimeMS(Modes::Inhale);
+    dptr->stateRampTime[Modes::Exhale]  = getRampTimeMS(Modes::Exhale);
+    dptr->stateRampTime[Modes::HoldIn]  = getRampTimeMS(Modes::HoldIn);
+    dptr->stateRampTime[Modes::HoldOut] = getRampTimeMS(Modes::HoldOut);
+    dptr->stateRamp = getRamp();
+    dptr->stateRampMinutes = getRampMinutes();
+
 }
 
 /*!
@@ -356,10 +496,38 @@ quint8 Dialog::getShape(quint8 mode)
 
     for (quint16 keys : dptr->mapShape.keys())
         if ((keys >> 8) == mode && getRadioButtonState(dptr->mapShape.value(keys)))
+        {
+            if ((keys & 0xFF) == Shape::FirstCustom)
+                return dptr->mapCustomShape.value(mode)->currentData().toUInt();
             return (keys & 0xFF) ; // extract Shape byte from the key
+        }
     return 0;
 }
 
+/*!
+ * \brief Dialog::setShape Select the shape of the parametered mode in the UI, built-in or custom
+ * \param mode
+ * \param shape
+ */
+void Dialog::setShape(quint8 mode, quint8 shape)
+{
+    if (mode == Modes::Exhale) mode = Modes::Inhale;
+    if (mode == Modes::HoldOut) mode = Modes::HoldIn;
+
+    if (shape >= Shape::FirstCustom)
+    {
+        QComboBox *custom = dptr->mapCustomShape.value(mode);
+        int index = custom->findData(shape);
+        if (index < 0) shape = Shape::Ellipse; // plugin is gone
+        else
+        {
+            custom->setCurrentIndex(index);
+            shape = Shape::FirstCustom;
+        }
+    }
+    setRadioButton(dptr->mapShape[mode << 8 | shape]);
+}
+
 /*!
  * \brief Dialog::getDirection Get direction of the parametered mode from ui
  * \param mode
@@ -398,6 +566,85 @@ QColor Dialog::getColor(quint8 mode)
     return dptr->colorMap[mode];
 }
 
+/*!
+ * \brief Dialog::getEndColor Get the color the parametered mode fades to over its phase
+ * \param mode
+ * \return
+ */
+QColor Dialog::getEndColor(quint8 mode)
+{
+    return dptr->endColorMap[mode];
+}
+
+/*!
+ * \brief Dialog::clearEndColor Let the parametered mode keep its color for the whole phase
+ * \param mode
+ */
+void Dialog::clearEndColor(quint8 mode)
+{
+    on_ColorSelected(mode | END_COLOR, QColor());
+}
+
+/*!
+ * \brief Dialog::on_EndColorsCleared SLOT triggers when the user turns fading off for every mode
+ */
+void Dialog::on_EndColorsCleared()
+{
+    for (quint8 mode : dptr->mapEndColor.keys())
+        clearEndColor(mode);
+}
+
+/*!
+ * \brief Dialog::getLabel Get the text shown inside the shape of the parametered mode
+ * \param mode
+ * \return
+ */
+QString Dialog::getLabel(quint8 mode)
+{
+    if (dptr->mapLabel.contains(mode))
+        return dptr->mapLabel.value(mode)->text();
+    return QString();
+}
+
+/*!
+ * \brief Dialog::getCountdown Whether the seconds left in a phase are shown inside the shape
+ * \return
+ */
+bool Dialog::getCountdown()
+{
+    return ui->labelCountdown->isChecked();
+}
+
+/*!
+ * \brief Dialog::getRamp Whether the phase times slide to their ramp times over the session
+ * \return
+ */
+bool Dialog::getRamp()
+{
+    return ui->rampEnabled->isChecked();
+}
+
+/*!
+ * \brief Dialog::getRampTimeMS Get the time (ms) the parametered mode ramps to
+ * \param mode
+ * \return
+ */
+quint16 Dialog::getRampTimeMS(quint8 mode)
+{
+    if (dptr->mapRampTime.contains(mode))
+        return (quint16)(dptr->mapRampTime.value(mode)->value()*SEC_TO_MSEC);
+    return 0;
+}
+
+/*!
+ * \brief Dialog::getRampMinutes Get the time the ramp takes
+ * \return
+ */
+quint16 Dialog::getRampMinutes()
+{
+    return ui->rampMinutes->value();
+}
+
 /*!
  * \brief Dialog::getShapeTransparency Get Shape transparancy from UI
  * \return
@@ -434,6 +681,15 @@ void Dialog::setWindowTransparency(quint8 transparancy)
      ui->transparancyWindow->setValue(transparancy);
 }
 
+/*!
+ * \brief Dialog::setStats Show the session statistics in the stats pane
+ * \param summary
+ */
+void Dialog::setStats(const QString &summary)
+{
+    ui->statsText->setText(summary);
+}
+
 /*!
  * \brief Dialog::setUserScaling Set the scaling i.e. shape size multiplier selected by user in the UI
  * \param mode
@@ -464,6 +720,7 @@ void Dialog::saveUserScaling()
     settings.setValue("scalingHoldIn",QString::number(getUserScaling(Modes::HoldIn).x())+","+QString::number(getUserScaling(Modes::HoldIn).y()));
     settings.setValue("scalingHoldOut",QString::number(getUserScaling(Modes::HoldOut).x())+","+QString::number(getUserScaling(Modes::HoldOut).y()));
     settings.endGroup();
+    Metrics::settingsWritten();
 }
 
 /*!
@@ -481,7 +738,7 @@ void Dialog::setPosition(quint8 mode, quint8 position)
  */
 void Dialog::savePosition()
 {
-    qInfo() << Q_FUNC_INFO ;
+    qCInfo(lcDialog) << Q_FUNC_INFO ;
     QSettings settings(QString(qApp->applicationName()));
     settings.beginGroup("InhaleExhale");
 
@@ -491,6 +748,7 @@ void Dialog::savePosition()
     settings.beginGroup("HoldInOut");
     settings.setValue("Position",getPosition(Modes::HoldIn));
     settings.endGroup();
+    Metrics::settingsWritten();
 }
 
 /*!
@@ -507,7 +765,7 @@ QPointF Dialog::getUserScaling(quint8 mode)
     scale.setX(((float)(dptr->mapSize.value(mode << 8 | Direction::Horizontal)->value())) * PERCENT_INV_MULT);
     scale.setY(((float)(dptr->mapSize.value(mode << 8 | Direction::Vertical)->value())) * PERCENT_INV_MULT);
     dptr->userScaling[mode] = scale;
-    qInfo() << Q_FUNC_INFO << dptr->userScaling[mode];
+    qCDebug(lcDialog) << Q_FUNC_INFO << dptr->userScaling[mode];
     return dptr->userScaling[mode];
 }
 
@@ -544,9 +802,17 @@ void Dialog::on_ColorSelected(QColor color)
  */
 void Dialog::on_ColorSelected(quint8 mode, QColor color)
 {
-    dptr->colorMap[mode] = color;
     QString cols = colStart.arg(colStyleSheet.arg(color.red()).arg(color.green()).arg(color.blue()));
-    dptr->mapColor.value(mode)->setStyleSheet(cols);
+    if (mode & END_COLOR)
+    {
+        dptr->endColorMap[mode & ~END_COLOR] = color;
+        dptr->mapEndColor.value(mode & ~END_COLOR)->setStyleSheet(color.isValid() ? cols : QString());
+    }
+    else
+    {
+        dptr->colorMap[mode] = color;
+        dptr->mapColor.value(mode)->setStyleSheet(cols);
+    }
     on_SomethingToggled();
 }
 
@@ -596,11 +862,11 @@ void Dialog::on_ColorInhaleClicked()
 void Dialog::revertSettings()
 {
     setRadioButton(dptr->mapPosition[Modes::Inhale << 8  | dptr->statePosition[Modes::Inhale]]);
-    setRadioButton(dptr->mapShape[Modes::Inhale << 8     | dptr->stateShape[Modes::Inhale]]);
+    setShape(Modes::Inhale, dptr->stateShape[Modes::Inhale]);
     setRadioButton(dptr->mapDirection[Modes::Inhale << 8 | dptr->stateDirection[Modes::Inhale]]);
 
     setRadioButton(dptr->mapPosition[Modes::HoldIn << 8  | dptr->statePosition[Modes::HoldIn]]);
-    setRadioButton(dptr->mapShape[Modes::HoldIn << 8     | dptr->stateShape[Modes::HoldIn]]);
+    setShape(Modes::HoldIn, dptr->stateShape[Modes::HoldIn]);
     setRadioButton(dptr->mapDirection[Modes::HoldIn << 8 | dptr->stateDirection[Modes::HoldIn]]);
 
 
@@ -609,6 +875,10 @@ void Dialog::revertSettings()
 
     on_ColorSelected(Modes::HoldIn, QColor(dptr->stateColor[Modes::HoldIn]));
     on_ColorSelected(Modes::HoldOut, QColor(dptr->stateColor[Modes::HoldOut]));
+    on_ColorSelected(Modes::Inhale | END_COLOR, QColor(dptr->stateEndColor[Modes::Inhale]));
+    on_ColorSelected(Modes::Exhale | END_COLOR, QColor(dptr->stateEndColor[Modes::Exhale]));
+    on_ColorSelected(Modes::HoldIn | END_COLOR, QColor(dptr->stateEndColor[Modes::HoldIn]));
+    on_ColorSelected(Modes::HoldOut | END_COLOR, QColor(dptr->stateEndColor[Modes::HoldOut]));
 
 
     dptr->mapTime.value(Modes::Inhale)->setValue(((float)dptr->stateTime[Modes::Inhale])*SEC_TO_MSEC);
@@ -621,6 +891,15 @@ void Dialog::revertSettings()
     setUserScaling(Modes::Inhale,dptr->stateSize[Modes::Inhale]);
     setUserScaling(Modes::HoldIn,dptr->stateSize[Modes::HoldIn]);
 
+    for (quint8 mode : dptr->mapLabel.keys())
+        dptr->mapLabel.value(mode)->setText(dptr->stateLabel[mode]);
+    ui->labelCountdown->setChecked(dptr->stateCountdown);
+
+    for (quint8 mode : dptr->mapRampTime.keys())
+        dptr->mapRampTime.value(mode)->setValue(((float)dptr->stateRampTime[mode])*MSEC_TO_SEC);
+    ui->rampEnabled->setChecked(dptr->stateRamp);
+    ui->rampMinutes->setValue(dptr->stateRampMinutes);
+
     setShapeTransparency(dptr->transparancyShape);
     setWindowTransparency(dptr->transparancyWindow);
 
@@ -631,7 +910,7 @@ void Dialog::revertSettings()
  */
 void Dialog::on_ResetClicked()
 {
-    qInfo() << Q_FUNC_INFO;
+    qCInfo(lcDialog) << Q_FUNC_INFO;
     setRadioButton(dptr->mapPosition[Modes::Inhale << 8 | Position::TopLeft]);
     setRadioButton(dptr->mapPosition[Modes::HoldIn << 8 | Position::TopLeft]);
 
@@ -646,6 +925,17 @@ void Dialog::on_ResetClicked()
     dptr->mapTime.value(Modes::HoldIn)->setValue(DEF_HOLD_TIME);
     dptr->mapTime.value(Modes::HoldOut)->setValue(DEF_HOLD_TIME);
 
+    for (QLineEdit * instance : dptr->mapLabel.values())
+        instance->clear();
+    ui->labelCountdown->setChecked(false);
+
+    dptr->mapRampTime.value(Modes::Inhale)->setValue(DEF_INHALE_TIME);
+    dptr->mapRampTime.value(Modes::Exhale)->setValue(DEF_INHALE_TIME);
+    dptr->mapRampTime.value(Modes::HoldIn)->setValue(DEF_HOLD_TIME);
+    dptr->mapRampTime.value(Modes::HoldOut)->setValue(DEF_HOLD_TIME);
+    ui->rampEnabled->setChecked(false);
+    ui->rampMinutes->setValue(10);
+
     setShapeTransparency(50);
     setWindowTransparency(50);
 }
@@ -655,7 +945,7 @@ void Dialog::on_ResetClicked()
  */
 void Dialog::on_DiscardClicked()
 {
-    qInfo() << Q_FUNC_INFO;
+    qCInfo(lcDialog) << Q_FUNC_INFO;
     revertSettings();
     this->hide();
     emit settingsChanged();
@@ -675,7 +965,7 @@ void Dialog::on_SomethingToggled()
  */
 void Dialog::on_SaveClicked()
 {
-    qInfo() << Q_FUNC_INFO;
+    qCInfo(lcDialog) << Q_FUNC_INFO;
     this->hide();
     saveSettings();
     emit settingsChanged();
@@ -7,6 +7,7 @@
 #include <QRadioButton>
 #include <QColor>
 #include <QPointF>
+#include <QString>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class Dialog; }
@@ -40,9 +41,17 @@ public:
 
     quint8 getPosition(quint8 mode);
     quint8 getShape(quint8 mode);
+    void setShape(quint8 mode, quint8 shape);
     quint8 getDirection(quint8 mode);
     quint16 getTimeMS(quint8 mode);
     QColor getColor(quint8 mode);
+    QColor getEndColor(quint8 mode);
+    void clearEndColor(quint8 mode);
+    QString getLabel(quint8 mode);
+    bool getCountdown();
+    bool getRamp();
+    quint16 getRampTimeMS(quint8 mode);
+    quint16 getRampMinutes();
     QPointF getUserScaling(quint8 mode);
     quint8 getShapeTransparency();
     quint8 getWindowTransparency();
@@ -51,6 +60,7 @@ public:
     void setPosition(quint8 mode, quint8 position);
     void setShapeTransparency(quint8 transparancy);
     void setWindowTransparency(quint8 transparancy);
+    void setStats(const QString &summary);
 
     void savePosition();
     void saveUserScaling();
@@ -63,6 +73,7 @@ private slots:
     void on_ColorSelected(int);
     void on_ColorSelected(QColor);
     void on_ColorSelectClicked(int);
+    void on_EndColorsCleared();
     void on_SomethingToggled();
     void on_ShapeTransparancyChanged(int transparancy);
     void on_WindowTransparancyChanged(int transparancy);
@@ -0,0 +1,438 @@
+#include "eventlog.h"
+#include "logging.h"
+#include <QDir>
+#include <QFile>
+#include <QDateTime>
+#include <QTextStream>
+#include <QVector>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+static_assert(sizeof(EventRecord) == 32, "EventRecord is part of the file format");
+
+namespace
+{
+
+const char MAGIC[8] = {'B','R','E','V','L','O','G','1'};
+
+/*!
+ * \brief The SegmentHeader struct Start of every segment file
+ *  A segment is grown and given its header before it is needed; it only becomes part of the
+ *  log once firstSequence is set, until then it is a spare.
+ */
+struct SegmentHeader
+{
+    char    magic[8];
+    quint32 recordSize;
+    quint32 records;
+    quint64 firstSequence; ///< Sequence of the first record, 0 while the segment is a spare
+    qint64  createdMS;
+};
+
+static_assert(sizeof(SegmentHeader) == 32, "SegmentHeader is part of the file format");
+
+const qint64 SEGMENT_BYTES = qint64(sizeof(SegmentHeader)) + qint64(EventLog::SEGMENT_RECORDS) * qint64(sizeof(EventRecord));
+
+/*!
+ * \brief checksum FNV-1a over the bytes of a record before its checksum
+ */
+quint32 checksum(const EventRecord &record)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(&record);
+    quint32 hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(EventRecord, checksum); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+/*!
+ * \brief isValid Whether a record is complete and the one expected at its place
+ */
+bool isValid(const EventRecord &record, quint64 sequence)
+{
+    return record.sequence == sequence && record.checksum == checksum(record);
+}
+
+/*!
+ * \brief isBlank Whether nothing was ever written to a record
+ */
+bool isBlank(const EventRecord &record)
+{
+    static const EventRecord blank = {};
+    return memcmp(&record, &blank, sizeof(EventRecord)) == 0;
+}
+
+/*!
+ * \brief hasMagic Whether a header belongs to a segment of this format
+ */
+bool hasMagic(const SegmentHeader &header)
+{
+    return memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.recordSize == sizeof(EventRecord)
+            && header.records == EventLog::SEGMENT_RECORDS;
+}
+
+/*!
+ * \brief segmentFiles Segment files of a log directory, oldest first
+ */
+QStringList segmentFiles(const QDir &dir)
+{
+    return dir.entryList(QStringList() << "*.evl", QDir::Files, QDir::Name);
+}
+
+/*!
+ * \brief segmentName File name of a segment number, zero padded so names sort by number
+ */
+QString segmentName(quint32 segment)
+{
+    return QString("%1.evl").arg(segment, 8, 10, QChar('0'));
+}
+
+/*!
+ * \brief The Segment struct A segment file mapped into memory
+ */
+struct Segment
+{
+    QFile file;
+    uchar *base = nullptr;
+
+    /*!
+     * \brief map Map a segment file, growing a new one to its full size first
+     */
+    bool map(const QString &path, bool create)
+    {
+        unmap();
+        file.setFileName(path);
+        if (!create && !file.exists()) return false;
+        if (!file.open(QIODevice::ReadWrite)) return false;
+        bool fresh = file.size() == 0;
+        if (file.size() != SEGMENT_BYTES && (!create || !file.resize(SEGMENT_BYTES)))
+        {
+            file.close();
+            return false;
+        }
+        base = file.map(0, SEGMENT_BYTES);
+        if (!base)
+        {
+            file.close();
+            return false;
+        }
+        if (fresh || (create && !hasMagic(*header())))
+        {
+            SegmentHeader init = {};
+            memcpy(init.magic, MAGIC, sizeof(MAGIC));
+            init.recordSize = sizeof(EventRecord);
+            init.records = EventLog::SEGMENT_RECORDS;
+            init.createdMS = QDateTime::currentMSecsSinceEpoch();
+            memcpy(base, &init, sizeof(init));
+        }
+        return true;
+    }
+
+    void unmap()
+    {
+        if (base) file.unmap(base);
+        base = nullptr;
+        if (file.isOpen()) file.close();
+    }
+
+    SegmentHeader *header() const { return reinterpret_cast<SegmentHeader *>(base); }
+    EventRecord *records() const { return reinterpret_cast<EventRecord *>(base + sizeof(SegmentHeader)); }
+};
+
+} // namespace
+
+/*!
+ * \brief The EventLogData struct
+ */
+struct EventLogData
+{
+    QDir dir;
+    Segment segments[2];
+    Segment *current = &segments[0]; ///< Segment events are appended to
+    Segment *spare = &segments[1];   ///< Next segment, grown and mapped ahead of time
+    quint32 segment = 0;             ///< Number of the current segment
+    std::atomic<quint32> next {0};   ///< Index of the next record in the current segment
+    std::atomic<quint64> sequence {0}; ///< Sequence of the last record appended
+};
+
+/*!
+ * \brief EventLog::EventLog Constructor, nothing is recorded until open()
+ */
+EventLog::EventLog()
+{
+    d = new EventLogData;
+}
+
+/*!
+ * \brief EventLog::~EventLog Destructor
+ */
+EventLog::~EventLog()
+{
+    close();
+    delete d;
+}
+
+/*!
+ * \brief EventLog::open Continue the log in a directory, or start one there
+ *  The newest segment that was in use is scanned for its last good record; a torn record after
+ *  it is cleared so appending carries on from there.
+ * \param dir
+ * \return False when the directory or a segment cannot be created or mapped
+ */
+bool EventLog::open(const QString &dir)
+{
+    close();
+    d->dir.setPath(dir);
+    if (!d->dir.mkpath(".")) return false;
+
+    QStringList files = segmentFiles(d->dir);
+    for (int i = files.size() - 1; i >= 0 && !d->current->base; i--)
+    {
+        if (!d->current->map(d->dir.filePath(files[i]), false)) continue;
+        if (hasMagic(*d->current->header()) && d->current->header()->firstSequence)
+            d->segment = files[i].section('.', 0, 0).toUInt();
+        else
+            d->current->unmap();
+    }
+
+    if (!d->current->base)
+    {
+        // Nothing recorded yet, a spare left from before is taken over as the first segment
+        d->segment = 0;
+        if (!d->current->map(d->dir.filePath(segmentName(0)), true))
+        {
+            qCWarning(lcMain) << "Event log: cannot create" << d->dir.filePath(segmentName(0));
+            return false;
+        }
+        d->current->header()->firstSequence = 1;
+    }
+
+    quint64 sequence = d->current->header()->firstSequence;
+    EventRecord *records = d->current->records();
+    quint32 count = 0;
+    while (count < SEGMENT_RECORDS && isValid(records[count], sequence))
+    {
+        count++;
+        sequence++;
+    }
+    if (count < SEGMENT_RECORDS && !isBlank(records[count]))
+    {
+        qCWarning(lcMain) << "Event log: cleared a torn record after sequence" << sequence - 1
+                          << "in" << d->current->file.fileName();
+        memset(&records[count], 0, sizeof(EventRecord));
+    }
+    d->next.store(count, std::memory_order_relaxed);
+    d->sequence.store(sequence - 1, std::memory_order_relaxed);
+
+    if (count == SEGMENT_RECORDS && !rollover()) return false;
+    if (!d->spare->base) prepareSpare();
+    qCInfo(lcMain) << "Event log: appending to" << d->current->file.fileName() << "after sequence" << sequence - 1;
+    return true;
+}
+
+/*!
+ * \brief EventLog::close Stop recording, the mappings are written back by the kernel
+ */
+void EventLog::close()
+{
+    d->current->unmap();
+    d->spare->unmap();
+    d->next.store(0, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief EventLog::isOpen
+ * \return
+ */
+bool EventLog::isOpen() const
+{
+    return d->current->base;
+}
+
+/*!
+ * \brief EventLog::append Record an event
+ *  Only called from the GUI thread. The record is copied into the mapping and only then counted,
+ *  so count() never covers a record that is still being written.
+ * \param type EventLog::Type
+ * \param mode
+ * \param value
+ * \param arg
+ * \param written Gets a copy of the record, if given
+ * \return False when the event could not be recorded
+ */
+bool EventLog::append(quint16 type, quint8 mode, float value, quint32 arg, EventRecord *written)
+{
+    if (!d->current->base) return false;
+    quint32 index = d->next.load(std::memory_order_relaxed);
+    if (index == SEGMENT_RECORDS)
+    {
+        if (!rollover()) return false;
+        index = 0;
+    }
+    EventRecord record = {};
+    record.sequence = d->sequence.load(std::memory_order_relaxed) + 1;
+    record.timeMS = QDateTime::currentMSecsSinceEpoch();
+    record.type = type;
+    record.mode = mode;
+    record.value = value;
+    record.arg = arg;
+    record.checksum = checksum(record);
+    memcpy(&d->current->records()[index], &record, sizeof(record));
+    d->sequence.store(record.sequence, std::memory_order_relaxed);
+    d->next.store(index + 1, std::memory_order_release);
+    if (written) *written = record;
+    return true;
+}
+
+/*!
+ * \brief EventLog::count Number of events in the log
+ * \return
+ */
+quint64 EventLog::count() const
+{
+    return d->current->base ? d->sequence.load(std::memory_order_acquire) : 0;
+}
+
+/*!
+ * \brief EventLog::rollover Continue in the spare segment and grow the next spare
+ * \return False when no segment could be mapped, the event is dropped then
+ */
+bool EventLog::rollover()
+{
+    if (!d->spare->base && !prepareSpare())
+    {
+        qCWarning(lcMain) << "Event log: cannot grow segment" << d->segment + 1 << ", events are dropped";
+        return false;
+    }
+    d->spare->header()->firstSequence = d->sequence.load(std::memory_order_relaxed) + 1;
+    d->current->unmap();
+    std::swap(d->current, d->spare);
+    d->segment++;
+    d->next.store(0, std::memory_order_release);
+    prepareSpare();
+    return true;
+}
+
+/*!
+ * \brief EventLog::prepareSpare Grow and map the segment after the current one
+ * \return
+ */
+bool EventLog::prepareSpare()
+{
+    if (!d->spare->map(d->dir.filePath(segmentName(d->segment + 1)), true)) return false;
+    // A segment that already holds events is never overwritten
+    if (d->spare->header()->firstSequence)
+    {
+        d->spare->unmap();
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief EventLog::read Hand every valid event from fromSequence on to a callback, oldest first
+ *  Needs no running log, so it also reads the log of a crashed session. Segments that end before
+ *  fromSequence are skipped after reading their header only.
+ * \param dir
+ * \param fromSequence
+ * \param callback
+ * \param report Gets a comment line for every gap, torn record or foreign file, if given
+ * \return False when there is no log in dir
+ */
+bool EventLog::read(const QString &dir, quint64 fromSequence, const std::function<void(const EventRecord &)> &callback,
+                    QTextStream *report)
+{
+    QDir logDir(dir);
+    QStringList files = segmentFiles(logDir);
+    if (files.isEmpty()) return false;
+
+    QVector<SegmentHeader> headers(files.size());
+    for (int i = 0; i < files.size(); i++)
+    {
+        QFile file(logDir.filePath(files[i]));
+        headers[i] = {};
+        if (file.open(QIODevice::ReadOnly) && file.size() == SEGMENT_BYTES)
+            file.read(reinterpret_cast<char *>(&headers[i]), sizeof(SegmentHeader));
+    }
+
+    quint64 expected = 0;
+    for (int i = 0; i < files.size(); i++)
+    {
+        const SegmentHeader &header = headers[i];
+        if (!hasMagic(header))
+        {
+            if (report) *report << "# " << files[i] << ": not a segment\n";
+            continue;
+        }
+        if (!header.firstSequence) continue; // spare
+        if (report && expected && header.firstSequence != expected)
+            *report << "# " << files[i] << ": events " << expected << " to " << header.firstSequence - 1 << " are missing\n";
+        expected = header.firstSequence;
+        if (i + 1 < files.size() && hasMagic(headers[i + 1]) && headers[i + 1].firstSequence
+                && headers[i + 1].firstSequence <= fromSequence)
+        {
+            // The skipped segment ends where the next one begins
+            expected = headers[i + 1].firstSequence;
+            continue;
+        }
+
+        QFile file(logDir.filePath(files[i]));
+        if (!file.open(QIODevice::ReadOnly)) continue;
+        QByteArray data = file.readAll();
+        if (data.size() != SEGMENT_BYTES) continue;
+        const EventRecord *records = reinterpret_cast<const EventRecord *>(data.constData() + sizeof(SegmentHeader));
+        for (quint32 index = 0; index < SEGMENT_RECORDS; index++, expected++)
+        {
+            EventRecord record;
+            memcpy(&record, &records[index], sizeof(record));
+            if (!isValid(record, expected))
+            {
+                if (report && !isBlank(record)) *report << "# " << files[i] << ": torn record at " << index << '\n';
+                break;
+            }
+            if (record.sequence >= fromSequence) callback(record);
+        }
+    }
+    return true;
+}
+
+/*!
+ * \brief EventLog::dump Write a log as tab separated text: sequence, time, event, mode, value, arg
+ *  Gaps and torn records are reported as comment lines.
+ * \param dir
+ * \param out
+ * \return False when there is no log in dir
+ */
+bool EventLog::dump(const QString &dir, QTextStream &out)
+{
+    out << "# sequence\ttime\tevent\tmode\tvalue\targ\n";
+    bool found = read(dir, 1, [&out](const EventRecord &record)
+    {
+        out << record.sequence << '\t'
+            << QDateTime::fromMSecsSinceEpoch(record.timeMS).toString(Qt::ISODateWithMs) << '\t'
+            << typeName(record.type) << '\t' << uint(record.mode) << '\t' << record.value << '\t' << record.arg << '\n';
+    }, &out);
+    out.flush();
+    return found;
+}
+
+/*!
+ * \brief EventLog::typeName Name an event type is dumped with
+ * \param type
+ * \return
+ */
+QString EventLog::typeName(quint16 type)
+{
+    switch (type)
+    {
+    case SessionStarted:  return "session-started";
+    case SessionEnded:    return "session-ended";
+    case Phase:           return "phase";
+    case Paused:          return "paused";
+    case Resumed:         return "resumed";
+    case SettingsChanged: return "settings-changed";
+    case Adherence:       return "adherence";
+    }
+    return QString("type-%1").arg(type);
+}
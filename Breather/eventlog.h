@@ -0,0 +1,73 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <QString>
+#include <QtGlobal>
+#include <functional>
+
+class QTextStream;
+struct EventLogData;
+
+/*!
+ * \brief The EventRecord struct One fixed size entry of the event log, as stored on disk
+ *  The checksum covers every byte before it, so a record torn by a crash never validates.
+ */
+struct EventRecord
+{
+    quint64 sequence;  ///< Number of the event since the log was created, from 1
+    qint64  timeMS;    ///< Wall clock time, ms since the epoch
+    quint16 type;      ///< EventLog::Type
+    quint8  mode;      ///< Modes value the event refers to, if any
+    quint8  reserved;
+    float   value;     ///< Adherence score, if any
+    quint32 arg;       ///< Phase length, pause length or cycle length in ms, depending on type
+    quint32 checksum;
+};
+
+/*!
+ * \brief The EventLog class Append-only binary audit trail of sessions, memory-mapped in segments
+ *  The log is a directory of segment files, each a header followed by SEGMENT_RECORDS records.
+ *  Segments are grown to full size and mapped before they are needed, so recording an event is
+ *  a memcpy into the mapping plus an atomic index bump; the kernel writes the pages back, which
+ *  survives a crash of the process. On open the tail of the last segment is scanned up to the
+ *  first record that does not validate, a torn record there is cleared and appending continues
+ *  after the last good one.
+ */
+class EventLog
+{
+public:
+    enum Type : quint16
+    {
+        SessionStarted = 1,
+        SessionEnded,
+        Phase,           ///< A phase began, arg is its length
+        Paused,          ///< Nothing can be seen any more, the animation is suspended
+        Resumed,         ///< arg is how long the pause took
+        SettingsChanged, ///< arg is the new cycle length
+        Adherence        ///< value is the new adherence score
+    };
+
+    static const quint32 SEGMENT_RECORDS = 65536; ///< Records per segment, 2 MB files
+
+    EventLog();
+    ~EventLog();
+
+    bool open(const QString &dir);
+    void close();
+    bool isOpen() const;
+    bool append(quint16 type, quint8 mode = 0, float value = 0, quint32 arg = 0, EventRecord *written = nullptr);
+    quint64 count() const;
+
+    static bool read(const QString &dir, quint64 fromSequence, const std::function<void(const EventRecord &)> &callback,
+                     QTextStream *report = nullptr);
+    static bool dump(const QString &dir, QTextStream &out);
+    static QString typeName(quint16 type);
+
+private:
+    bool rollover();
+    bool prepareSpare();
+    EventLogData *d;
+    Q_DISABLE_COPY(EventLog)
+};
+
+#endif // EVENTLOG_H
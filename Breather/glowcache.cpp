@@ -0,0 +1,226 @@
+#include "glowcache.h"
+#include "renderer.h"
+#include <QPainter>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <cstring>
+
+namespace
+{
+
+/*!
+ * \brief The GlowTint struct The blurred coverage tinted with one quantized color
+ */
+struct GlowTint
+{
+    QImage image;       ///< Premultiplied ARGB
+    quint32 key = 0;    ///< Quantized color, see tintKey()
+    quint64 lastUse = 0;
+};
+
+/*!
+ * \brief The GlowSprite struct Blurred coverage of one shape bucket and its most recently used tints
+ */
+struct GlowSprite
+{
+    QImage alpha;       ///< Blurred coverage, Format_Alpha8
+    QVector<GlowTint> tints;
+};
+
+QHash<quint64,GlowSprite> sprites; ///< Key: shape, radius, bucket width and height
+QMutex spritesMutex;
+const int MAX_SPRITES = 64;        ///< Beyond this the cache starts over
+const int TINTS_PER_SPRITE = 2;    ///< Tints kept per sprite, two shapes of one size in different colors
+const int TINT_BITS = 5;           ///< Bits per channel a tint is quantized to, a ramp tints again every few frames
+quint64 tintUseCounter = 0;
+
+/// Box blur passes, three boxes are within a few percent of a gaussian
+const int PASSES = 3;
+
+/*!
+ * \brief tintKey Quantize a color to TINT_BITS per channel
+ */
+quint32 tintKey(const QColor &color)
+{
+    const int shift = 8 - TINT_BITS;
+    return quint32(color.red() >> shift) << 3*TINT_BITS | quint32(color.green() >> shift) << 2*TINT_BITS
+         | quint32(color.blue() >> shift) << TINT_BITS | quint32(color.alpha() >> shift);
+}
+
+/*!
+ * \brief tintColor The color a quantized key stands for, its levels spread over the full 0-255 range
+ */
+QColor tintColor(quint32 key)
+{
+    const quint32 mask = (1u << TINT_BITS) - 1;
+    auto expand = [mask](quint32 level) { return int(level * 255 / mask); };
+    return QColor(expand(key >> 3*TINT_BITS & mask), expand(key >> 2*TINT_BITS & mask),
+                  expand(key >> TINT_BITS & mask), expand(key & mask));
+}
+
+/*!
+ * \brief buildSprite Draw the shape's coverage with room for the glow around it and blur it
+ */
+QImage buildSprite(quint8 shape, const QSize &bucket, int radius)
+{
+    const int margin = PASSES * radius;
+    QImage plane(bucket.width() + 2*margin, bucket.height() + 2*margin, QImage::Format_Alpha8);
+    plane.fill(0);
+    QPainter qp(&plane);
+    qp.setRenderHint(QPainter::Antialiasing);
+    qp.setPen(Qt::NoPen);
+    qp.setBrush(Qt::black);
+    Renderer::drawShape(qp, QRect(QPoint(margin, margin), bucket), shape);
+    qp.end();
+    GlowCache::boxBlur(plane, radius);
+    return plane;
+}
+
+}
+
+/*!
+ * \brief GlowCache::blurColumns One vertical box blur pass, all columns at once
+ *  The running sums of a whole row are updated together, which keeps every inner loop free of
+ *  dependencies between neighbouring pixels so it vectorizes. Edges are clamped.
+ * \param plane 8 bit samples
+ * \param width
+ * \param height
+ * \param stride Bytes per row
+ * \param radius
+ */
+void GlowCache::blurColumns(uchar *plane, int width, int height, int stride, int radius)
+{
+    if (radius <= 0 || height <= 1) return;
+    const quint32 scale = (65536 + radius) / (2*radius + 1); // 1/(2r+1) in 16.16 fixed point
+    QVector<quint32> sums(width);
+    QVector<uchar> source(width * height);
+    quint32 *sum = sums.data();
+    uchar *src = source.data();
+    for (int y = 0; y < height; y++)
+        memcpy(src + y*width, plane + y*stride, width);
+
+    // Window around row 0 with the top edge repeated
+    for (int x = 0; x < width; x++) sum[x] = src[x] * quint32(radius + 1);
+    for (int k = 1; k <= radius; k++)
+    {
+        const uchar *row = src + qMin(k, height - 1)*width;
+        for (int x = 0; x < width; x++) sum[x] += row[x];
+    }
+    for (int y = 0; y < height; y++)
+    {
+        uchar *out = plane + y*stride;
+        for (int x = 0; x < width; x++) out[x] = uchar((sum[x]*scale + 32768) >> 16);
+        const uchar *add = src + qMin(y + radius + 1, height - 1)*width;
+        const uchar *sub = src + qMax(y - radius, 0)*width;
+        for (int x = 0; x < width; x++) sum[x] += add[x] - sub[x];
+    }
+}
+
+/*!
+ * \brief GlowCache::transpose Swap rows and columns, so horizontal passes can run as column passes
+ * \param in
+ * \param width Of the input
+ * \param height Of the input
+ * \param inStride
+ * \param out Receives height columns by width rows
+ * \param outStride
+ */
+void GlowCache::transpose(const uchar *in, int width, int height, int inStride, uchar *out, int outStride)
+{
+    // Blocks keep both sides in cache
+    const int block = 32;
+    for (int by = 0; by < height; by += block)
+        for (int bx = 0; bx < width; bx += block)
+            for (int y = by; y < qMin(by + block, height); y++)
+                for (int x = bx; x < qMin(bx + block, width); x++)
+                    out[x*outStride + y] = in[y*inStride + x];
+}
+
+/*!
+ * \brief GlowCache::boxBlur Separable multi-pass box blur of an 8 bit plane
+ * \param plane Format_Alpha8 or Format_Grayscale8
+ * \param radius
+ */
+void GlowCache::boxBlur(QImage &plane, int radius)
+{
+    const int w = plane.width(), h = plane.height();
+    QVector<uchar> turned(w * h);
+    for (int pass = 0; pass < PASSES; pass++)
+    {
+        blurColumns(plane.bits(), w, h, plane.bytesPerLine(), radius);
+        transpose(plane.constBits(), w, h, plane.bytesPerLine(), turned.data(), h);
+        blurColumns(turned.data(), h, w, h, radius);
+        transpose(turned.constData(), h, w, h, plane.bits(), plane.bytesPerLine());
+    }
+}
+
+/*!
+ * \brief GlowCache::bounds Rect the glow of a shape is drawn in
+ *  The sprite's margin is scaled down onto the shape rect, so it never reaches further than unscaled.
+ * \param xywh Rect the shape is drawn in
+ * \param radius
+ * \return Empty for no glow
+ */
+QRect GlowCache::bounds(const QRect &xywh, quint8 radius)
+{
+    if (xywh.isEmpty() || !radius) return QRect();
+    const int margin = PASSES * radius + 1;
+    return xywh.adjusted(-margin, -margin, margin, margin);
+}
+
+/*!
+ * \brief GlowCache::draw Blit the glow of a shape around its rect, blurring it first if this bucket is new
+ * \param qp
+ * \param xywh Rect the shape is drawn in
+ * \param shape
+ * \param radius Blur radius of one box pass in pixels, the glow reaches about three times as far
+ * \param color Glow color, its alpha sets the strength
+ */
+void GlowCache::draw(QPainter &qp, const QRect &xywh, quint8 shape, quint8 radius, const QColor &color)
+{
+    if (xywh.isEmpty() || !radius) return;
+    auto up = [](int v) { return qMax(BUCKET_PX, (v + BUCKET_PX - 1) / BUCKET_PX * BUCKET_PX); };
+    QSize bucket(up(xywh.width()), up(xywh.height()));
+    quint64 key = quint64(shape) << 48 | quint64(radius) << 40 | quint64(bucket.width()) << 20 | quint64(bucket.height());
+    quint32 tint = tintKey(color);
+
+    QImage image;
+    {
+        QMutexLocker lock(&spritesMutex);
+        auto found = sprites.find(key);
+        if (found == sprites.end())
+        {
+            if (sprites.size() >= MAX_SPRITES) sprites.clear();
+            found = sprites.insert(key, GlowSprite());
+            found->alpha = buildSprite(shape, bucket, radius);
+        }
+        GlowTint *tinted = nullptr;
+        for (GlowTint &cached : found->tints)
+            if (cached.key == tint) tinted = &cached;
+        if (!tinted)
+        {
+            if (found->tints.size() < TINTS_PER_SPRITE) found->tints.append(GlowTint());
+            tinted = &found->tints.first();
+            for (GlowTint &cached : found->tints)
+                if (cached.lastUse < tinted->lastUse) tinted = &cached;
+            tinted->key = tint;
+            tinted->image = QImage(found->alpha.size(), QImage::Format_ARGB32_Premultiplied);
+            tinted->image.fill(tintColor(tint));
+            QPainter tinter(&tinted->image);
+            tinter.setCompositionMode(QPainter::CompositionMode_DestinationIn);
+            tinter.drawImage(0, 0, found->alpha);
+            tinter.end();
+        }
+        tinted->lastUse = ++tintUseCounter;
+        image = tinted->image;
+    }
+
+    const int margin = PASSES * radius;
+    qreal sx = qreal(xywh.width()) / bucket.width(), sy = qreal(xywh.height()) / bucket.height();
+    QRectF target(xywh.x() - margin*sx, xywh.y() - margin*sy, image.width()*sx, image.height()*sy);
+    qp.save();
+    qp.setRenderHint(QPainter::SmoothPixmapTransform);
+    qp.drawImage(target, image);
+    qp.restore();
+}
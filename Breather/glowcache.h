@@ -0,0 +1,34 @@
+#ifndef GLOWCACHE_H
+#define GLOWCACHE_H
+
+#include <QImage>
+#include <QRect>
+#include <QColor>
+
+class QPainter;
+
+/*!
+ * \brief The GlowCache class Soft glow sprites around shapes, blurred once per size bucket
+ *  A sprite is the shape's coverage in an 8 bit alpha plane, blurred with three separable box
+ *  blur passes, which is close to a gaussian. The box blurs are running sums over whole rows at
+ *  a time, so the inner loops are plain array arithmetic the compiler turns into SIMD on SSE2 or
+ *  NEON alike. Sizes are rounded up to BUCKET_PX and the sprite is scaled onto the exact rect, so
+ *  a growing shape only blurs again every few pixels, and never once a cycle has been seen.
+ *  Tinted sprites are kept for the last two colors, quantized to 5 bits per channel, so a frame
+ *  is a single blit and a color ramp or morph only tints again every few frames rather than on
+ *  every one. Safe to use from several threads.
+ */
+class GlowCache
+{
+public:
+    static const int BUCKET_PX = 16;
+
+    static void draw(QPainter &qp, const QRect &xywh, quint8 shape, quint8 radius, const QColor &color);
+    static QRect bounds(const QRect &xywh, quint8 radius);
+
+    static void boxBlur(QImage &plane, int radius);
+    static void blurColumns(uchar *plane, int width, int height, int stride, int radius);
+    static void transpose(const uchar *in, int width, int height, int inStride, uchar *out, int outStride);
+};
+
+#endif // GLOWCACHE_H
@@ -0,0 +1,613 @@
+#include "historyexporter.h"
+#include "eventlog.h"
+#include "mode.h"
+#include "logging.h"
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+// Parquet format constants, see parquet.thrift
+enum PhysicalType { INT32 = 1, INT64 = 2, FLOAT = 4, BYTE_ARRAY = 6 };
+enum ConvertedType { NO_CONVERSION = -1, UTF8 = 0, TIMESTAMP_MILLIS = 9 };
+enum Encoding { PLAIN = 0, RLE = 3, DELTA_BINARY_PACKED = 5, RLE_DICTIONARY = 8 };
+enum PageType { DATA_PAGE = 0, DICTIONARY_PAGE = 2 };
+const int GZIP = 2;
+const int REQUIRED = 0;
+const quint8 NO_PHASE = 0xFF; ///< Phase of events that do not refer to one
+
+// Thrift compact protocol field types
+enum ThriftType : quint8 { T_I32 = 5, T_I64 = 6, T_BINARY = 8, T_LIST = 9, T_STRUCT = 12 };
+
+const int DELTA_BLOCK = 128;     ///< Values per block of DELTA_BINARY_PACKED
+const int DELTA_MINIBLOCKS = 4;  ///< Miniblocks per block, of 32 values each
+const int DELTA_MINIBLOCK = DELTA_BLOCK / DELTA_MINIBLOCKS;
+
+/*!
+ * \brief The Column struct Schema of one exported column
+ */
+struct Column
+{
+    const char *name;
+    int type;
+    int converted;
+};
+
+enum ColumnIndex { TimeColumn, EventColumn, PhaseColumn, LengthColumn, ValueColumn, COLUMNS };
+
+const Column columns[COLUMNS] =
+{
+    { "time",      INT64,      TIMESTAMP_MILLIS },
+    { "event",     BYTE_ARRAY, UTF8             },
+    { "phase",     BYTE_ARRAY, UTF8             },
+    { "length_ms", INT32,      NO_CONVERSION    },
+    { "value",     FLOAT,      NO_CONVERSION    }
+};
+
+void varint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80)
+    {
+        out.append(char(value | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+quint64 zigzag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+void appendLE32(QByteArray &out, quint32 value)
+{
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char *>(&value), 4);
+}
+
+/*!
+ * \brief bitPack Append values of a fixed bit width, least significant bit first
+ *  Callers pack multiples of 8 values, so the output always ends on a byte boundary.
+ */
+void bitPack(QByteArray &out, const quint64 *values, int count, int width)
+{
+    quint64 acc = 0;
+    int bits = 0;
+    for (int i = 0; i < count; i++)
+    {
+        quint64 value = values[i];
+        int left = width;
+        while (left > 0)
+        {
+            int take = qMin(left, 64 - bits);
+            quint64 mask = take == 64 ? ~quint64(0) : (quint64(1) << take) - 1;
+            acc |= (value & mask) << bits;
+            value = take == 64 ? 0 : value >> take;
+            bits += take;
+            left -= take;
+            while (bits >= 8)
+            {
+                out.append(char(acc & 0xFF));
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+    }
+    if (bits) out.append(char(acc & 0xFF));
+}
+
+int bitWidth(quint64 value)
+{
+    int width = 0;
+    while (value)
+    {
+        width++;
+        value >>= 1;
+    }
+    return width;
+}
+
+/*!
+ * \brief deltaBinaryPacked Encode timestamps as deltas from their predecessor
+ *  Each block stores its smallest delta as a zigzag varint and packs the rest relative to it with
+ *  as few bits per miniblock as they need, so a steady rhythm costs a few bits per event.
+ */
+QByteArray deltaBinaryPacked(const QVector<qint64> &values)
+{
+    QByteArray out;
+    varint(out, DELTA_BLOCK);
+    varint(out, DELTA_MINIBLOCKS);
+    varint(out, quint64(values.size()));
+    varint(out, zigzag(values.isEmpty() ? 0 : values.first()));
+
+    quint64 deltas[DELTA_BLOCK];
+    for (int start = 1; start < values.size(); start += DELTA_BLOCK)
+    {
+        int count = qMin(DELTA_BLOCK, values.size() - start);
+        qint64 minDelta = std::numeric_limits<qint64>::max();
+        for (int i = 0; i < count; i++)
+        {
+            // Deltas wrap around like the reader's arithmetic does
+            qint64 delta = qint64(quint64(values[start + i]) - quint64(values[start + i - 1]));
+            deltas[i] = quint64(delta);
+            minDelta = qMin(minDelta, delta);
+        }
+        for (int i = 0; i < count; i++) deltas[i] -= quint64(minDelta);
+        for (int i = count; i < DELTA_BLOCK; i++) deltas[i] = 0;
+
+        varint(out, zigzag(minDelta));
+        int used = (count + DELTA_MINIBLOCK - 1) / DELTA_MINIBLOCK;
+        int widths[DELTA_MINIBLOCKS] = {};
+        for (int m = 0; m < used; m++)
+        {
+            quint64 bits = 0;
+            for (int i = 0; i < DELTA_MINIBLOCK; i++) bits |= deltas[m * DELTA_MINIBLOCK + i];
+            widths[m] = bitWidth(bits);
+        }
+        for (int m = 0; m < DELTA_MINIBLOCKS; m++) out.append(char(widths[m]));
+        for (int m = 0; m < used; m++) bitPack(out, deltas + m * DELTA_MINIBLOCK, DELTA_MINIBLOCK, widths[m]);
+    }
+    return out;
+}
+
+/*!
+ * \brief rleDictionaryIndices Encode dictionary indices with the RLE/bit-packing hybrid
+ *  Runs of 8 or more equal indices, like an event type repeated all session, become one run;
+ *  everything else is bit-packed in groups of 8.
+ */
+QByteArray rleDictionaryIndices(const QVector<quint32> &ids, int dictionarySize)
+{
+    int width = qMax(1, bitWidth(quint64(dictionarySize - 1)));
+    QByteArray out;
+    out.append(char(width));
+    QVector<quint64> packed;
+    auto flushPacked = [&]()
+    {
+        if (packed.isEmpty()) return;
+        varint(out, (quint64(packed.size() / 8) << 1) | 1);
+        bitPack(out, packed.constData(), packed.size(), width);
+        packed.clear();
+    };
+
+    int i = 0;
+    while (i < ids.size())
+    {
+        int run = 1;
+        while (i + run < ids.size() && ids[i + run] == ids[i]) run++;
+        if (run >= 8)
+        {
+            flushPacked();
+            varint(out, quint64(run) << 1);
+            for (int byte = 0; byte < (width + 7) / 8; byte++) out.append(char(ids[i] >> (8 * byte)));
+            i += run;
+        }
+        else
+        {
+            for (int k = 0; k < 8; k++) packed.append(i + k < ids.size() ? ids[i + k] : 0);
+            i += 8;
+        }
+    }
+    flushPacked();
+    return out;
+}
+
+/*!
+ * \brief crc32 Checksum of the gzip trailer
+ */
+quint32 crc32(const QByteArray &data)
+{
+    static quint32 table[256];
+    static bool initialized = false;
+    if (!initialized)
+    {
+        for (quint32 n = 0; n < 256; n++)
+        {
+            quint32 c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        initialized = true;
+    }
+    quint32 crc = 0xFFFFFFFFu;
+    for (char byte : data) crc = table[(crc ^ quint8(byte)) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+/*!
+ * \brief gzip Compress a page for the GZIP codec
+ *  qCompress produces a size prefix and a zlib stream; its deflate data is rewrapped as gzip.
+ */
+QByteArray gzip(const QByteArray &data)
+{
+    QByteArray zlib = qCompress(data, 6);
+    QByteArray out("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff", 10);
+    out.append(zlib.constData() + 6, zlib.size() - 10);
+    appendLE32(out, crc32(data));
+    appendLE32(out, quint32(data.size()));
+    return out;
+}
+
+/*!
+ * \brief The Thrift class Writer of the Thrift compact protocol the Parquet metadata is serialized with
+ */
+class Thrift
+{
+public:
+    QByteArray out;
+
+    void beginStruct()
+    {
+        lastIds.append(lastId);
+        lastId = 0;
+    }
+
+    void endStruct()
+    {
+        out.append(char(0));
+        lastId = lastIds.takeLast();
+    }
+
+    void i32(qint16 id, qint32 value)
+    {
+        field(id, T_I32);
+        varint(out, zigzag(value));
+    }
+
+    void i64(qint16 id, qint64 value)
+    {
+        field(id, T_I64);
+        varint(out, zigzag(value));
+    }
+
+    void binary(qint16 id, const QByteArray &value)
+    {
+        field(id, T_BINARY);
+        binaryElement(value);
+    }
+
+    void list(qint16 id, ThriftType type, int size)
+    {
+        field(id, T_LIST);
+        if (size < 15) out.append(char((size << 4) | type));
+        else
+        {
+            out.append(char(0xF0 | type));
+            varint(out, quint64(size));
+        }
+    }
+
+    void structField(qint16 id)
+    {
+        field(id, T_STRUCT);
+        beginStruct();
+    }
+
+    void i32Element(qint32 value) { varint(out, zigzag(value)); }
+
+    void binaryElement(const QByteArray &value)
+    {
+        varint(out, quint64(value.size()));
+        out.append(value);
+    }
+
+private:
+    void field(qint16 id, ThriftType type)
+    {
+        if (id > lastId && id - lastId <= 15) out.append(char(((id - lastId) << 4) | type));
+        else
+        {
+            out.append(char(type));
+            varint(out, zigzag(id));
+        }
+        lastId = id;
+    }
+
+    QVector<qint16> lastIds;
+    qint16 lastId = 0;
+};
+
+/*!
+ * \brief The Dictionary struct Distinct values of one column chunk and the index of every row into them
+ */
+template<typename T>
+struct Dictionary
+{
+    QHash<T, quint32> index;
+    QVector<T> values;
+    QVector<quint32> ids;
+
+    void add(const T &value)
+    {
+        auto it = index.constFind(value);
+        if (it == index.constEnd())
+        {
+            it = index.insert(value, quint32(values.size()));
+            values.append(value);
+        }
+        ids.append(*it);
+    }
+
+    void clear()
+    {
+        index.clear();
+        values.clear();
+        ids.clear();
+    }
+};
+
+/*!
+ * \brief The Chunk struct Where one column of a row group was written, for the footer
+ */
+struct Chunk
+{
+    qint64 dictionaryOffset = -1;
+    qint64 dataOffset = 0;
+    qint64 uncompressed = 0;
+    qint64 compressed = 0;
+    QVector<int> encodings;
+};
+
+struct RowGroup
+{
+    Chunk chunks[COLUMNS];
+    qint64 rows = 0;
+    qint64 bytes = 0;
+};
+
+QByteArray phaseName(quint8 mode)
+{
+    switch (mode)
+    {
+    case Modes::Inhale:  return "inhale";
+    case Modes::HoldIn:  return "hold-in";
+    case Modes::Exhale:  return "exhale";
+    case Modes::HoldOut: return "hold-out";
+    }
+    return QByteArray();
+}
+
+/*!
+ * \brief The ParquetWriter class Buffers one row group of events as columns and writes it out when full
+ */
+class ParquetWriter
+{
+public:
+    explicit ParquetWriter(const QString &path) : file(path) {}
+
+    bool open()
+    {
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+        return write(QByteArray("PAR1", 4));
+    }
+
+    void add(const EventRecord &record)
+    {
+        time.append(record.timeMS);
+        event.add(record.type);
+        bool phased = record.type == EventLog::Phase || record.type == EventLog::Adherence;
+        phase.add(phased ? record.mode : NO_PHASE);
+        length.add(qint32(record.arg));
+        value.append(record.value);
+        if (time.size() >= HistoryExporter::ROW_GROUP_ROWS) flush();
+    }
+
+    bool finish()
+    {
+        flush();
+        Thrift meta;
+        meta.beginStruct();
+        meta.i32(1, 1);
+        meta.list(2, T_STRUCT, 1 + COLUMNS);
+        meta.beginStruct();
+        meta.binary(4, "schema");
+        meta.i32(5, COLUMNS);
+        meta.endStruct();
+        for (const Column &column : columns)
+        {
+            meta.beginStruct();
+            meta.i32(1, column.type);
+            meta.i32(3, REQUIRED);
+            meta.binary(4, column.name);
+            if (column.converted != NO_CONVERSION) meta.i32(6, column.converted);
+            meta.endStruct();
+        }
+        meta.i64(3, rows);
+        meta.list(4, T_STRUCT, groups.size());
+        for (const RowGroup &group : groups)
+        {
+            meta.beginStruct();
+            meta.list(1, T_STRUCT, COLUMNS);
+            for (int c = 0; c < COLUMNS; c++)
+            {
+                const Chunk &chunk = group.chunks[c];
+                meta.beginStruct();
+                meta.i64(2, chunk.dictionaryOffset >= 0 ? chunk.dictionaryOffset : chunk.dataOffset);
+                meta.structField(3);
+                meta.i32(1, columns[c].type);
+                meta.list(2, T_I32, chunk.encodings.size());
+                for (int encoding : chunk.encodings) meta.i32Element(encoding);
+                meta.list(3, T_BINARY, 1);
+                meta.binaryElement(columns[c].name);
+                meta.i32(4, GZIP);
+                meta.i64(5, group.rows);
+                meta.i64(6, chunk.uncompressed);
+                meta.i64(7, chunk.compressed);
+                meta.i64(9, chunk.dataOffset);
+                if (chunk.dictionaryOffset >= 0) meta.i64(11, chunk.dictionaryOffset);
+                meta.endStruct();
+                meta.endStruct();
+            }
+            meta.i64(2, group.bytes);
+            meta.i64(3, group.rows);
+            meta.endStruct();
+        }
+        meta.binary(6, "Breather");
+        meta.endStruct();
+
+        QByteArray footer = meta.out;
+        appendLE32(footer, quint32(meta.out.size()));
+        footer.append("PAR1", 4);
+        bool ok = !failed && write(footer);
+        file.close();
+        return ok;
+    }
+
+    qint64 rowCount() const { return rows; }
+    qint64 size() const { return offset; }
+
+private:
+    bool write(const QByteArray &data)
+    {
+        if (failed || file.write(data) != data.size())
+        {
+            failed = true;
+            return false;
+        }
+        offset += data.size();
+        return true;
+    }
+
+    /*!
+     * \brief writePage Compress a page and write it with its header, returns where it starts
+     */
+    qint64 writePage(Chunk &chunk, PageType type, const QByteArray &data, int count, int encoding)
+    {
+        QByteArray compressed = gzip(data);
+        Thrift header;
+        header.beginStruct();
+        header.i32(1, type);
+        header.i32(2, data.size());
+        header.i32(3, compressed.size());
+        header.structField(type == DATA_PAGE ? 5 : 7);
+        header.i32(1, count);
+        header.i32(2, encoding);
+        if (type == DATA_PAGE)
+        {
+            header.i32(3, RLE);
+            header.i32(4, RLE);
+        }
+        header.endStruct();
+        header.endStruct();
+
+        qint64 start = offset;
+        write(header.out);
+        write(compressed);
+        chunk.uncompressed += header.out.size() + data.size();
+        chunk.compressed += header.out.size() + compressed.size();
+        return start;
+    }
+
+    template<typename T, typename Plain>
+    void writeDictionaryColumn(Chunk &chunk, const Dictionary<T> &dictionary, Plain plain)
+    {
+        QByteArray entries;
+        for (const T &value : dictionary.values) plain(entries, value);
+        chunk.dictionaryOffset = writePage(chunk, DICTIONARY_PAGE, entries, dictionary.values.size(), PLAIN);
+        chunk.dataOffset = writePage(chunk, DATA_PAGE, rleDictionaryIndices(dictionary.ids, dictionary.values.size()),
+                                     dictionary.ids.size(), RLE_DICTIONARY);
+        chunk.encodings = { PLAIN, RLE, RLE_DICTIONARY };
+    }
+
+    void flush()
+    {
+        if (time.isEmpty()) return;
+        RowGroup group;
+        group.rows = time.size();
+        qint64 start = offset;
+
+        Chunk &timeChunk = group.chunks[TimeColumn];
+        timeChunk.dataOffset = writePage(timeChunk, DATA_PAGE, deltaBinaryPacked(time), time.size(), DELTA_BINARY_PACKED);
+        timeChunk.encodings = { RLE, DELTA_BINARY_PACKED };
+
+        auto plainString = [](QByteArray &out, const QByteArray &text)
+        {
+            appendLE32(out, quint32(text.size()));
+            out.append(text);
+        };
+        writeDictionaryColumn(group.chunks[EventColumn], event, [&](QByteArray &out, quint16 type)
+        {
+            plainString(out, EventLog::typeName(type).toUtf8());
+        });
+        writeDictionaryColumn(group.chunks[PhaseColumn], phase, [&](QByteArray &out, quint8 mode)
+        {
+            plainString(out, phaseName(mode));
+        });
+        writeDictionaryColumn(group.chunks[LengthColumn], length, [](QByteArray &out, qint32 ms)
+        {
+            appendLE32(out, quint32(ms));
+        });
+
+        QByteArray floats;
+        floats.reserve(value.size() * 4);
+        for (float score : value)
+        {
+            quint32 bits;
+            memcpy(&bits, &score, 4);
+            appendLE32(floats, bits);
+        }
+        Chunk &valueChunk = group.chunks[ValueColumn];
+        valueChunk.dataOffset = writePage(valueChunk, DATA_PAGE, floats, value.size(), PLAIN);
+        valueChunk.encodings = { RLE, PLAIN };
+
+        for (const Chunk &chunk : group.chunks) group.bytes += chunk.uncompressed;
+        rows += group.rows;
+        groups.append(group);
+        qCDebug(lcMain) << "History export: row group of" << group.rows << "rows," << offset - start << "bytes";
+
+        time.clear();
+        event.clear();
+        phase.clear();
+        length.clear();
+        value.clear();
+    }
+
+    QFile file;
+    qint64 offset = 0;
+    qint64 rows = 0;
+    bool failed = false;
+    QVector<RowGroup> groups;     ///< Footer data only, a few hundred bytes per row group
+
+    QVector<qint64> time;
+    Dictionary<quint16> event;
+    Dictionary<quint8> phase;
+    Dictionary<qint32> length;
+    QVector<float> value;
+};
+}
+
+/*!
+ * \brief HistoryExporter::run Export the whole event log of a directory into a Parquet file
+ * \param logDir Event log directory
+ * \param path Parquet file to write
+ * \return False when the log cannot be read or the file cannot be written
+ */
+bool HistoryExporter::run(const QString &logDir, const QString &path)
+{
+    QElapsedTimer timer;
+    timer.start();
+    ParquetWriter writer(path);
+    if (!writer.open())
+    {
+        qCWarning(lcMain) << "History export: cannot write" << path;
+        return false;
+    }
+    if (!EventLog::read(logDir, 1, [&writer](const EventRecord &record) { writer.add(record); }))
+    {
+        qCWarning(lcMain) << "History export: no event log in" << logDir;
+        return false;
+    }
+    if (!writer.finish())
+    {
+        qCWarning(lcMain) << "History export: writing" << path << "failed";
+        return false;
+    }
+    qCInfo(lcMain) << "History export:" << writer.rowCount() << "events," << writer.size() << "bytes in"
+                   << timer.elapsed() << "ms";
+    return true;
+}
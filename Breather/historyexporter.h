@@ -0,0 +1,25 @@
+#ifndef HISTORYEXPORTER_H
+#define HISTORYEXPORTER_H
+
+#include <QString>
+
+/*!
+ * \brief The HistoryExporter class Converts the event log into a columnar Parquet file for analysis
+ *  Events are streamed out of the log into row groups of ROW_GROUP_ROWS rows, so memory stays
+ *  bounded however long the history is. Every column has the encoding that suits its data:
+ *   - time       timestamp in ms, delta encoded and bit-packed (DELTA_BINARY_PACKED)
+ *   - event      event name, dictionary encoded with run-length/bit-packed indices
+ *   - phase      phase name for phase and adherence events, dictionary encoded
+ *   - length_ms  phase, pause or cycle length, dictionary encoded
+ *   - value      adherence score, plain floats
+ *  Pages are gzip compressed. The result loads straight into pandas, DuckDB or Arrow.
+ */
+class HistoryExporter
+{
+public:
+    static const int ROW_GROUP_ROWS = 65536;
+
+    static bool run(const QString &logDir, const QString &path);
+};
+
+#endif // HISTORYEXPORTER_H
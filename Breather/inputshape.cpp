@@ -0,0 +1,92 @@
+#include "inputshape.h"
+#include "renderer.h"
+#include "mode.h"
+
+/*!
+ * \brief Margin added around the shapes so thick focus outlines and antialiased edges stay inside the region
+ */
+static const int SHAPE_MARGIN = 3;
+
+/*!
+ * \brief InputShape::InputShape Constructor
+ * \param step Grid size in pixels
+ */
+InputShape::InputShape(quint8 step)
+    : step(step ? step : 1)
+{
+}
+
+/*!
+ * \brief InputShape::quantize Grow a rect outwards to the enclosing grid cells
+ * \param rect
+ * \param step
+ * \return
+ */
+QRect InputShape::quantize(const QRect &rect, quint8 step)
+{
+    if (rect.isEmpty()) return QRect();
+    QRect grown = rect.adjusted(-SHAPE_MARGIN, -SHAPE_MARGIN, SHAPE_MARGIN, SHAPE_MARGIN);
+    auto floorTo = [step](int v) { return v >= 0 ? v - v % step : v - (step + v % step) % step; };
+    int left   = floorTo(grown.left());
+    int top    = floorTo(grown.top());
+    int right  = floorTo(grown.right()) + step;
+    int bottom = floorTo(grown.bottom()) + step;
+    return QRect(QPoint(left, top), QPoint(right - 1, bottom - 1));
+}
+
+/*!
+ * \brief InputShape::update Recompute the quantized shape rects for a frame
+ * \param size Size of the window the frame is drawn in
+ * \param state
+ * \param effects Rect drawn outside the shapes, see Renderer::effectsRect
+ * \return True when the region differs from the previous one and the window mask has to be set again
+ */
+bool InputShape::update(const QPoint &size, const FrameState &state, const QRect &effects)
+{
+    QRect newCurr, newLast, newEffects = quantize(effects, step);
+    quint8 newCurrShape = 0, newLastShape = 0;
+    if (state.currMode)
+    {
+        newCurr = quantize(state.currMode->getShapeCoord(state.elapsedMS, size), step);
+        newCurrShape = state.currMode->getShape();
+    }
+    if (state.lastMode)
+    {
+        newLast = quantize(state.lastMode->getEndShapeCoord(size), step);
+        newLastShape = state.lastMode->getShape();
+    }
+    if (valid && newCurr == curr && newLast == last && newEffects == this->effects
+            && newCurrShape == currShape && newLastShape == lastShape)
+        return false;
+    curr = newCurr;
+    last = newLast;
+    this->effects = newEffects;
+    currShape = newCurrShape;
+    lastShape = newLastShape;
+    valid = true;
+    return true;
+}
+
+/*!
+ * \brief InputShape::region Region covering both shapes and their effects; ellipses keep their outline, other shapes use their rect
+ *  Never empty, since an empty mask would remove the mask and make the whole window clickable.
+ * \return
+ */
+QRegion InputShape::region() const
+{
+    QRegion region(curr, currShape == Shape::Ellipse ? QRegion::Ellipse : QRegion::Rectangle);
+    if (!last.isEmpty())
+        region += QRegion(last, lastShape == Shape::Ellipse ? QRegion::Ellipse : QRegion::Rectangle);
+    if (!effects.isEmpty())
+        region += effects;
+    if (region.isEmpty()) region = QRegion(0, 0, 1, 1);
+    return region;
+}
+
+/*!
+ * \brief InputShape::invalidate Force the next update to report a change, e.g. after the window was recreated
+ */
+void InputShape::invalidate()
+{
+    valid = false;
+}
@@ -0,0 +1,39 @@
+#ifndef INPUTSHAPE_H
+#define INPUTSHAPE_H
+
+#include <QRect>
+#include <QRegion>
+
+struct FrameState;
+
+/*!
+ * \brief The InputShape class Input region of an overlay that lets clicks through outside the shapes
+ *  The region is built from the shape rects snapped outwards to a coarse grid, so it only changes
+ *  when a shape has grown or moved past the next grid line. Callers only touch the window mask
+ *  when update() reports a change; no bitmap mask is ever rendered.
+ *  A top level window's mask clips what it shows as well as where it takes input, so the region
+ *  also covers the rect of the glow, particles, measured bar and morph around the shapes. Clicks
+ *  in that rect are caught rather than passed through.
+ */
+class InputShape
+{
+public:
+    InputShape(quint8 step = 16);
+
+    bool update(const QPoint &size, const FrameState &state, const QRect &effects);
+    QRegion region() const;
+    void invalidate();
+
+    static QRect quantize(const QRect &rect, quint8 step);
+
+private:
+    quint8 step;            ///< Grid size in pixels, the threshold a shape must cross to change the region
+    QRect curr;             ///< Quantized rect of the active shape
+    QRect last;             ///< Quantized rect of the previous shape, empty in the first phase
+    QRect effects;          ///< Quantized rect drawn around the shapes, empty without effects
+    quint8 currShape = 0;   ///< Shape type of the active mode
+    quint8 lastShape = 0;   ///< Shape type of the previous mode
+    bool valid = false;     ///< False until the first update, or after invalidate()
+};
+
+#endif // INPUTSHAPE_H
@@ -0,0 +1,129 @@
+#include "logging.h"
+#include "ringbuffer.h"
+#include <QThread>
+#include <QSemaphore>
+#include <QString>
+#include <atomic>
+#include <cstdio>
+
+Q_LOGGING_CATEGORY(lcMain,   "breather.main",   QtWarningMsg)
+Q_LOGGING_CATEGORY(lcMode,   "breather.mode",   QtWarningMsg)
+Q_LOGGING_CATEGORY(lcDialog, "breather.dialog", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcInput,  "breather.input",  QtWarningMsg)
+Q_LOGGING_CATEGORY(lcQuality, "breather.quality", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcBreath, "breather.breath", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcMetrics, "breather.metrics", QtInfoMsg)
+
+namespace
+{
+
+/*!
+ * \brief The LogWriter class Background thread draining the log queue to stderr
+ */
+class LogWriter : public QThread
+{
+public:
+    MpscRingBuffer<QString, 1024> queue; ///< Formatted lines waiting to be written
+    QSemaphore pending;                  ///< Counts queued lines so the writer sleeps while idle
+    std::atomic<bool> running {true};
+    std::atomic<quint64> dropped {0};    ///< Lines lost because the queue was full
+
+protected:
+    void run() override
+    {
+        while (running.load(std::memory_order_acquire))
+        {
+            pending.acquire();
+            // Take whatever else arrived meanwhile in the same wake-up
+            pending.tryAcquire(pending.available());
+            drain();
+        }
+        drain();
+    }
+
+private:
+    /*!
+     * \brief drain Write out every queued line, only called on the writer thread
+     */
+    void drain()
+    {
+        QString line;
+        while (queue.pop(line))
+        {
+            QByteArray bytes = line.toLocal8Bit();
+            bytes.append('\n');
+            fwrite(bytes.constData(), 1, bytes.size(), stderr);
+        }
+        fflush(stderr);
+    }
+};
+
+LogWriter *writer = nullptr;
+const unsigned long FATAL_FLUSH_MS = 1000; ///< Longest a fatal message waits for the queued lines
+QtMessageHandler previousHandler = nullptr;
+
+/*!
+ * \brief messageHandler Format on the calling thread and hand the line over to the writer
+ *  Fatal messages bypass the queue so they are on screen before Qt aborts. The writer is the
+ *  only thread that may pop the queue, so it is stopped and joined to flush what is queued.
+ */
+void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg)
+{
+    QString line = qFormatLogMessage(type, context, msg);
+    if (type == QtFatalMsg)
+    {
+        if (QThread::currentThread() != writer)
+        {
+            writer->running.store(false, std::memory_order_release);
+            writer->pending.release();
+            writer->wait(FATAL_FLUSH_MS);
+        }
+        fprintf(stderr, "%s\n", qPrintable(line));
+        fflush(stderr);
+        return;
+    }
+    if (writer->queue.push(std::move(line)))
+        writer->pending.release();
+    else
+        writer->dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+/*!
+ * \brief Logging::install Start the asynchronous writer and route all Qt messages through it
+ */
+void Logging::install()
+{
+    if (writer) return;
+    if (qEnvironmentVariableIsEmpty("QT_MESSAGE_PATTERN"))
+        qSetMessagePattern("%{time hh:mm:ss.zzz} %{if-category}%{category} %{endif}%{type}: %{message}");
+    writer = new LogWriter;
+    writer->start(QThread::LowPriority);
+    previousHandler = qInstallMessageHandler(messageHandler);
+}
+
+/*!
+ * \brief Logging::shutdown Flush pending lines and restore the previous message handler
+ */
+void Logging::shutdown()
+{
+    if (!writer) return;
+    qInstallMessageHandler(previousHandler);
+    writer->running.store(false, std::memory_order_release);
+    writer->pending.release();
+    writer->wait();
+    if (writer->dropped.load())
+        fprintf(stderr, "Breather: %llu log lines dropped\n", (unsigned long long)writer->dropped.load());
+    delete writer;
+    writer = nullptr;
+}
+
+/*!
+ * \brief Logging::droppedMessages
+ * \return Number of log lines dropped because the queue was full
+ */
+quint64 Logging::droppedMessages()
+{
+    return writer ? writer->dropped.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,24 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <QLoggingCategory>
+
+// Categories are disabled below QtWarningMsg by default, so a qCDebug/qCInfo call site costs a
+// single cached bool check. Enable them at runtime with e.g. QT_LOGGING_RULES="breather.*=true",
+// or compile them out completely with CONFIG+=breather_nolog.
+Q_DECLARE_LOGGING_CATEGORY(lcMain)   ///< breather.main   : window life cycle and settings updates
+Q_DECLARE_LOGGING_CATEGORY(lcMode)   ///< breather.mode   : Mode geometry and scaling
+Q_DECLARE_LOGGING_CATEGORY(lcDialog) ///< breather.dialog : settings dialog and config file
+Q_DECLARE_LOGGING_CATEGORY(lcInput)  ///< breather.input  : mouse, wheel and keyboard handling
+Q_DECLARE_LOGGING_CATEGORY(lcQuality) ///< breather.quality : quality governor decisions, on by default
+Q_DECLARE_LOGGING_CATEGORY(lcBreath) ///< breather.breath : breath detection and adherence
+Q_DECLARE_LOGGING_CATEGORY(lcMetrics) ///< breather.metrics : metrics endpoint, on by default
+
+namespace Logging
+{
+    void install();
+    void shutdown();
+    quint64 droppedMessages();
+}
+
+#endif // LOGGING_H
@@ -1,13 +1,195 @@
 #include "mainwindow.h"
-#include <QDebug>
+#include "logging.h"
+#include "metrics.h"
+#include "shaperegistry.h"
+#include "audioengine.h"
+#include "benchmark.h"
+#include "eventlog.h"
+#include "historyexporter.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+
+/*!
+ * \brief isOption Whether a raw argument is the long option name, given as "--name" or "--name=value"
+ */
+static bool isOption(const char *arg, const char *name)
+{
+    uint length = qstrlen(name);
+    return qstrncmp(arg, name, length) == 0 && (arg[length] == '\0' || arg[length] == '=');
+}
+
+/*!
+ * \brief uintOption Read an unsigned option of at most max, leaving value as it is when the option is not given
+ * \return False, after a warning, when the value is not a number from 0 to max
+ */
+static bool uintOption(const QCommandLineParser &parser, const QCommandLineOption &option, uint max, uint &value)
+{
+    if (!parser.isSet(option)) return true;
+    bool ok;
+    uint parsed = parser.value(option).toUInt(&ok);
+    if (!ok || parsed > max)
+    {
+        qCWarning(lcMain) << "Invalid" << qPrintable("--" + option.names().first()) << parser.value(option) << "- expected 0 to" << max;
+        return false;
+    }
+    value = parsed;
+    return true;
+}
 
 int main(int argc, char *argv[])
 {
+    Metrics::processStarted();
+    // Exporting and dumping the event log need no display, so do not require one
+    for (int i = 1; i < argc; i++)
+        if ((isOption(argv[i], "--export") || isOption(argv[i], "--dump-events") ||
+             isOption(argv[i], "--export-history") || isOption(argv[i], "--benchmark")) && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
     QApplication a(argc, argv);
-    qDebug() << "Here";
+    Logging::install();
+    qCDebug(lcMain) << "Here";
     qApp->setApplicationName("Breather");
-    MainWindow w;
-    w.show();
-    return a.exec();
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption metricsPort("metrics-port", "Serve Prometheus metrics on 127.0.0.1:<port>.", "port");
+    parser.addOption(metricsPort);
+    QCommandLineOption backend("backend", "Overlay backend: widget (default) or raster.", "backend", "widget");
+    parser.addOption(backend);
+    QCommandLineOption perPixelAlpha("per-pixel-alpha", "Fold window transparency into the shape colors instead of fading the window.");
+    parser.addOption(perPixelAlpha);
+    QCommandLineOption clickThrough("click-through", "Let clicks reach the windows below: off (default), shape (only the shapes take clicks) or all.", "mode", "off");
+    parser.addOption(clickThrough);
+    QCommandLineOption exportPath("export", "Render the configured session to <file> (.y4m video or .png sequence) and quit.", "file");
+    parser.addOption(exportPath);
+    QCommandLineOption exportSize("size", "Export frame size.", "WxH", "1280x720");
+    parser.addOption(exportSize);
+    QCommandLineOption exportFps("fps", "Export frame rate.", "fps", "30");
+    parser.addOption(exportFps);
+    QCommandLineOption exportDuration("duration", "Export length in seconds, one breathing cycle by default.", "seconds", "0");
+    parser.addOption(exportDuration);
+    QCommandLineOption cycleCache("cycle-cache", "Pre-render one breathing cycle within <MB> of memory and play it back instead of drawing every frame.", "MB");
+    parser.addOption(cycleCache);
+    QCommandLineOption morph("morph", "Morph each shape out of the previous one over the first <ms> of its phase.", "ms");
+    parser.addOption(morph);
+    QCommandLineOption glow("glow", "Soft glow around the active shape, blurred by <px> (up to 64).", "px");
+    parser.addOption(glow);
+    QCommandLineOption particles("particles", "Draw <count> particles flowing in while inhaling and out while exhaling (up to 100000).", "count");
+    parser.addOption(particles);
+    QCommandLineOption audio("audio", "Audio guidance: cues (a tone at every phase change), tone (pitch follows the breath) or both.", "mode");
+    parser.addOption(audio);
+    QCommandLineOption audioWav("audio-wav", "Play the audio into the WAV <file> instead of the sound device.", "file");
+    parser.addOption(audioWav);
+    QCommandLineOption breathInput("breath-input", "Score breathing against the pattern from <input>: mic, or a 16 bit PCM WAV file.", "input");
+    parser.addOption(breathInput);
+    QCommandLineOption sensor("sensor", "Show the breath from a respiration belt beside the shape: - (stdin), serial:<port>[@baud], sim[:<breaths/min>] or a file.", "input");
+    parser.addOption(sensor);
+    QCommandLineOption sensorAdapt("sensor-adapt", "Ease the mode timings toward the rhythm measured by --sensor.");
+    parser.addOption(sensorAdapt);
+    QCommandLineOption eventLog("event-log", "Record sessions, pauses, settings changes and adherence into the binary log in <dir>.", "dir");
+    parser.addOption(eventLog);
+    QCommandLineOption dumpEvents("dump-events", "Print the event log in <dir> as tab separated text and quit.", "dir");
+    parser.addOption(dumpEvents);
+    QCommandLineOption exportHistory("export-history", "Write the event log of --event-log to the Parquet <file> for pandas or DuckDB and quit.", "file");
+    parser.addOption(exportHistory);
+    QCommandLineOption benchmark("benchmark", "Run the benchmark <name> (or all), print the timings and quit.", "name");
+    parser.addOption(benchmark);
+    parser.process(a);
+
+    if (parser.isSet(dumpEvents))
+    {
+        QTextStream out(stdout);
+        bool ok = EventLog::dump(parser.value(dumpEvents), out);
+        if (!ok) qCWarning(lcMain) << "No event log in" << parser.value(dumpEvents);
+        Logging::shutdown();
+        return ok ? 0 : 1;
+    }
+    if (parser.isSet(benchmark))
+    {
+        QTextStream out(stdout);
+        int code = Benchmark::run(parser.value(benchmark), out);
+        Logging::shutdown();
+        return code;
+    }
+    if (parser.isSet(exportHistory))
+    {
+        bool ok = parser.isSet(eventLog) && HistoryExporter::run(parser.value(eventLog), parser.value(exportHistory));
+        if (!parser.isSet(eventLog)) qCWarning(lcMain) << "--export-history needs --event-log <dir>";
+        Logging::shutdown();
+        return ok ? 0 : 1;
+    }
+
+    ShapeRegistry::loadPlugins(QCoreApplication::applicationDirPath() + "/shapes");
+    ShapeRegistry::loadArtwork(QCoreApplication::applicationDirPath() + "/artwork");
+
+    MetricsServer metrics;
+    if (parser.isSet(metricsPort))
+    {
+        bool ok;
+        uint port = parser.value(metricsPort).toUInt(&ok);
+        if (!ok || port == 0 || port > 65535)
+        {
+            qCWarning(lcMetrics) << "Invalid --metrics-port" << parser.value(metricsPort) << "- expected 1 to 65535";
+            Logging::shutdown();
+            return 1;
+        }
+        metrics.start(quint16(port));
+    }
+
+    quint8 fps = 0;
+    if (parser.isSet(exportPath))
+    {
+        bool ok;
+        uint value = parser.value(exportFps).toUInt(&ok);
+        if (!ok || value == 0 || value > 240)
+        {
+            qCWarning(lcMain) << "Invalid --fps" << parser.value(exportFps) << "- expected 1 to 240";
+            Logging::shutdown();
+            return 1;
+        }
+        fps = quint8(value);
+    }
+    uint morphMS = 0, particleCount = 0, glowPX = 0, cacheMB = 0;
+    if (!uintOption(parser, morph, 60000, morphMS) || !uintOption(parser, particles, 100000, particleCount) ||
+        !uintOption(parser, glow, 64, glowPX) || !uintOption(parser, cycleCache, 65535, cacheMB))
+    {
+        Logging::shutdown();
+        return 1;
+    }
+
+    int ret;
+    {
+        MainWindow w(parser.value(backend) == "raster" ? MainWindow::RasterBackend : MainWindow::WidgetBackend);
+        if (parser.isSet(eventLog)) w.setEventLog(parser.value(eventLog));
+        if (parser.isSet(morph)) w.setMorphMS(morphMS);
+        if (parser.isSet(particles)) w.setParticles(int(particleCount));
+        if (parser.isSet(glow)) w.setGlow(quint8(glowPX));
+        if (parser.isSet(exportPath))
+        {
+            QStringList wh = parser.value(exportSize).split('x');
+            QSize size = wh.size() == 2 ? QSize(wh[0].toInt(), wh[1].toInt()) : QSize();
+            ret = w.exportSession(parser.value(exportPath), size, fps,
+                               qint64(parser.value(exportDuration).toDouble()*1000)) ? 0 : 1;
+        }
+        else
+        {
+            if (parser.isSet(perPixelAlpha)) w.setPerPixelAlpha(true);
+            if (parser.isSet(cycleCache)) w.setCycleCache(cacheMB);
+            if (parser.value(clickThrough) == "shape") w.setClickThrough(MainWindow::ShapeClickThrough);
+            else if (parser.value(clickThrough) == "all") w.setClickThrough(MainWindow::FullClickThrough);
+            if (parser.isSet(audio) || parser.isSet(audioWav))
+            {
+                QString mode = parser.isSet(audio) ? parser.value(audio) : "cues";
+                quint8 features = (mode == "tone") ? AudioEngine::Tone
+                                : (mode == "both") ? AudioEngine::Cues | AudioEngine::Tone : AudioEngine::Cues;
+                w.setAudio(features, parser.value(audioWav));
+            }
+            if (parser.isSet(breathInput)) w.setBreathInput(parser.value(breathInput));
+            if (parser.isSet(sensor)) w.setBreathSensor(parser.value(sensor), parser.isSet(sensorAdapt));
+            w.start();
+            ret = a.exec();
+        }
+    }
+    Logging::shutdown();
+    return ret;
 }
@@ -10,6 +10,29 @@
 #include <QString>
 #include "dialog.h"
 #include "defaults.h"
+#include "logging.h"
+#include "metrics.h"
+#include "sessionclock.h"
+#include "qualitygovernor.h"
+#include "reminderscheduler.h"
+#include "renderer.h"
+#include "overlaywindow.h"
+#include "rasteroverlay.h"
+#include "inputshape.h"
+#include "sessionexporter.h"
+#include "cyclecache.h"
+#include "audioengine.h"
+#include "wavsink.h"
+#include "deviceaudiosink.h"
+#include "breathdetector.h"
+#include "wavsource.h"
+#include "deviceaudiosource.h"
+#include "breathsensor.h"
+#include "pacingschedule.h"
+#include "eventlog.h"
+#include "sessionstats.h"
+#include <QSettings>
+#include <QDir>
 
 /*!
  * \brief The MainData struct
@@ -17,12 +40,14 @@
 struct MainData
 {
     Mode *currMode ; ///< Pointer to the active Mode
-    QTime *modeTimer; ///< Maintains the time elapsed in the current mode
+    SessionClock clock; ///< Session time from which the active mode and its progress are derived
     QTimer *timeKeeper; ///< Timer firing interrupt when the time set for the mode is elapsed
     QHash<quint8,Mode*> modeList; ///< Maintain the list of pointers to modes
     quint8 currModeEnum; ///< Keeps the mode number (enum) of the active mode
     quint8 shapeOpacity = 127; ///< Default shape opacity to start with
-    quint8 freq = 30; ///< Sets the shape update fps
+    quint8 freq = 30; ///< Sets the shape update fps at full quality
+    QualityGovernor *governor; ///< Lowers the fps and rendering quality when painting is too slow or on battery
+    ReminderScheduler *scheduler; ///< Shows the overlay only during scheduled guidance sessions, if configured
     bool showTitleBar = false; ///< To show the title bar : toggled by double click
     QPoint oldPos = QPoint(0,0); ///< Keeps the position for calculation
     QPoint ellipse_size = QPoint(300,300); ///< Stores the size of ellipse
@@ -30,28 +55,60 @@ struct MainData
     Mode *lastMode = NULL; ///< Stores the mode which was active before the current one
     quint8 currFocus = 0; ///< Stores which mode is in focus currently
     Dialog *dialog; ///< Pointer to the dialog class
+    QElapsedTimer frameClock; ///< Time since the last painted frame, used to count dropped frames
+    int frameTimerId = 0; ///< Id of the repaint timer, 0 while the animation is suspended
+    Renderer *renderer; ///< Draws frames for this window and every overlay
+    FrameState frame; ///< What is shown at the current tick, computed once and shared by all windows
+    QList<OverlayWindow*> overlays; ///< Additional overlays driven by the same tick
+    RasterOverlay *raster = nullptr; ///< Primary overlay when the raster backend is used, this window then stays hidden
+    bool perPixelAlpha = false; ///< Fold the window transparency into the shape colors instead of using setWindowOpacity
+    quint8 clickThrough = MainWindow::NoClickThrough; ///< Which part of the overlays lets clicks through
+    InputShape inputShape; ///< Cached input region of this window while only the shapes take input
+    CycleCache *cycleCache = nullptr; ///< Pre-rendered cycle of the primary overlay, if enabled
+    QTimer *cacheDebounce = nullptr; ///< Collects bursts of settings and size changes into one cycle rebuild
+    bool seen = false; ///< Whether the window could be seen at the last visibility check
+    AudioEngine *audio = nullptr; ///< Audio cues and tone, if enabled
+    BreathDetector *breath = nullptr; ///< Scores the user's breathing against the active mode, if enabled
+    BreathSensor *sensor = nullptr; ///< Respiration belt input, if enabled
+    bool adaptTempo = false; ///< Follow the measured breath rhythm with the mode timings
+    float tempo = 1; ///< Factor on the configured mode timings while adapting to the measured rhythm
+    EventLog *events = nullptr; ///< Audit trail of the sessions, if enabled
+    SessionStats *stats = nullptr; ///< Statistics kept up to date from the recorded events
+    QElapsedTimer pausedSince; ///< Time since the animation was suspended, for the event log
+    float adherence = -1; ///< Latest adherence score, logged once the phase ends; negative when there is none
+    bool inSession = false; ///< A session was logged as started and not yet as ended
 };
 
 /*!
  * \brief MainWindow::MainWindow Constructor
+ *  With the raster backend this object only acts as the controller: the widget UI is never set up
+ *  and the widget is never shown, so no native window or widget backing store is ever created.
+ * \param backend Backend the primary overlay is drawn with, fixed for the lifetime of the window
  * \param parent
  */
-MainWindow::MainWindow(QWidget *parent)
+MainWindow::MainWindow(quint8 backend, QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
     // Setting up UI
     dptr=new MainData;
-    qDebug() << Q_FUNC_INFO << "1";
-    ui->setupUi(this);
-    startTimer((int)(SEC_TO_MSEC/dptr->freq));
+    qCDebug(lcMain) << Q_FUNC_INFO << "1";
+    if (backend == Backend::WidgetBackend) ui->setupUi(this);
     dptr->dialog = new Dialog(this);
-    this->setWindowFlags(Qt::CustomizeWindowHint | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::BypassWindowManagerHint);
-    this->setAttribute(Qt::WA_TranslucentBackground);
-    this->setWindowTitle("Breathe");
+    dptr->governor = new QualityGovernor(dptr->freq, this);
+    connect(dptr->governor,SIGNAL(levelChanged(quint8)),this,SLOT(onQualityChanged()) );
+    dptr->scheduler = new ReminderScheduler(this);
+    connect(dptr->scheduler,SIGNAL(sessionStarted()),this,SLOT(onSessionStarted()) );
+    connect(dptr->scheduler,SIGNAL(sessionEnded()),this,SLOT(onSessionEnded()) );
+    if (backend == Backend::WidgetBackend)
+    {
+        this->setWindowFlags(Qt::CustomizeWindowHint | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::BypassWindowManagerHint);
+        this->setAttribute(Qt::WA_TranslucentBackground);
+        this->setWindowTitle("Breathe");
+        this->setAttribute(Qt::WA_NoSystemBackground);
+    }
     this->setWindowOpacity(0.7);
-    this->setAttribute(Qt::WA_NoSystemBackground);
-    qDebug() << Q_FUNC_INFO << "2";
+    qCDebug(lcMain) << Q_FUNC_INFO << "2";
 
     // Initiating and adding modes to the Mode list
     dptr->modeList[Modes::Inhale]  = new Mode(Modes::Inhale, dptr->shapeOpacity);
@@ -69,31 +126,39 @@ MainWindow::MainWindow(QWidget *parent)
     dptr->modeList[Modes::Exhale]->setChangable(Changable::Decreasing);
     dptr->modeList[Modes::HoldOut]->setChangable(Changable::Decreasing);
 
-    // update settings based on stored settings
-    updateSettings();
-    qDebug() << Q_FUNC_INFO << "3";
-
     // Start with the first mode -> Inhale in this case
     dptr->currModeEnum = Modes::Inhale;
     dptr->currMode = dptr->modeList[dptr->currModeEnum];
-    dptr->timeKeeper = new QTimer;
-    dptr->modeTimer = new QTime;
+    dptr->clock.setFirstMode(dptr->currMode);
+    dptr->renderer = new Renderer(&dptr->clock);
+    onQualityChanged();
+    dptr->timeKeeper = new QTimer(this);
     dptr->timeKeeper->setSingleShot(true);
-//    QTimer::singleShot(currMode->getTimeMS(),this,SLOT(onModeTimeout()));
-    dptr->timeKeeper->singleShot(dptr->currMode->getTimeMS(),this,SLOT(onModeTimeout()));
-    dptr->modeTimer->start();
+    dptr->timeKeeper->setTimerType(Qt::PreciseTimer);
+    connect(dptr->timeKeeper,SIGNAL(timeout()),this,SLOT(onModeTimeout()));
+
+    // update settings based on stored settings
+    updateSettings();
+    qCDebug(lcMain) << Q_FUNC_INFO << "3";
+    dptr->clock.start();
+    dptr->frame = dptr->renderer->frame(0);
 
     // Update Window settings
     this->resize(300,300);
     QSize sz = this->window()->size();
     dptr->windowSize = QPoint(sz.width(),sz.height());
-    Mode::setScreenSize(dptr->windowSize);
+    createOverlays();
+    setBackend(backend);
 
     // Set SIGNAL-SLOT mapping
     connect(dptr->dialog,SIGNAL(settingsClosed()),this,SLOT(showWindow()) );
+    connect(dptr->dialog,SIGNAL(settingsClosed()),this,SLOT(onSettingsClosed()) );
     connect(dptr->dialog,SIGNAL(settingsChanged()),this,SLOT(updateSettings()) );
+    connect(qApp,SIGNAL(applicationStateChanged(Qt::ApplicationState)),this,SLOT(updateVisibility()) );
+    connect(qApp,SIGNAL(screenAdded(QScreen*)),this,SLOT(updateVisibility()) );
+    connect(qApp,SIGNAL(screenRemoved(QScreen*)),this,SLOT(updateVisibility()) );
 
-    qInfo() << Q_FUNC_INFO << dptr->windowSize;
+    qCInfo(lcMain) << Q_FUNC_INFO << dptr->windowSize;
 }
 
 
@@ -104,99 +169,238 @@ MainWindow::MainWindow(QWidget *parent)
 void MainWindow::onModeTimeout()
 {
 //    qDebug() << Q_FUNC_INFO << "Curr Mode=" << dptr->currMode->getMode() << dptr->currMode->getTimeMS();
-    dptr->lastMode = dptr->currMode;
-    dptr->currMode = dptr->currMode->getNext();
-//    QTimer::singleShot(currMode->getTimeMS(),this,SLOT(onModeTimeout()));
-    dptr->timeKeeper->singleShot(dptr->currMode->getTimeMS(),this,SLOT(onModeTimeout()));
-    dptr->modeTimer->start();
+    Mode *previous = dptr->currMode;
+    quint32 elapsed = syncPhase();
+    // Positive when the phase change is noticed late, negative when the timer fired early
+    if (dptr->currMode != previous) Metrics::phaseDrift(elapsed);
+    else Metrics::phaseDrift((qint32)elapsed - (qint32)dptr->currMode->getTimeMS());
 //    qDebug() << Q_FUNC_INFO << "New  Mode=" << dptr->currMode->getMode() << dptr->currMode->getTimeMS();
 }
 
 /*!
- * \brief MainWindow::sizeHint
+ * \brief MainWindow::syncPhase Take the active mode from the session clock and arm timeKeeper for its end
+ * \return Time already spent in the active mode
+ */
+quint32 MainWindow::syncPhase()
+{
+    quint32 elapsed, remaining;
+    Mode *before = dptr->currMode;
+    dptr->currMode = dptr->clock.current(elapsed, &dptr->lastMode, &remaining);
+    if (dptr->currMode != before)
+    {
+        // One adherence event per phase: the last score the detector gave for the phase just left
+        if (before && dptr->adherence >= 0)
+            recordEvent(EventLog::Adherence, before->getMode(), dptr->adherence);
+        dptr->adherence = -1;
+        recordEvent(EventLog::Phase, dptr->currMode->getMode(), 0, elapsed + remaining);
+    }
+    dptr->currModeEnum = dptr->currMode->getMode();
+    if (dptr->breath) dptr->breath->setExpected(dptr->seen ? dptr->currModeEnum : BreathDetector::NO_MODE);
+    if (dptr->clock.cycleMS() > 0)
+        dptr->timeKeeper->start(remaining);
+    else
+        dptr->timeKeeper->stop();
+    return elapsed;
+}
+
+/*!
+ * \brief MainWindow::isSeen Whether any part of this window or of an overlay can currently be seen by the user
  * \return
  */
-QSize MainWindow::sizeHint() const
+bool MainWindow::isSeen() const
 {
-    return QSize(dptr->windowSize.x(), dptr->windowSize.y()) ;// Set this to the exact image resolution
+    if (OverlayWindow::isWindowSeen(this)) return true;
+    if (dptr->raster && dptr->raster->isSeen()) return true;
+    for (OverlayWindow *overlay : dptr->overlays)
+        if (OverlayWindow::isWindowSeen(overlay)) return true;
+    return false;
 }
 
+/*!
+ * \brief MainWindow::updateVisibility Suspend all animation timers while the window cannot be seen
+ *  On the way back the phase is taken straight from the session clock, nothing is replayed.
+ */
+void MainWindow::updateVisibility()
+{
+    bool seen = isSeen();
+    if (seen == dptr->seen) return;
+    dptr->frame = dptr->renderer->frame(dptr->clock.elapsedMS());
+    dptr->seen = seen;
+    qCInfo(lcMain) << Q_FUNC_INFO << (seen ? "resuming" : "suspending") << "animation";
+    if (seen) recordEvent(EventLog::Resumed, 0, 0, dptr->pausedSince.isValid() ? quint32(dptr->pausedSince.elapsed()) : 0);
+    else recordEvent(EventLog::Paused);
+    if (seen)
+    {
+        syncPhase();
+        dptr->frameClock.invalidate();
+        if (!dptr->frameTimerId) dptr->frameTimerId = startTimer(SEC_TO_MSEC/dptr->governor->fps());
+        update();
+        if (dptr->raster) dptr->raster->update();
+        for (OverlayWindow *overlay : dptr->overlays) overlay->update();
+    }
+    else
+    {
+        if (dptr->frameTimerId) killTimer(dptr->frameTimerId);
+        dptr->frameTimerId = 0;
+        dptr->timeKeeper->stop();
+        if (dptr->breath) dptr->breath->setExpected(BreathDetector::NO_MODE);
+        dptr->pausedSince.start();
+    }
+    dptr->governor->setActive(seen);
+}
 
 /*!
- * \brief MainWindow::drawShape Draw shapes based on given input and shape set in current mode
- * \param qp
- * \param xywh
- * \param shape
+ * \brief MainWindow::onQualityChanged Apply a new quality level: restart the repaint timer at the new fps
  */
-void MainWindow::drawShape(QPainter &qp, QRect xywh, quint8 shape)
+void MainWindow::onQualityChanged()
 {
-//    qInfo() << Q_FUNC_INFO << xywh << shape;
-    switch (shape)
+    dptr->renderer->setQuality(dptr->governor->antialiasing(), dptr->governor->simpleOutlines(), dptr->governor->effects());
+    if (dptr->cacheDebounce) dptr->cacheDebounce->start();
+    if (dptr->frameTimerId)
     {
-        case Shape::Ellipse:
-        {
-            qp.drawEllipse(xywh);
-            break;
-        }
-        case Shape::Rectangle:
-        {
-            qp.drawRect(xywh);
-            break;
-        }
-        case Shape::RoundedRectangle:
-        {
-            qp.drawRoundRect(xywh);
-            break;
-        }
+        killTimer(dptr->frameTimerId);
+        dptr->frameClock.invalidate();
+        dptr->frameTimerId = startTimer(SEC_TO_MSEC/dptr->governor->fps());
     }
+    update();
 }
 
+/*!
+ * \brief MainWindow::createOverlays Create the additional overlays configured in the "Overlays" settings group
+ *  perScreen puts one on every screen but the primary one, extra adds user placed overlays
+ *  whose geometry is remembered in geometry0, geometry1, ...
+ */
+void MainWindow::createOverlays()
+{
+    QSettings settings(QString(qApp->applicationName()));
+    settings.setPath(QSettings::IniFormat,QSettings::UserScope,QDir::currentPath());
+    settings.beginGroup("Overlays");
+    QList<QRect> places;
+    if (settings.value("perScreen", false).toBool())
+        for (QScreen *screen : QGuiApplication::screens())
+            if (screen != QGuiApplication::primaryScreen())
+                places.append(QRect(screen->availableGeometry().topLeft(), this->size()));
+    int extra = settings.value("extra", 0).toInt();
+    for (int i = 0; i < extra; i++)
+        places.append(settings.value(QString("geometry%1").arg(i), QRect(QPoint(50*(i+1), 50*(i+1)), this->size())).toRect());
+    settings.endGroup();
+
+    for (const QRect &place : places)
+    {
+        OverlayWindow *overlay = new OverlayWindow(dptr->renderer, &dptr->frame, this);
+        overlay->setGeometry(place);
+        overlay->setWindowOpacity(this->windowOpacity());
+        connect(overlay,SIGNAL(visibilityChanged()),this,SLOT(updateVisibility()) );
+        dptr->overlays.append(overlay);
+    }
+    qCInfo(lcMain) << Q_FUNC_INFO << dptr->overlays.size() << "additional overlays";
+}
 
 /*!
- * \brief MainWindow::isModeInFocus Get the combo mode in focus since we are sharing shapes for two modes - ex. Inhale or Exhale mode will return Focus::InhaleExhale
- * \param mode
- * \param focus
+ * \brief MainWindow::saveOverlays Remember where the user placed the extra overlays
+ */
+void MainWindow::saveOverlays()
+{
+    QSettings settings(QString(qApp->applicationName()));
+    settings.setPath(QSettings::IniFormat,QSettings::UserScope,QDir::currentPath());
+    settings.beginGroup("Overlays");
+    int extra = settings.value("extra", 0).toInt();
+    int first = dptr->overlays.size() - extra;
+    for (int i = 0; i < extra && first + i >= 0; i++)
+        settings.setValue(QString("geometry%1").arg(i), dptr->overlays.at(first + i)->geometry());
+    settings.endGroup();
+}
+
+/*!
+ * \brief MainWindow::setOverlaysVisible Show or hide the additional overlays together with this window
+ * \param visible
+ */
+void MainWindow::setOverlaysVisible(bool visible)
+{
+    for (OverlayWindow *overlay : dptr->overlays)
+        overlay->setVisible(visible);
+}
+
+/*!
+ * \brief MainWindow::eventFilter Watch the native window for exposure changes
+ * \param watched
+ * \param event
  * \return
  */
-bool MainWindow::isModeInFocus(quint8 mode, quint8 focus)
+bool MainWindow::eventFilter(QObject *watched, QEvent *event)
 {
-    if ( ((mode == Modes::Inhale || mode == Modes::Exhale ) && focus == Focus::InhaleExhale)
-      || ((mode == Modes::HoldOut || mode == Modes::HoldIn) && focus == Focus::HoldInOut) )
-        return true;
-    return false;
+    if (watched == windowHandle() && event->type() == QEvent::Expose)
+        QMetaObject::invokeMethod(this, "updateVisibility", Qt::QueuedConnection);
+    return inherited::eventFilter(watched, event);
+}
+
+/*!
+ * \brief MainWindow::showEvent Called when the window is shown; the native window may be new after a flags change
+ * \param event
+ */
+void MainWindow::showEvent(QShowEvent *event)
+{
+    inherited::showEvent(event);
+    windowHandle()->installEventFilter(this);
+    updateVisibility();
+}
+
+/*!
+ * \brief MainWindow::hideEvent Called when the window is hidden
+ * \param event
+ */
+void MainWindow::hideEvent(QHideEvent *event)
+{
+    inherited::hideEvent(event);
+    updateVisibility();
+}
+
+/*!
+ * \brief MainWindow::changeEvent Catches minimizing and restoring
+ * \param event
+ */
+void MainWindow::changeEvent(QEvent *event)
+{
+    inherited::changeEvent(event);
+    if (event->type() == QEvent::WindowStateChange)
+        updateVisibility();
+}
+
+/*!
+ * \brief MainWindow::moveEvent Moving the window off all screens suspends the animation as well
+ * \param event
+ */
+void MainWindow::moveEvent(QMoveEvent *event)
+{
+    inherited::moveEvent(event);
+    updateVisibility();
 }
 
+/*!
+ * \brief MainWindow::sizeHint
+ * \return
+ */
+QSize MainWindow::sizeHint() const
+{
+    return QSize(dptr->windowSize.x(), dptr->windowSize.y()) ;// Set this to the exact image resolution
+}
+
+
 /*!
  * \brief MainWindow::paintEvent Called when repaint or update is called
  */
 void MainWindow::paintEvent(QPaintEvent *)
 {
+    QElapsedTimer paintTime;
+    paintTime.start();
     QPainter qp ;
     qp.begin(this);
-    qp.setRenderHint(QPainter::Antialiasing);
     qp.setPen(Qt::NoPen);
-    int elapsedTime = dptr->modeTimer->elapsed();
-    //= timeKeeper->interval()-timeKeeper->remainingTime();
-//    qDebug() << Q_FUNC_INFO << "Time" << elapsedTime << dptr->currMode->getColor() << dptr->currMode->getShapeCoord(elapsedTime);
-    QPen pen(Qt::NoPen);
-
-    if (!(!dptr->lastMode))
-    {
-        if (isModeInFocus(dptr->lastMode->getMode(), dptr->currFocus))
-                pen = QPen(Qt::gray, 3, Qt::DashDotLine);
-        qp.setPen(pen);
-        qp.setBrush(dptr->lastMode->getColor());
-        drawShape(qp, dptr->lastMode->getEndShapeCoord(), dptr->lastMode->getShape());
-    }
-
-    // If we are editing any mode using numpad or Ctrl+Scroll, this will draw an outline around it to show that this shape is being edited
-    if (isModeInFocus(dptr->currMode->getMode(), dptr->currFocus))
-        pen = QPen(Qt::gray, 3, Qt::DashDotLine);
-    else pen = QPen(Qt::NoPen);
-    qp.setPen(pen);
-    qp.setBrush(dptr->currMode->getColor());
-    drawShape(qp, dptr->currMode->getShapeCoord(elapsedTime), dptr->currMode->getShape());
+    dptr->renderer->paint(qp, dptr->windowSize, dptr->frame);
     qp.end();
+    qint64 paintNS = paintTime.nsecsElapsed();
+    Metrics::frameRendered(paintNS);
+    dptr->governor->recordPaint(paintNS);
 }
 
 /*!
@@ -220,9 +424,10 @@ void MainWindow::mousePressEvent(QMouseEvent *event)
     dptr->oldPos = event->globalPos();
     try
     {
-        qInfo() << event->button() << Qt::RightButton << Qt::LeftButton << event->type() << QEvent::MouseButtonRelease << QEvent::MouseButtonPress;
+        qCDebug(lcInput) << event->button() << Qt::RightButton << Qt::LeftButton << event->type() << QEvent::MouseButtonRelease << QEvent::MouseButtonPress;
         if (event->button() == Qt::RightButton && dptr->showTitleBar && event->type() ==  QEvent::MouseButtonPress)
         {
+            if (dptr->stats) dptr->dialog->setStats(dptr->stats->summary());
             dptr->dialog->show();
 //            this->hide();
             return;
@@ -247,7 +452,7 @@ void MainWindow::mousePressEvent(QMouseEvent *event)
     }
     catch (QException exc)
     {
-        qInfo() << "Exc:" ;
+        qCWarning(lcInput) << "Exc:" ;
     }
 }
 
@@ -290,13 +495,336 @@ void MainWindow::setFocusedModesScaling(qint8 scrollX, qint8 scrollY)
     }
 }
 
+/*!
+ * \brief MainWindow::start Show the overlay, or leave it to the reminder schedule when one is configured
+ */
+void MainWindow::start()
+{
+    if (dptr->scheduler->isEnabled()) dptr->scheduler->start();
+    else
+    {
+        // Without a schedule the whole run is one session, ended when the window goes
+        recordEvent(EventLog::SessionStarted);
+        dptr->inSession = true;
+        setPrimaryVisible(true);
+        setOverlaysVisible(true);
+    }
+}
+
+/*!
+ * \brief MainWindow::onSessionStarted Scheduled guidance begins: start from the first mode and show up
+ */
+void MainWindow::onSessionStarted()
+{
+    qCInfo(lcMain) << Q_FUNC_INFO;
+    recordEvent(EventLog::SessionStarted);
+    dptr->inSession = true;
+    dptr->clock.start();
+    if (dptr->audio) dptr->audio->start(dptr->modeList[Modes::Inhale], dptr->modeList[Modes::Inhale], 0, &dptr->clock);
+    setPrimaryVisible(true);
+    setOverlaysVisible(true);
+}
+
+/*!
+ * \brief MainWindow::onSessionEnded Scheduled guidance is over: hiding suspends all timers until the next one
+ */
+void MainWindow::onSessionEnded()
+{
+    qCInfo(lcMain) << Q_FUNC_INFO;
+    recordEvent(EventLog::SessionEnded);
+    dptr->inSession = false;
+    dptr->dialog->hide();
+    if (dptr->audio) dptr->audio->stop();
+    setPrimaryVisible(false);
+    setOverlaysVisible(false);
+}
+
+/*!
+ * \brief MainWindow::setBackend Create the raster overlay if it is the primary one, called once by the constructor
+ * \param backend
+ */
+void MainWindow::setBackend(quint8 backend)
+{
+    if (backend == Backend::RasterBackend)
+    {
+        dptr->raster = new RasterOverlay(dptr->renderer, &dptr->frame, this);
+        dptr->raster->resize(dptr->windowSize.x(), dptr->windowSize.y());
+        dptr->raster->setOpacity(this->windowOpacity());
+        connect(dptr->raster,SIGNAL(visibilityChanged()),this,SLOT(updateVisibility()) );
+        connect(dptr->raster,SIGNAL(settingsRequested()),dptr->dialog,SLOT(show()) );
+    }
+    qCInfo(lcMain) << Q_FUNC_INFO << QMetaEnum::fromType<Backend>().valueToKey(backend);
+}
+
+/*!
+ * \brief MainWindow::setPerPixelAlpha Keep the window surface fully transparent and fade only the shapes
+ *  Saves the compositor a blend of the entire window every frame.
+ * \param perPixel
+ */
+void MainWindow::setPerPixelAlpha(bool perPixel)
+{
+    dptr->perPixelAlpha = perPixel;
+    updateSettings();
+}
+
+/*!
+ * \brief MainWindow::exportSession Render the configured session to a video file instead of showing it
+ * \param path .y4m file or .png sequence
+ * \param size
+ * \param fps
+ * \param durationMS 0 for one breathing cycle
+ * \return
+ */
+bool MainWindow::exportSession(const QString &path, const QSize &size, quint8 fps, qint64 durationMS)
+{
+    SessionExporter exporter(dptr->modeList[Modes::Inhale], dptr->renderer);
+    exporter.setSchedule(dptr->clock.schedule());
+    return exporter.run(path, size, fps, durationMS);
+}
+
+/*!
+ * \brief MainWindow::setCycleCache Pre-render one breathing cycle after every settings change and play it back
+ * \param budgetMB Memory the encoded cycle may take, 0 turns the cache off
+ */
+void MainWindow::setCycleCache(quint32 budgetMB)
+{
+    dptr->renderer->setCycleCache(nullptr);
+    delete dptr->cycleCache;
+    dptr->cycleCache = nullptr;
+    if (budgetMB)
+    {
+        dptr->cycleCache = new CycleCache(quint64(budgetMB) << 20, this);
+        dptr->renderer->setCycleCache(dptr->cycleCache);
+        if (!dptr->cacheDebounce)
+        {
+            dptr->cacheDebounce = new QTimer(this);
+            dptr->cacheDebounce->setSingleShot(true);
+            dptr->cacheDebounce->setInterval(250);
+            connect(dptr->cacheDebounce,SIGNAL(timeout()),this,SLOT(rebuildCycleCache()));
+        }
+        dptr->cacheDebounce->start();
+    }
+    qCInfo(lcMain) << Q_FUNC_INFO << budgetMB;
+}
+
+/*!
+ * \brief MainWindow::setMorphMS Let every shape morph out of the previous one at the start of its phase
+ * \param morphMS 0 switches shapes at once
+ */
+void MainWindow::setMorphMS(quint32 morphMS)
+{
+    dptr->renderer->setMorphMS(morphMS);
+    if (dptr->cacheDebounce) dptr->cacheDebounce->start();
+}
+
+/*!
+ * \brief MainWindow::setGlow Soft glow around the active shape, dropped by the quality governor under load
+ * \param radius Blur radius in pixels, 0 for no glow
+ */
+void MainWindow::setGlow(quint8 radius)
+{
+    dptr->renderer->setGlow(radius);
+    if (dptr->cacheDebounce) dptr->cacheDebounce->start();
+}
+
+/*!
+ * \brief MainWindow::setParticles Particles flowing into the shape while inhaling and out of it while exhaling
+ * \param count 0 for none
+ */
+void MainWindow::setParticles(int count)
+{
+    dptr->renderer->setParticles(count);
+    if (dptr->cacheDebounce) dptr->cacheDebounce->start();
+}
+
+/*!
+ * \brief MainWindow::setAudio Play cues and a breath tone, on the sound device or into a WAV file
+ *  With a reminder schedule the audio only plays during its sessions.
+ * \param features AudioEngine::Feature flags, 0 for silence
+ * \param wavPath Write the audio to this file instead of the sound device, empty for the device
+ * \return False when the audio could not be started
+ */
+bool MainWindow::setAudio(quint8 features, const QString &wavPath)
+{
+    delete dptr->audio;
+    dptr->audio = nullptr;
+    if (!features) return true;
+    AudioSink *sink = wavPath.isEmpty() ? static_cast<AudioSink*>(new DeviceAudioSink) : new WavSink(wavPath);
+    dptr->audio = new AudioEngine(features, sink);
+    if (dptr->scheduler->isEnabled()) return true;
+    quint32 elapsed;
+    Mode *active = dptr->clock.current(elapsed);
+    return dptr->audio->start(dptr->modeList[Modes::Inhale], active, elapsed, &dptr->clock);
+}
+
+/*!
+ * \brief MainWindow::setBreathInput Listen to the user's breathing and score how well it follows the pattern
+ * \param input "mic" for the default microphone, otherwise a 16 bit PCM WAV file played in its place
+ * \return False when the input could not be opened
+ */
+bool MainWindow::setBreathInput(const QString &input)
+{
+    delete dptr->breath;
+    dptr->breath = nullptr;
+    if (input.isEmpty()) return true;
+    AudioSource *source = (input == "mic") ? static_cast<AudioSource*>(new DeviceAudioSource) : new WavSource(input);
+    dptr->breath = new BreathDetector(source);
+    connect(dptr->breath,SIGNAL(adherenceChanged(float)),this,SLOT(onAdherenceChanged(float)));
+    dptr->breath->setExpected(dptr->seen ? dptr->currModeEnum : BreathDetector::NO_MODE);
+    return dptr->breath->begin();
+}
+
+/*!
+ * \brief MainWindow::setBreathSensor Show the breath measured by a respiration belt beside the target shape
+ * \param spec Sensor input, see BreathSensor; empty for none
+ * \param adapt Also move the mode timings toward the measured rhythm
+ */
+void MainWindow::setBreathSensor(const QString &spec, bool adapt)
+{
+    dptr->renderer->setBreathSensor(nullptr);
+    delete dptr->sensor;
+    dptr->sensor = nullptr;
+    dptr->adaptTempo = adapt;
+    if (spec.isEmpty()) return;
+    dptr->sensor = new BreathSensor(spec);
+    connect(dptr->sensor,SIGNAL(breathMeasured(float,float)),this,SLOT(onBreathMeasured(float,float)));
+    dptr->renderer->setBreathSensor(dptr->sensor);
+}
+
+/*!
+ * \brief MainWindow::onBreathMeasured A full breath was measured: ease the cycle length toward it when adapting
+ *  The phases keep their configured proportions, only the tempo follows, within half to twice the configured length.
+ * \param periodMS
+ * \param inhaleShare
+ */
+void MainWindow::onBreathMeasured(float periodMS, float inhaleShare)
+{
+    qCDebug(lcBreath) << Q_FUNC_INFO << periodMS << inhaleShare;
+    if (!dptr->adaptTempo) return;
+    float configured = dptr->dialog->getTimeMS(Modes::Inhale) + dptr->dialog->getTimeMS(Modes::HoldIn)
+                     + dptr->dialog->getTimeMS(Modes::Exhale) + dptr->dialog->getTimeMS(Modes::HoldOut);
+    if (configured <= 0) return;
+    float target = qBound(0.5f, periodMS / configured, 2.0f);
+    dptr->tempo += 0.25f * (target - dptr->tempo);
+    updateTempo();
+}
+
+/*!
+ * \brief MainWindow::setEventLog Record phases, pauses, settings changes and adherence into a binary log
+ * \param dir Log directory, an existing log there is continued
+ * \return False when the log cannot be opened
+ */
+bool MainWindow::setEventLog(const QString &dir)
+{
+    delete dptr->stats;
+    dptr->stats = nullptr;
+    delete dptr->events;
+    dptr->events = new EventLog;
+    if (!dptr->events->open(dir))
+    {
+        delete dptr->events;
+        dptr->events = nullptr;
+        return false;
+    }
+    dptr->stats = new SessionStats;
+    dptr->stats->open(dir);
+    return true;
+}
+
+/*!
+ * \brief MainWindow::recordEvent Append an event to the log and fold it into the statistics
+ * \param type EventLog::Type
+ * \param mode
+ * \param value
+ * \param arg
+ */
+void MainWindow::recordEvent(quint16 type, quint8 mode, float value, quint32 arg)
+{
+    EventRecord record;
+    if (dptr->events && dptr->events->append(type, mode, value, arg, &record) && dptr->stats)
+        dptr->stats->add(record);
+}
+
+/*!
+ * \brief MainWindow::onSettingsClosed Log the settings the user saved or went back to
+ *  The dialog applies every edit live; only the outcome is worth an event.
+ */
+void MainWindow::onSettingsClosed()
+{
+    recordEvent(EventLog::SettingsChanged, 0, 0, dptr->clock.cycleMS());
+}
+
+/*!
+ * \brief MainWindow::onAdherenceChanged Show the breath adherence score in the title bar and keep it for the phase event
+ * \param score
+ */
+void MainWindow::onAdherenceChanged(float score)
+{
+    QString title = QString("Breathe - %1% in step").arg(qRound(score * 100));
+    this->setWindowTitle(title);
+    if (dptr->raster) dptr->raster->setTitle(title);
+    dptr->adherence = score;
+    qCDebug(lcBreath) << Q_FUNC_INFO << score;
+}
+
+/*!
+ * \brief MainWindow::rebuildCycleCache Render the cycle again for the current settings and primary window size
+ */
+void MainWindow::rebuildCycleCache()
+{
+    if (!dptr->cycleCache) return;
+    QPoint size = dptr->raster ? QPoint(dptr->raster->width(), dptr->raster->height()) : dptr->windowSize;
+    dptr->cycleCache->rebuild(dptr->modeList[Modes::Inhale], size, dptr->freq, *dptr->renderer);
+}
+
+/*!
+ * \brief MainWindow::setClickThrough Let clicks reach the windows below every overlay, except on the shapes if asked
+ * \param clickThrough
+ */
+void MainWindow::setClickThrough(quint8 clickThrough)
+{
+    dptr->clickThrough = clickThrough;
+    if (!dptr->raster) OverlayWindow::applyClickThrough(this, clickThrough);
+    dptr->inputShape.invalidate();
+    for (OverlayWindow *overlay : dptr->overlays)
+        overlay->setClickThrough(clickThrough);
+    if (dptr->raster) dptr->raster->setClickThrough(clickThrough);
+    updateInputShapes();
+    qCInfo(lcMain) << Q_FUNC_INFO << QMetaEnum::fromType<ClickThrough>().valueToKey(clickThrough);
+}
+
+/*!
+ * \brief MainWindow::updateInputShapes Keep the input masks on the shapes, the windows only set a new mask when it changed
+ */
+void MainWindow::updateInputShapes()
+{
+    if (dptr->clickThrough != ClickThrough::ShapeClickThrough) return;
+    if (!dptr->raster && dptr->inputShape.update(dptr->windowSize, dptr->frame,
+                                                 dptr->renderer->effectsRect(dptr->windowSize, dptr->frame)))
+        this->setMask(dptr->inputShape.region());
+    if (dptr->raster) dptr->raster->updateInputShape();
+    for (OverlayWindow *overlay : dptr->overlays)
+        overlay->updateInputShape();
+}
+
+/*!
+ * \brief MainWindow::setPrimaryVisible Show or hide the primary overlay of the selected backend
+ * \param visible
+ */
+void MainWindow::setPrimaryVisible(bool visible)
+{
+    if (dptr->raster) dptr->raster->setVisible(visible);
+    else this->setVisible(visible);
+}
+
 /*!
  * \brief MainWindow::showWindow
  */
 void MainWindow::showWindow()
 {
-    qInfo() << Q_FUNC_INFO;
-    this->show();
+    qCInfo(lcMain) << Q_FUNC_INFO;
+    if (dptr->scheduler->isEnabled() && !dptr->scheduler->inSession()) return;
+    setPrimaryVisible(true);
 }
 
 /*!
@@ -309,7 +837,7 @@ void MainWindow::resizeEvent(QResizeEvent *event)
     inherited::resizeEvent(event);
     QSize sz = this->window()->size();
     dptr->windowSize = QPoint(sz.width(),sz.height());
-    Mode::setScreenSize(dptr->windowSize);
+    if (dptr->cacheDebounce) dptr->cacheDebounce->start();
 }
 
 /*!
@@ -321,8 +849,9 @@ void MainWindow::getNextFocus()
 
 //    dptr->currFocus %= Focus::CountKeeper;
     dptr->currFocus %= enumFocus.keyCount();
+    dptr->renderer->setFocus(dptr->currFocus);
 
-    qInfo() << Q_FUNC_INFO << dptr->currFocus;
+    qCInfo(lcInput) << Q_FUNC_INFO << dptr->currFocus;
     if (dptr->currFocus == Focus::NoFocus)
     {
         quint8 changed = 1;
@@ -360,14 +889,14 @@ void MainWindow::setFocusedModesPosition(quint8 position)
     {
         dptr->modeList[Modes::Inhale]->setPosition(position);
         dptr->modeList[Modes::Exhale]->setPosition(position);
-        qInfo() << Q_FUNC_INFO << "InhExh" << position;
+        qCInfo(lcInput) << Q_FUNC_INFO << "InhExh" << position;
 
     }
     else if (dptr->currFocus == Focus::HoldInOut)
     {
         dptr->modeList[Modes::HoldIn]->setPosition(position);
         dptr->modeList[Modes::HoldOut]->setPosition(position);
-        qInfo() << Q_FUNC_INFO << "HoldInOut" << position;
+        qCInfo(lcInput) << Q_FUNC_INFO << "HoldInOut" << position;
     }
 }
 
@@ -398,16 +927,94 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
  */
 void MainWindow::timerEvent(QTimerEvent *event)
 {
+    // Ticks that came too late to be painted on time count as dropped frames
+    qint64 intervalMS = SEC_TO_MSEC/dptr->governor->fps();
+    if (dptr->frameClock.isValid())
+    {
+        qint64 missed = dptr->frameClock.elapsed()/intervalMS - 1;
+        if (missed > 0) Metrics::framesDropped(missed);
+    }
+    dptr->frameClock.start();
+
+    // One frame state per tick, every window only draws it at its own size
+    dptr->frame = dptr->renderer->frame(dptr->clock.elapsedMS());
+    updateInputShapes();
+
     // refresh window
-    this->repaint();
+    if (this->isVisible()) this->repaint();
+    if (dptr->raster && dptr->raster->isVisible()) dptr->raster->update();
+    for (OverlayWindow *overlay : dptr->overlays)
+        if (overlay->isVisible()) overlay->repaint();
+}
+
+
+/*!
+ * \brief MainWindow::updateSchedule Precompute the phase table of the ramp set in the Dialog, or drop it
+ *  The mode timings become the longer of the start and target durations, the session clock scales
+ *  the progress onto them, so a phase that ramps up from zero still animates. The cycle length the
+ *  clock reports is then the first cycle of the table, not the sum of these timings.
+ */
+void MainWindow::updateSchedule()
+{
+    if (!dptr->dialog->getRamp())
+    {
+        dptr->clock.setSchedule(QSharedPointer<const PacingSchedule>());
+        return;
+    }
+    quint32 fromMS[4], toMS[4];
+    for (quint8 mode : {Modes::Inhale, Modes::HoldIn, Modes::Exhale, Modes::HoldOut})
+    {
+        fromMS[mode] = dptr->modeList[mode]->getTimeMS();
+        toMS[mode] = quint32(qRound(dptr->dialog->getRampTimeMS(mode) * dptr->tempo));
+        dptr->modeList[mode]->setTimeMS(qMax(fromMS[mode], toMS[mode]));
+    }
+    qint64 rampMS = qint64(dptr->dialog->getRampMinutes()) * 60 * 1000;
+    QVector<quint8> order = {Modes::Inhale, Modes::HoldIn, Modes::Exhale, Modes::HoldOut};
+    QSharedPointer<const PacingSchedule> schedule(new PacingSchedule(PacingSchedule::ramp(fromMS, toMS, rampMS), order, rampMS));
+    dptr->clock.setSchedule(schedule);
+    qCInfo(lcMain) << Q_FUNC_INFO << schedule->phaseCount() << "phases over" << schedule->spanMS() << "ms";
 }
 
+/*!
+ * \brief MainWindow::updateTempo Scale the mode timings by the tempo, nothing else of the settings is read again
+ *  Used as the tempo follows a measured breath, which is not a settings change and is not recorded as one.
+ */
+void MainWindow::updateTempo()
+{
+    quint32 elapsed = 0;
+    Mode *active = dptr->clock.isRunning() ? dptr->clock.current(elapsed) : nullptr;
+    for (quint8 mode : {Modes::Inhale, Modes::HoldIn, Modes::Exhale, Modes::HoldOut})
+        dptr->modeList[mode]->setTimeMS(quint32(qRound(dptr->dialog->getTimeMS(mode) * dptr->tempo)));
+    updateSchedule();
+    if (dptr->cacheDebounce) dptr->cacheDebounce->start();
+    continueCycle(active, elapsed);
+}
+
+/*!
+ * \brief MainWindow::continueCycle Carry on from the same point of the cycle after the mode timings changed
+ * \param active Mode that was active before the change, nullptr while the clock is stopped
+ * \param elapsed Its progress before the change
+ */
+void MainWindow::continueCycle(Mode *active, quint32 elapsed)
+{
+    if (!active) return;
+    dptr->clock.rebase(active, elapsed);
+    if (dptr->seen) syncPhase();
+    if (dptr->audio)
+    {
+        active = dptr->clock.current(elapsed);
+        dptr->audio->sync(dptr->modeList[Modes::Inhale], active, elapsed, &dptr->clock);
+    }
+}
 
 /*!
  * \brief MainWindow::updateSettings Set all the mode parameters by getting the settings from Dialog class
  */
 void MainWindow::updateSettings()
 {
+    // Remember where in the cycle we are, so new timings continue from the same phase
+    quint32 elapsed = 0;
+    Mode *active = dptr->clock.isRunning() ? dptr->clock.current(elapsed) : nullptr;
 
     dptr->modeList[Modes::Inhale]->setShape(dptr->dialog->getShape(Modes::Inhale));
     dptr->modeList[Modes::Exhale]->setShape(dptr->dialog->getShape(Modes::Exhale));
@@ -424,16 +1031,32 @@ void MainWindow::updateSettings()
     dptr->modeList[Modes::HoldIn]->setDirection(dptr->dialog->getDirection(Modes::HoldIn));
     dptr->modeList[Modes::HoldOut]->setDirection(dptr->dialog->getDirection(Modes::HoldOut));
 
-    dptr->modeList[Modes::Inhale]->setTimeMS(dptr->dialog->getTimeMS(Modes::Inhale));
-    dptr->modeList[Modes::Exhale]->setTimeMS(dptr->dialog->getTimeMS(Modes::Exhale));
-    dptr->modeList[Modes::HoldIn]->setTimeMS(dptr->dialog->getTimeMS(Modes::HoldIn));
-    dptr->modeList[Modes::HoldOut]->setTimeMS(dptr->dialog->getTimeMS(Modes::HoldOut));
+    dptr->modeList[Modes::Inhale]->setTimeMS(quint32(qRound(dptr->dialog->getTimeMS(Modes::Inhale) * dptr->tempo)));
+    dptr->modeList[Modes::Exhale]->setTimeMS(quint32(qRound(dptr->dialog->getTimeMS(Modes::Exhale) * dptr->tempo)));
+    dptr->modeList[Modes::HoldIn]->setTimeMS(quint32(qRound(dptr->dialog->getTimeMS(Modes::HoldIn) * dptr->tempo)));
+    dptr->modeList[Modes::HoldOut]->setTimeMS(quint32(qRound(dptr->dialog->getTimeMS(Modes::HoldOut) * dptr->tempo)));
+    updateSchedule();
 
     dptr->modeList[Modes::Inhale]->setColor(dptr->dialog->getColor(Modes::Inhale));
     dptr->modeList[Modes::Exhale]->setColor(dptr->dialog->getColor(Modes::Exhale));
     dptr->modeList[Modes::HoldIn]->setColor(dptr->dialog->getColor(Modes::HoldIn));
     dptr->modeList[Modes::HoldOut]->setColor(dptr->dialog->getColor(Modes::HoldOut));
 
+    dptr->modeList[Modes::Inhale]->setEndColor(dptr->dialog->getEndColor(Modes::Inhale));
+    dptr->modeList[Modes::Exhale]->setEndColor(dptr->dialog->getEndColor(Modes::Exhale));
+    dptr->modeList[Modes::HoldIn]->setEndColor(dptr->dialog->getEndColor(Modes::HoldIn));
+    dptr->modeList[Modes::HoldOut]->setEndColor(dptr->dialog->getEndColor(Modes::HoldOut));
+
+    dptr->modeList[Modes::Inhale]->setLabel(dptr->dialog->getLabel(Modes::Inhale));
+    dptr->modeList[Modes::Exhale]->setLabel(dptr->dialog->getLabel(Modes::Exhale));
+    dptr->modeList[Modes::HoldIn]->setLabel(dptr->dialog->getLabel(Modes::HoldIn));
+    dptr->modeList[Modes::HoldOut]->setLabel(dptr->dialog->getLabel(Modes::HoldOut));
+
+    dptr->modeList[Modes::Inhale]->setCountdown(dptr->dialog->getCountdown());
+    dptr->modeList[Modes::Exhale]->setCountdown(dptr->dialog->getCountdown());
+    dptr->modeList[Modes::HoldIn]->setCountdown(dptr->dialog->getCountdown());
+    dptr->modeList[Modes::HoldOut]->setCountdown(dptr->dialog->getCountdown());
+
     dptr->modeList[Modes::Inhale]->setUserScaling(dptr->dialog->getUserScaling(Modes::Inhale));
     dptr->modeList[Modes::Exhale]->setUserScaling(dptr->dialog->getUserScaling(Modes::Exhale));
     dptr->modeList[Modes::HoldIn]->setUserScaling(dptr->dialog->getUserScaling(Modes::HoldIn));
@@ -444,9 +1067,18 @@ void MainWindow::updateSettings()
     dptr->modeList[Modes::HoldIn]->setTransparency(255-dptr->dialog->getShapeTransparency()*2.55 );
     dptr->modeList[Modes::HoldOut]->setTransparency(255-dptr->dialog->getShapeTransparency()*2.55 );
 
-    this->setWindowOpacity(1- ((float)dptr->dialog->getWindowTransparency()* PERCENT_INV_MULT) );
+    // Either the compositor fades the whole surface, or the renderer fades only the shape pixels
+    qreal opacity = 1- ((float)dptr->dialog->getWindowTransparency()* PERCENT_INV_MULT);
+    dptr->renderer->setWindowOpacity(dptr->perPixelAlpha ? opacity : 1);
+    this->setWindowOpacity(dptr->perPixelAlpha ? 1 : opacity);
+    for (OverlayWindow *overlay : dptr->overlays)
+        overlay->setWindowOpacity(this->windowOpacity());
+    if (dptr->raster) dptr->raster->setOpacity(this->windowOpacity());
+
+    if (dptr->cacheDebounce) dptr->cacheDebounce->start();
+    continueCycle(active, elapsed);
 
-    qInfo() << Q_FUNC_INFO
+    qCInfo(lcMain) << Q_FUNC_INFO
             << dptr->modeList[Modes::Inhale]->getUserScaling()
             << dptr->modeList[Modes::Exhale]->getUserScaling()
             << dptr->modeList[Modes::HoldIn]->getUserScaling()
@@ -455,10 +1087,21 @@ void MainWindow::updateSettings()
 }
 
 /*!
- * \brief MainWindow::~MainWindow Destructor
+ * \brief MainWindow::~MainWindow Destructor, logs the end of a running session before the log closes
  */
 MainWindow::~MainWindow()
 {
+    if (dptr->inSession) recordEvent(EventLog::SessionEnded);
+    saveOverlays();
+    dptr->renderer->setBreathSensor(nullptr);
+    delete dptr->sensor;
+    delete dptr->breath;
+    delete dptr->audio;
+    delete dptr->stats;
+    delete dptr->events;
+    qDeleteAll(dptr->overlays);
+    delete dptr->raster;
+    delete dptr->renderer;
     delete ui;
 }
 
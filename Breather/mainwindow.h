@@ -17,8 +17,9 @@ class MainWindow : public QMainWindow
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    explicit MainWindow(quint8 backend = WidgetBackend, QWidget *parent = nullptr);
     ~MainWindow();
+    void start();
     enum Focus : quint8
     {
         NoFocus = 0,
@@ -26,12 +27,35 @@ public:
         HoldInOut,
     };
     Q_ENUM(Focus);
+    enum Backend : quint8
+    {
+        WidgetBackend = 0, ///< This QMainWindow is the overlay
+        RasterBackend,     ///< A bare QRasterWindow is the overlay
+    };
+    Q_ENUM(Backend);
+    void setPerPixelAlpha(bool perPixel);
+    enum ClickThrough : quint8
+    {
+        NoClickThrough = 0, ///< The whole window takes input
+        ShapeClickThrough,  ///< Only the shapes take input, clicks elsewhere reach the windows below
+        FullClickThrough,   ///< No part of the window takes input
+    };
+    Q_ENUM(ClickThrough);
+    void setClickThrough(quint8 clickThrough);
+    bool exportSession(const QString &path, const QSize &size, quint8 fps, qint64 durationMS);
+    void setCycleCache(quint32 budgetMB);
+    void setMorphMS(quint32 morphMS);
+    void setGlow(quint8 radius);
+    bool setAudio(quint8 features, const QString &wavPath);
+    bool setBreathInput(const QString &input);
+    void setBreathSensor(const QString &spec, bool adapt);
+    bool setEventLog(const QString &dir);
+    void setParticles(int count);
 
 private:
     Ui::MainWindow *ui;
     typedef QMainWindow inherited;
     MainData *dptr; // DPointer style of coding
-    void drawShape(QPainter &qp, QRect xywh, quint8 shape);
 
     void paintEvent(QPaintEvent *);
     void mouseMoveEvent(QMouseEvent *event);
@@ -39,15 +63,31 @@ private:
     void mousePressEvent(QMouseEvent *event);
     void wheelEvent(QWheelEvent *event);
     void timerEvent(QTimerEvent *event);
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+    void changeEvent(QEvent *event);
+    void moveEvent(QMoveEvent *event);
+    bool eventFilter(QObject *watched, QEvent *event);
 
     void setFocusedModesScaling(qint8 scrollX, qint8 scollY);
+    void setBackend(quint8 backend);
 
 
     QSize sizeHint() const;
     void keyPressEvent(QKeyEvent *event); //override
     void getNextFocus();
     void setFocusedModesPosition(quint8 position);
-    bool isModeInFocus(quint8 mode, quint8 focus);
+    quint32 syncPhase();
+    bool isSeen() const;
+    void createOverlays();
+    void saveOverlays();
+    void setOverlaysVisible(bool visible);
+    void setPrimaryVisible(bool visible);
+    void updateInputShapes();
+    void updateSchedule();
+    void updateTempo();
+    void continueCycle(Mode *active, quint32 elapsed);
+    void recordEvent(quint16 type, quint8 mode = 0, float value = 0, quint32 arg = 0);
 
     QMetaEnum enumFocus  = QMetaEnum::fromType<Focus>();
 
@@ -55,6 +95,14 @@ private:
     void onModeTimeout();
     void showWindow();
     void updateSettings();
+    void onSettingsClosed();
+    void updateVisibility();
+    void onQualityChanged();
+    void onSessionStarted();
+    void onSessionEnded();
+    void rebuildCycleCache();
+    void onAdherenceChanged(float score);
+    void onBreathMeasured(float periodMS, float inhaleShare);
 
 };
 #endif // MAINWINDOW_H
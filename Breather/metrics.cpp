@@ -0,0 +1,301 @@
+#include "metrics.h"
+#include "logging.h"
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QFile>
+#include <QElapsedTimer>
+#include <atomic>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+/// Upper bounds of the paint time histogram buckets in seconds, +Inf is implicit
+const double paintBuckets[] = {0.00025, 0.0005, 0.001, 0.002, 0.004, 0.008, 0.016, 0.033};
+const int paintBucketCount = sizeof(paintBuckets) / sizeof(paintBuckets[0]);
+
+/*!
+ * \brief The MetricsData struct
+ */
+struct MetricsData
+{
+    std::atomic<quint64> framesRendered {0};  ///< Frames painted so far
+    std::atomic<quint64> framesDropped {0};   ///< Ticks that passed without a paint
+    std::atomic<quint64> settingsWrites {0};  ///< Times the config file was written
+    std::atomic<quint64> paintBucket[paintBucketCount + 1] {}; ///< Non-cumulative bucket counts, last one is +Inf
+    std::atomic<quint64> paintSumNS {0};      ///< Sum of all paint times
+    std::atomic<qint32>  phaseDriftMS {0};    ///< Drift of the last phase change against its schedule
+    std::atomic<qint32>  phaseDriftMaxMS {0}; ///< Largest absolute drift seen
+    QElapsedTimer processClock;               ///< Started first thing in main()
+    std::atomic<qint64>  startupNS {0};       ///< Time from process start to the first painted frame
+    std::atomic<quint64> artworkHits {0};     ///< Artwork draws served by a ready mip level of the wanted size
+    std::atomic<quint64> artworkMisses {0};   ///< Artwork draws that had to fall back to another level
+    std::atomic<qint64>  artworkBytes {0};    ///< Memory held by all artwork mip levels
+    std::atomic<quint64> audioUnderruns {0};  ///< Audio frames played as silence because no cue or tone was ready
+    std::atomic<float>   breathAdherence {0}; ///< Latest breath adherence score
+    std::atomic<quint64> breathSkipped {0};   ///< Captured hops skipped to keep breath detection latency bounded
+};
+
+MetricsData metrics;
+
+/*!
+ * \brief cpuSeconds User plus system CPU time consumed by this process
+ */
+double cpuSeconds()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+             + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+    return 0;
+}
+
+void appendMetric(QByteArray &out, const char *name, const char *type, const char *help, const QByteArray &value)
+{
+    out += QByteArray("# HELP ") + name + " " + help + "\n";
+    out += QByteArray("# TYPE ") + name + " " + type + "\n";
+    out += QByteArray(name) + " " + value + "\n";
+}
+
+} // namespace
+
+/*!
+ * \brief Metrics::processStarted Mark the start of the process, the first frame after it gives the startup time
+ */
+void Metrics::processStarted()
+{
+    metrics.processClock.start();
+}
+
+/*!
+ * \brief Metrics::frameRendered Count a painted frame and record how long the paint took
+ * \param paintTimeNS
+ */
+void Metrics::frameRendered(qint64 paintTimeNS)
+{
+    if (metrics.startupNS.load(std::memory_order_relaxed) == 0 && metrics.processClock.isValid())
+        metrics.startupNS.store(metrics.processClock.nsecsElapsed(), std::memory_order_relaxed);
+    metrics.framesRendered.fetch_add(1, std::memory_order_relaxed);
+    metrics.paintSumNS.fetch_add(paintTimeNS, std::memory_order_relaxed);
+    double seconds = paintTimeNS * 1e-9;
+    int bucket = 0;
+    while (bucket < paintBucketCount && seconds > paintBuckets[bucket]) bucket++;
+    metrics.paintBucket[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Metrics::framesDropped Count ticks that were due but never painted
+ * \param count
+ */
+void Metrics::framesDropped(quint32 count)
+{
+    metrics.framesDropped.fetch_add(count, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Metrics::phaseDrift Record how late (positive) or early a phase change happened
+ * \param driftMS
+ */
+void Metrics::phaseDrift(qint32 driftMS)
+{
+    metrics.phaseDriftMS.store(driftMS, std::memory_order_relaxed);
+    qint32 magnitude = qAbs(driftMS);
+    qint32 seen = metrics.phaseDriftMaxMS.load(std::memory_order_relaxed);
+    while (magnitude > seen && !metrics.phaseDriftMaxMS.compare_exchange_weak(seen, magnitude, std::memory_order_relaxed)) {}
+}
+
+/*!
+ * \brief Metrics::settingsWritten Count a write of the config file
+ */
+void Metrics::settingsWritten()
+{
+    metrics.settingsWrites.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Metrics::artworkLookup Count an artwork draw as served by the wanted mip level or not
+ * \param hit
+ */
+void Metrics::artworkLookup(bool hit)
+{
+    (hit ? metrics.artworkHits : metrics.artworkMisses).fetch_add(1, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Metrics::artworkCacheBytes Track the memory held by artwork mip levels
+ * \param delta Bytes added, negative when levels were dropped
+ */
+void Metrics::artworkCacheBytes(qint64 delta)
+{
+    metrics.artworkBytes.fetch_add(delta, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Metrics::audioUnderrun Count audio frames an audio sink had to fill with silence
+ * \param frames
+ */
+void Metrics::audioUnderrun(quint32 frames)
+{
+    metrics.audioUnderruns.fetch_add(frames, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Metrics::breathAdherence Publish the latest breath adherence score
+ * \param score 0..1
+ */
+void Metrics::breathAdherence(float score)
+{
+    metrics.breathAdherence.store(score, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Metrics::breathHopsSkipped Count captured hops breath detection skipped because it fell behind
+ * \param hops
+ */
+void Metrics::breathHopsSkipped(quint32 hops)
+{
+    metrics.breathSkipped.fetch_add(hops, std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Metrics::exposition Render all metrics in Prometheus text exposition format 0.0.4
+ * \return
+ */
+QByteArray Metrics::exposition()
+{
+    QByteArray out;
+    appendMetric(out, "breather_frames_rendered_total", "counter", "Frames painted by the overlay",
+                 QByteArray::number(metrics.framesRendered.load(std::memory_order_relaxed)));
+    appendMetric(out, "breather_frames_dropped_total", "counter", "Animation ticks that passed without a paint",
+                 QByteArray::number(metrics.framesDropped.load(std::memory_order_relaxed)));
+    appendMetric(out, "breather_settings_writes_total", "counter", "Writes of the settings file",
+                 QByteArray::number(metrics.settingsWrites.load(std::memory_order_relaxed)));
+    appendMetric(out, "breather_phase_drift_seconds", "gauge", "Drift of the last phase change against its schedule",
+                 QByteArray::number(metrics.phaseDriftMS.load(std::memory_order_relaxed) * 1e-3));
+    appendMetric(out, "breather_phase_drift_max_seconds", "gauge", "Largest absolute phase drift seen",
+                 QByteArray::number(metrics.phaseDriftMaxMS.load(std::memory_order_relaxed) * 1e-3));
+
+    out += "# HELP breather_paint_seconds Time spent in a single overlay paint\n";
+    out += "# TYPE breather_paint_seconds histogram\n";
+    quint64 cumulative = 0;
+    for (int i = 0; i < paintBucketCount; i++)
+    {
+        cumulative += metrics.paintBucket[i].load(std::memory_order_relaxed);
+        out += "breather_paint_seconds_bucket{le=\"" + QByteArray::number(paintBuckets[i]) + "\"} "
+             + QByteArray::number(cumulative) + "\n";
+    }
+    cumulative += metrics.paintBucket[paintBucketCount].load(std::memory_order_relaxed);
+    out += "breather_paint_seconds_bucket{le=\"+Inf\"} " + QByteArray::number(cumulative) + "\n";
+    out += "breather_paint_seconds_sum " + QByteArray::number(metrics.paintSumNS.load(std::memory_order_relaxed) * 1e-9) + "\n";
+    out += "breather_paint_seconds_count " + QByteArray::number(cumulative) + "\n";
+
+    appendMetric(out, "breather_artwork_cache_hits_total", "counter", "Artwork draws served by the wanted mip level",
+                 QByteArray::number(metrics.artworkHits.load(std::memory_order_relaxed)));
+    appendMetric(out, "breather_artwork_cache_misses_total", "counter", "Artwork draws that fell back to another mip level",
+                 QByteArray::number(metrics.artworkMisses.load(std::memory_order_relaxed)));
+    appendMetric(out, "breather_artwork_cache_bytes", "gauge", "Memory held by artwork mip levels",
+                 QByteArray::number(metrics.artworkBytes.load(std::memory_order_relaxed)));
+    appendMetric(out, "breather_audio_underrun_frames_total", "counter", "Audio frames played as silence because synthesis fell behind",
+                 QByteArray::number(metrics.audioUnderruns.load(std::memory_order_relaxed)));
+    appendMetric(out, "breather_breath_adherence_ratio", "gauge", "Share of recent time the detected breathing followed the pattern",
+                 QByteArray::number(metrics.breathAdherence.load(std::memory_order_relaxed)));
+    appendMetric(out, "breather_breath_hops_skipped_total", "counter", "Captured audio hops skipped to keep breath detection latency bounded",
+                 QByteArray::number(metrics.breathSkipped.load(std::memory_order_relaxed)));
+    appendMetric(out, "breather_startup_seconds", "gauge", "Time from process start to the first painted frame",
+                 QByteArray::number(metrics.startupNS.load(std::memory_order_relaxed) * 1e-9));
+    appendMetric(out, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes",
+                 QByteArray::number(Metrics::residentBytes()));
+    appendMetric(out, "process_cpu_seconds_total", "counter", "Total user and system CPU time spent in seconds",
+                 QByteArray::number(cpuSeconds()));
+    return out;
+}
+
+/*!
+ * \brief Metrics::startupNS Time from the start of the process to the first painted frame
+ * \return 0 until a frame was painted
+ */
+qint64 Metrics::startupNS()
+{
+    return metrics.startupNS.load(std::memory_order_relaxed);
+}
+
+/*!
+ * \brief Metrics::residentBytes Resident set size of this process
+ * \return 0 where it cannot be read
+ */
+quint64 Metrics::residentBytes()
+{
+#ifdef Q_OS_LINUX
+    QFile statm("/proc/self/statm");
+    if (statm.open(QIODevice::ReadOnly))
+    {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.size() > 1)
+            return fields.at(1).toULongLong() * sysconf(_SC_PAGESIZE);
+    }
+#endif
+    return 0;
+}
+
+/*!
+ * \brief MetricsServer::MetricsServer Constructor
+ * \param parent
+ */
+MetricsServer::MetricsServer(QObject *parent)
+    : QTcpServer(parent)
+{
+    connect(this, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+}
+
+/*!
+ * \brief MetricsServer::start Listen on the loopback interface only
+ * \param port
+ * \return
+ */
+bool MetricsServer::start(quint16 port)
+{
+    if (!listen(QHostAddress::LocalHost, port))
+    {
+        qCWarning(lcMetrics) << "Metrics endpoint could not listen on port" << port << errorString();
+        return false;
+    }
+    qCInfo(lcMetrics).noquote() << QString("Metrics endpoint on http://127.0.0.1:%1/metrics").arg(serverPort());
+    return true;
+}
+
+/*!
+ * \brief MetricsServer::onNewConnection Answer each request once the header is complete, then close
+ */
+void MetricsServer::onNewConnection()
+{
+    while (QTcpSocket *socket = nextPendingConnection())
+    {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, socket, [socket]()
+        {
+            QByteArray request = socket->peek(4096);
+            if (!request.contains("\r\n\r\n") && request.size() < 4096) return;
+
+            QByteArray status = "200 OK", body;
+            QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+            if (requestLine.size() >= 2 && requestLine.at(0) == "GET"
+                && (requestLine.at(1) == "/metrics" || requestLine.at(1) == "/"))
+                body = Metrics::exposition();
+            else
+                status = "404 Not Found";
+
+            socket->readAll();
+            QObject::disconnect(socket, &QTcpSocket::readyRead, nullptr, nullptr);
+            socket->write("HTTP/1.0 " + status + "\r\n"
+                          "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n" + body);
+            socket->disconnectFromHost();
+        });
+    }
+}
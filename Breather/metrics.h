@@ -0,0 +1,46 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QTcpServer>
+#include <QByteArray>
+
+/*!
+ * \brief The Metrics class Process wide health counters
+ *  All recorders are relaxed atomic adds, so they can be called from the paint path while a
+ *  scrape is being served without either side ever blocking.
+ */
+class Metrics
+{
+public:
+    static void processStarted();
+    static void frameRendered(qint64 paintTimeNS);
+    static void framesDropped(quint32 count);
+    static void phaseDrift(qint32 driftMS);
+    static void settingsWritten();
+    static void artworkLookup(bool hit);
+    static void artworkCacheBytes(qint64 delta);
+    static void audioUnderrun(quint32 frames);
+    static void breathAdherence(float score);
+    static void breathHopsSkipped(quint32 hops);
+
+    static QByteArray exposition();
+    static qint64 startupNS();
+    static quint64 residentBytes();
+};
+
+/*!
+ * \brief The MetricsServer class Localhost-only HTTP endpoint serving Metrics in Prometheus text format
+ *  Try it with: curl http://127.0.0.1:<port>/metrics
+ */
+class MetricsServer : public QTcpServer
+{
+    Q_OBJECT
+public:
+    MetricsServer(QObject *parent = nullptr);
+    bool start(quint16 port);
+
+private slots:
+    void onNewConnection();
+};
+
+#endif // METRICS_H
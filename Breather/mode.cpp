@@ -1,5 +1,6 @@
 #include "mode.h"
-#include <QDebug>
+#include "logging.h"
+#include "colorramp.h"
 #include <QTimer>
 #include <QTime>
 #include <QMap>
@@ -11,6 +12,8 @@
 struct ModeData
 {
     QColor color; ///< Color of the shape
+    QColor endColor; ///< Color the shape fades to by the end of the phase, invalid to keep the color
+    ColorRamp ramp; ///< Precomputed fade from color to endColor
     quint32 timeMS; ///< Time the shape will be changing
     quint8 thisMode; ///< Alotted num (enum) to this Mode
     quint8 shape = Shape::Ellipse; ///< Selected shape of the mode
@@ -21,10 +24,10 @@ struct ModeData
     quint8 transparency; ///< Store the trasnparancy for the shape
     float minScreenToUse = 0.1, maxScreenToUse = 0.9; ///< min max Extent of the screen to use
     float userScalingX = 1, userScalingY = 1; ///< User multiplier - to set the size
+    QString label; ///< Text shown inside the shape, empty for none
+    bool countdown = false; ///< Show the seconds left in the phase inside the shape
 };
 
-QPoint Mode::screenSize = QPoint(0,0);
-
 /*!
  * \brief Mode::Mode Constructor for Mode Class
  * \param mode
@@ -40,6 +43,7 @@ Mode::Mode(quint8 mode, quint32 time, const QColor &color, quint8 transparency)
     d->color=color;
     d->transparency=transparency;
     d->color.setAlpha(d->transparency);
+    updateRamp();
 }
 
 /*!
@@ -72,6 +76,45 @@ void Mode::setColor(const QColor &color)
 {
     d->color = color;
     d->color.setAlpha(d->transparency);
+    updateRamp();
+}
+
+/*!
+ * \brief Mode::setEndColor Color the shape fades to in linear light over the phase
+ * \param color
+ */
+void Mode::setEndColor(const QColor &color)
+{
+    d->endColor = color;
+    updateRamp();
+}
+
+/*!
+ * \brief Mode::setLabel Text shown inside the shape during this phase
+ * \param label Empty for none
+ */
+void Mode::setLabel(const QString &label)
+{
+    d->label = label;
+}
+
+/*!
+ * \brief Mode::setCountdown Show the seconds left in the phase inside the shape
+ * \param countdown
+ */
+void Mode::setCountdown(bool countdown)
+{
+    d->countdown = countdown;
+}
+
+/*!
+ * \brief Mode::updateRamp Precompute the color fade after the colors or the transparency changed
+ */
+void Mode::updateRamp()
+{
+    QColor end = d->endColor.isValid() ? d->endColor : d->color;
+    end.setAlpha(d->transparency);
+    d->ramp.set(d->color, end);
 }
 
 /*!
@@ -82,6 +125,7 @@ void Mode::setTransparency(const quint8 &transparency)
 {
     d->transparency=transparency;
     d->color.setAlpha(d->transparency);
+    updateRamp();
 }
 
 /*!
@@ -141,6 +185,45 @@ QColor Mode::getColor()
     return d->color;
 }
 
+/*!
+ * \brief Mode::getEndColor
+ * \return
+ */
+QColor Mode::getEndColor()
+{
+    QColor end = d->endColor.isValid() ? d->endColor : d->color;
+    end.setAlpha(d->transparency);
+    return end;
+}
+
+/*!
+ * \brief Mode::getLabel
+ * \return
+ */
+QString Mode::getLabel()
+{
+    return d->label;
+}
+
+/*!
+ * \brief Mode::getCountdown
+ * \return
+ */
+bool Mode::getCountdown()
+{
+    return d->countdown;
+}
+
+/*!
+ * \brief Mode::getColorAt Color of the shape at a point of the phase, a LUT lookup
+ * \param elapsedTimeMS
+ * \return
+ */
+QColor Mode::getColorAt(const quint32 &elapsedTimeMS)
+{
+    return d->ramp.colorAt(d->timeMS ? float(elapsedTimeMS) / d->timeMS : 0);
+}
+
 /*!
  * \brief Mode::getTransparency
  * \return
@@ -251,15 +334,6 @@ void Mode::setScreenUsage(const float &mintouse, const float &maxtouse)
     d->maxScreenToUse = maxtouse;
 }
 
-/*!
- * \brief Mode::setScreenSize
- * \param screensize
- */
-void Mode::setScreenSize(const QPoint &screensize)
-{
-    screenSize = QPoint(screensize);
-}
-
 /*!
  * \brief Mode::getRatioCompleted Get ratio of how much fraction the time has elapsed w.r.t. the set time
  * \param elapsedTimeMS
@@ -277,9 +351,10 @@ float Mode::getRatioCompleted(const quint32 &elapsedTimeMS)
 /*!
  * \brief Mode::getShapeDimensions Get the dimensions (size) of this mode shape
  * \param elapsedTimeMS
+ * \param screenSize Size of the window the shape is drawn in
  * \return
  */
-QPoint Mode::getShapeDimensions(const quint32 &elapsedTimeMS)
+QPoint Mode::getShapeDimensions(const quint32 &elapsedTimeMS, const QPoint &screenSize)
 {
     QPoint dims;
     float completedRatio = getRatioCompleted(elapsedTimeMS);
@@ -305,29 +380,32 @@ QPoint Mode::getShapeDimensions(const quint32 &elapsedTimeMS)
 
 /*!
  * \brief Mode::getScreenCentre
+ * \param screenSize
  * \return
  */
-QPoint Mode::getScreenCentre()
+QPoint Mode::getScreenCentre(const QPoint &screenSize)
 {
     return QPoint(screenSize.x()/2, screenSize.y()/2);
 }
 
 /*!
  * \brief Mode::getInitShapeCoord
+ * \param screenSize
  * \return
  */
-QRect Mode::getInitShapeCoord()
+QRect Mode::getInitShapeCoord(const QPoint &screenSize)
 {
-    return getShapeCoord(0);
+    return getShapeCoord(0, screenSize);
 }
 
 /*!
  * \brief Mode::getEndShapeCoord
+ * \param screenSize
  * \return
  */
-QRect Mode::getEndShapeCoord()
+QRect Mode::getEndShapeCoord(const QPoint &screenSize)
 {
-    return getShapeCoord(d->timeMS);
+    return getShapeCoord(d->timeMS, screenSize);
 }
 
 /*!
@@ -341,10 +419,19 @@ void Mode::changeUserScaling(qint8 scrollX, qint8 scrollY)
     d->userScalingY += scrollY*0.05;
     if (d->userScalingX > 1) d->userScalingX = 1; if (d->userScalingX < 0) d->userScalingX = 0;
     if (d->userScalingY > 1) d->userScalingY = 1; if (d->userScalingY < 0) d->userScalingY = 0;
-    qInfo() << Q_FUNC_INFO << scrollX << scrollY << d->userScalingX << d->userScalingY;
+    qCDebug(lcMode) << Q_FUNC_INFO << scrollX << scrollY << d->userScalingX << d->userScalingY;
 //    setAutoScaling();
 }
 
+/*!
+ * \brief Mode::copySettings Take over every setting of another mode except its successor, e.g. to snapshot it for another thread
+ * \param other
+ */
+void Mode::copySettings(Mode *other)
+{
+    *d = *other->d;
+}
+
 /*!
  * \brief Mode::getUserScaling
  * \return
@@ -357,13 +444,14 @@ QPointF Mode::getUserScaling()
 /*!
  * \brief Mode::getShapeCoord
  * \param elapsedTimeMS
+ * \param screenSize Size of the window the shape is drawn in, every window has its own
  * \return
  */
-QRect Mode::getShapeCoord(const quint32 &elapsedTimeMS)
+QRect Mode::getShapeCoord(const quint32 &elapsedTimeMS, const QPoint &screenSize)
 {
-    QPoint shapeDims = getShapeDimensions(elapsedTimeMS);
+    QPoint shapeDims = getShapeDimensions(elapsedTimeMS, screenSize);
     QRect shapeCoords;
-    QPoint centre = getScreenCentre();
+    QPoint centre = getScreenCentre(screenSize);
     QPoint topLeft = QPoint(centre.x()-shapeDims.x()/2, centre.y()-shapeDims.y()/2 );
     QPoint minTopLeft = QPoint(screenSize.x()*d->minScreenToUse/2, screenSize.y()*d->minScreenToUse/2 );
     QPoint minBottomRight = QPoint(screenSize.x()*(1-d->minScreenToUse/2)-shapeDims.x(), screenSize.y()*(1-d->minScreenToUse/2)-shapeDims.y());
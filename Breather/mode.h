@@ -5,12 +5,14 @@
 #include <QPoint>
 #include <QRect>
 #include <QObject>
+#include <QString>
 
 enum Shape : quint8
 {
     Ellipse=0,
     Rectangle,
-    RoundedRectangle
+    RoundedRectangle,
+    FirstCustom=16 ///< Shapes registered in ShapeRegistry are numbered from here on
 };
 
 enum Position : quint8
@@ -59,10 +61,12 @@ public:
     Mode(quint8 mode);
 
     void setColor(const QColor &color);
+    void setEndColor(const QColor &color);
+    void setLabel(const QString &label);
+    void setCountdown(bool countdown);
     void setTransparency(const quint8 &transparency);
     void setTimeMS(const quint32 &time);
     void setMode(const quint8 &mode);
-    static void setScreenSize(const QPoint &screensize);
     void setNext(Mode* setMode);
     void setShape(const quint8 &shape);
     void setPosition(const quint8 &position);
@@ -72,8 +76,13 @@ public:
     void setUserScaling(float scalingX, float scalingY);
     void setUserScaling(const QPointF &scaling);
     void changeUserScaling(qint8 scrollX, qint8 scrollY);
+    void copySettings(Mode *other);
 
     QColor  getColor();
+    QColor  getEndColor();
+    QColor  getColorAt(const quint32 &elapsedTimeMS);
+    QString getLabel();
+    bool    getCountdown();
     quint8  getTransparency();
     quint32 getTimeMS();
     quint8  getMode();
@@ -83,18 +92,18 @@ public:
     quint8  getDirection();
 
     float   getRatioCompleted(const quint32 &elapsedTimeMS);
-    QRect   getShapeCoord(const quint32 &elapsedTimeMS);
-    QRect   getInitShapeCoord();
-    QRect   getEndShapeCoord();
-    QPoint  getShapeDimensions(const quint32 &elapsedTimeMS);
-    QPoint  getScreenCentre();
+    QRect   getShapeCoord(const quint32 &elapsedTimeMS, const QPoint &screenSize);
+    QRect   getInitShapeCoord(const QPoint &screenSize);
+    QRect   getEndShapeCoord(const QPoint &screenSize);
+    QPoint  getShapeDimensions(const quint32 &elapsedTimeMS, const QPoint &screenSize);
+    QPoint  getScreenCentre(const QPoint &screenSize);
     QPointF getUserScaling();
 
 
 private:
+    void updateRamp();
     ModeData *d;
     Mode* next; ///< Pointer to the next mode - basically circular linked list
-    static QPoint screenSize;
 };
 
 #endif // MODE_H
@@ -0,0 +1,187 @@
+#include "overlaywindow.h"
+#include "renderer.h"
+#include "metrics.h"
+#include "mainwindow.h"
+#include <QtGui>
+
+/*!
+ * \brief OverlayWindow::OverlayWindow Constructor
+ * \param renderer Renderer shared with the main window
+ * \param frame Frame state shared with the main window
+ * \param controller Window that owns the modes and handles editing input
+ */
+OverlayWindow::OverlayWindow(Renderer *renderer, const FrameState *frame, QWidget *controller)
+    : QWidget(nullptr)
+    , renderer(renderer)
+    , frame(frame)
+    , controller(controller)
+{
+    this->setWindowFlags(Qt::CustomizeWindowHint | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::BypassWindowManagerHint | Qt::Tool);
+    this->setAttribute(Qt::WA_TranslucentBackground);
+    this->setAttribute(Qt::WA_NoSystemBackground);
+    this->setWindowTitle("Breathe");
+}
+
+/*!
+ * \brief OverlayWindow::isWindowSeen Whether any part of a top level window can currently be seen by the user
+ * \param window
+ * \return
+ */
+bool OverlayWindow::isWindowSeen(const QWidget *window)
+{
+    if (!window->isVisible() || window->isMinimized()) return false;
+    if (!window->windowHandle() || !window->windowHandle()->isExposed()) return false;
+    Qt::ApplicationState state = QGuiApplication::applicationState();
+    if (state == Qt::ApplicationSuspended || state == Qt::ApplicationHidden) return false;
+    for (QScreen *screen : QGuiApplication::screens())
+        if (screen->geometry().intersects(window->frameGeometry())) return true;
+    return false;
+}
+
+/*!
+ * \brief OverlayWindow::applyClickThrough Make a top level window transparent for input, or take it back
+ *  Flags are only touched when they change, as that recreates the native window.
+ *  The input mask for ShapeClickThrough is set separately by the window's InputShape.
+ * \param window
+ * \param clickThrough
+ */
+void OverlayWindow::applyClickThrough(QWidget *window, quint8 clickThrough)
+{
+    bool full = clickThrough == MainWindow::FullClickThrough;
+    if (bool(window->windowFlags() & Qt::WindowTransparentForInput) != full)
+    {
+        bool wasVisible = window->isVisible();
+        window->setWindowFlag(Qt::WindowTransparentForInput, full);
+        if (wasVisible) window->show();
+    }
+    if (clickThrough != MainWindow::ShapeClickThrough)
+        window->clearMask();
+}
+
+/*!
+ * \brief OverlayWindow::setClickThrough
+ * \param clickThrough
+ */
+void OverlayWindow::setClickThrough(quint8 clickThrough)
+{
+    this->clickThrough = clickThrough;
+    applyClickThrough(this, clickThrough);
+    inputShape.invalidate();
+    updateInputShape();
+}
+
+/*!
+ * \brief OverlayWindow::updateInputShape Move the input mask along with the shapes, only when it changed by a grid step
+ */
+void OverlayWindow::updateInputShape()
+{
+    QPoint size(width(), height());
+    if (clickThrough == MainWindow::ShapeClickThrough && inputShape.update(size, *frame, renderer->effectsRect(size, *frame)))
+        setMask(inputShape.region());
+}
+
+/*!
+ * \brief OverlayWindow::paintEvent Draw the shared frame at this window's size
+ */
+void OverlayWindow::paintEvent(QPaintEvent *)
+{
+    QElapsedTimer paintTime;
+    paintTime.start();
+    QPainter qp(this);
+    renderer->paint(qp, QPoint(width(), height()), *frame);
+    qp.end();
+    Metrics::frameRendered(paintTime.nsecsElapsed());
+}
+
+/*!
+ * \brief OverlayWindow::mousePressEvent Start dragging the overlay
+ * \param event
+ */
+void OverlayWindow::mousePressEvent(QMouseEvent *event)
+{
+    oldPos = event->globalPos();
+}
+
+/*!
+ * \brief OverlayWindow::mouseMoveEvent Drag the overlay around
+ * \param event
+ */
+void OverlayWindow::mouseMoveEvent(QMouseEvent *event)
+{
+    QPoint delta = QPoint(event->globalPos() - oldPos);
+    this->move(this->x() + delta.x(), this->y() + delta.y());
+    oldPos = event->globalPos();
+}
+
+/*!
+ * \brief OverlayWindow::wheelEvent Shape scaling is edited in the main window
+ * \param event
+ */
+void OverlayWindow::wheelEvent(QWheelEvent *event)
+{
+    QCoreApplication::sendEvent(controller, event);
+}
+
+/*!
+ * \brief OverlayWindow::keyPressEvent Focus and position keys are handled by the main window
+ * \param event
+ */
+void OverlayWindow::keyPressEvent(QKeyEvent *event)
+{
+    QCoreApplication::sendEvent(controller, event);
+}
+
+/*!
+ * \brief OverlayWindow::showEvent
+ * \param event
+ */
+void OverlayWindow::showEvent(QShowEvent *event)
+{
+    inherited::showEvent(event);
+    windowHandle()->installEventFilter(this);
+    emit visibilityChanged();
+}
+
+/*!
+ * \brief OverlayWindow::hideEvent
+ * \param event
+ */
+void OverlayWindow::hideEvent(QHideEvent *event)
+{
+    inherited::hideEvent(event);
+    emit visibilityChanged();
+}
+
+/*!
+ * \brief OverlayWindow::changeEvent
+ * \param event
+ */
+void OverlayWindow::changeEvent(QEvent *event)
+{
+    inherited::changeEvent(event);
+    if (event->type() == QEvent::WindowStateChange)
+        emit visibilityChanged();
+}
+
+/*!
+ * \brief OverlayWindow::moveEvent
+ * \param event
+ */
+void OverlayWindow::moveEvent(QMoveEvent *event)
+{
+    inherited::moveEvent(event);
+    emit visibilityChanged();
+}
+
+/*!
+ * \brief OverlayWindow::eventFilter Watch the native window for exposure changes
+ * \param watched
+ * \param event
+ * \return
+ */
+bool OverlayWindow::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == windowHandle() && event->type() == QEvent::Expose)
+        QMetaObject::invokeMethod(this, "visibilityChanged", Qt::QueuedConnection);
+    return inherited::eventFilter(watched, event);
+}
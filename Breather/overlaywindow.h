@@ -0,0 +1,51 @@
+#ifndef OVERLAYWINDOW_H
+#define OVERLAYWINDOW_H
+
+#include <QWidget>
+#include "inputshape.h"
+
+class Renderer;
+struct FrameState;
+
+/*!
+ * \brief The OverlayWindow class Additional overlay, one per screen or placed by the user
+ *  It has no timers of its own: MainWindow computes the frame once per tick and asks every
+ *  overlay to repaint it for its own size.
+ */
+class OverlayWindow : public QWidget
+{
+    Q_OBJECT
+public:
+    OverlayWindow(Renderer *renderer, const FrameState *frame, QWidget *controller);
+
+    static bool isWindowSeen(const QWidget *window);
+    static void applyClickThrough(QWidget *window, quint8 clickThrough);
+
+    void setClickThrough(quint8 clickThrough);
+    void updateInputShape();
+
+signals:
+    void visibilityChanged();
+
+private:
+    typedef QWidget inherited;
+    Renderer *renderer;       ///< Shared renderer
+    const FrameState *frame;  ///< Shared frame state of the current tick
+    QWidget *controller;      ///< Main window receiving keyboard and wheel input
+    QPoint oldPos;            ///< Keeps the position while dragging
+    quint8 clickThrough = 0;  ///< Which part of the window lets clicks through, see MainWindow::ClickThrough
+    InputShape inputShape;    ///< Cached input region while only the shapes take input
+
+    void paintEvent(QPaintEvent *event);
+    void mousePressEvent(QMouseEvent *event);
+    void mouseMoveEvent(QMouseEvent *event);
+    void wheelEvent(QWheelEvent *event);
+    void keyPressEvent(QKeyEvent *event);
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+    void changeEvent(QEvent *event);
+    void moveEvent(QMoveEvent *event);
+    bool eventFilter(QObject *watched, QEvent *event);
+};
+
+#endif // OVERLAYWINDOW_H
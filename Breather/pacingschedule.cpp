@@ -0,0 +1,120 @@
+#include "pacingschedule.h"
+#include <algorithm>
+#include <array>
+
+/*!
+ * \brief PacingSchedule::PacingSchedule Build the phase table
+ *  Cycles are added until one starts at or after spanMS, that one is the cycle that repeats.
+ * \param schedule Evaluated once at the start of every cycle
+ * \param order Modes in the order a cycle runs through them
+ * \param spanMS Session time the schedule changes over, capped at MAX_SPAN_MS
+ */
+PacingSchedule::PacingSchedule(const Function &schedule, const QVector<quint8> &order, qint64 spanMS)
+{
+    spanMS = qBound<qint64>(0, spanMS, qint64(MAX_SPAN_MS));
+    quint32 phaseMS[4];
+    qint64 startMS = 0;
+    forever
+    {
+        std::fill(phaseMS, phaseMS + 4, 0);
+        schedule(startMS, phaseMS);
+        int first = phases.size();
+        qint64 cycleStartMS = startMS;
+        for (quint8 mode : order)
+        {
+            // Zero length modes are skipped, they never become active
+            if (!phaseMS[mode & 3]) continue;
+            phases.append({startMS, phaseMS[mode & 3], mode});
+            startMS += phaseMS[mode & 3];
+        }
+        if (phases.size() == first) break; // an empty cycle would never end
+        if (first == 0) firstCycle = quint32(startMS);
+        tailIndex = first;
+        endMS = startMS;
+        if (cycleStartMS >= spanMS || phases.size() >= MAX_PHASES) break;
+    }
+}
+
+/*!
+ * \brief PacingSchedule::ramp Schedule that slides every phase linearly from one duration to another
+ *  Each cycle takes the durations reached at its start, after rampMS the target durations stay.
+ * \param fromMS Durations at the start of the session, indexed by Modes
+ * \param toMS Durations from rampMS on, indexed by Modes
+ * \param rampMS
+ * \return
+ */
+PacingSchedule::Function PacingSchedule::ramp(const quint32 *fromMS, const quint32 *toMS, qint64 rampMS)
+{
+    std::array<quint32, 4> from, to;
+    std::copy(fromMS, fromMS + 4, from.begin());
+    std::copy(toMS, toMS + 4, to.begin());
+    return [from, to, rampMS](qint64 sessionMS, quint32 *phaseMS)
+    {
+        double t = rampMS > 0 ? qBound(0.0, double(sessionMS) / rampMS, 1.0) : 1.0;
+        for (int mode = 0; mode < 4; mode++)
+            phaseMS[mode] = quint32(qRound64(from[mode] + (double(to[mode]) - from[mode]) * t));
+    };
+}
+
+/*!
+ * \brief PacingSchedule::locate Find the phase active at the given session time
+ * \param sessionMS
+ * \param mode Mode of the active phase
+ * \param elapsedInPhaseMS Time already spent in the active phase
+ * \param phaseMS Duration of the active phase
+ * \param previous Mode of the phase before, NO_MODE during the very first phase
+ * \return False when the table is empty
+ */
+bool PacingSchedule::locate(qint64 sessionMS, quint8 &mode, quint32 &elapsedInPhaseMS, quint32 &phaseMS,
+                            quint8 *previous) const
+{
+    if (phases.isEmpty()) return false;
+    qint64 t = qMax<qint64>(0, sessionMS);
+    bool repeating = t >= endMS;
+    if (repeating)
+    {
+        qint64 tailStartMS = phases[tailIndex].startMS;
+        t = tailStartMS + (t - tailStartMS) % (endMS - tailStartMS);
+    }
+    auto after = std::upper_bound(phases.constBegin(), phases.constEnd(), t,
+                                  [](qint64 value, const Phase &phase) { return value < phase.startMS; });
+    int index = int(after - phases.constBegin()) - 1;
+    const Phase &phase = phases[index];
+    mode = phase.mode;
+    elapsedInPhaseMS = quint32(t - phase.startMS);
+    phaseMS = phase.durationMS;
+    if (previous)
+    {
+        if (repeating && index == tailIndex) *previous = phases.last().mode;
+        else if (index > 0) *previous = phases[index - 1].mode;
+        else *previous = NO_MODE;
+    }
+    return true;
+}
+
+/*!
+ * \brief PacingSchedule::spanMS Session time covered by the table before its last cycle repeats
+ * \return
+ */
+qint64 PacingSchedule::spanMS() const
+{
+    return endMS;
+}
+
+/*!
+ * \brief PacingSchedule::firstCycleMS Length of the first cycle of the table, 0 when it is empty
+ * \return
+ */
+quint32 PacingSchedule::firstCycleMS() const
+{
+    return firstCycle;
+}
+
+/*!
+ * \brief PacingSchedule::phaseCount Number of phases in the table
+ * \return
+ */
+int PacingSchedule::phaseCount() const
+{
+    return phases.size();
+}
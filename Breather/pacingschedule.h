@@ -0,0 +1,51 @@
+#ifndef PACINGSCHEDULE_H
+#define PACINGSCHEDULE_H
+
+#include <QVector>
+#include <functional>
+
+/*!
+ * \brief The PacingSchedule class Phase durations for a whole session, worked out up front
+ *  A schedule function gives the four phase durations for a point of the session. It is evaluated
+ *  once per cycle while the phase table is built; the session clock then only binary searches the
+ *  table, so the frame path never runs the schedule. Past the end of the table the last cycle
+ *  repeats.
+ */
+class PacingSchedule
+{
+public:
+    /// Fills phaseMS, indexed by Modes, with the durations of the cycle starting at sessionMS
+    typedef std::function<void(qint64 sessionMS, quint32 *phaseMS)> Function;
+
+    static const qint64 MAX_SPAN_MS = 4*60*60*1000; ///< Longest stretch a table is built for
+    static const int MAX_PHASES = 1 << 16;          ///< Bound on the table size for very short phases
+    static const quint8 NO_MODE = 0xFF;
+
+    /*!
+     * \brief The Phase struct One entry of the phase table
+     */
+    struct Phase
+    {
+        qint64 startMS;     ///< Session time the phase starts at
+        quint32 durationMS;
+        quint8 mode;
+    };
+
+    PacingSchedule(const Function &schedule, const QVector<quint8> &order, qint64 spanMS);
+
+    static Function ramp(const quint32 *fromMS, const quint32 *toMS, qint64 rampMS);
+
+    bool locate(qint64 sessionMS, quint8 &mode, quint32 &elapsedInPhaseMS, quint32 &phaseMS,
+                quint8 *previous = nullptr) const;
+    qint64 spanMS() const;
+    quint32 firstCycleMS() const;
+    int phaseCount() const;
+
+private:
+    QVector<Phase> phases;
+    int tailIndex = 0; ///< First phase of the last cycle, which repeats past the end of the table
+    qint64 endMS = 0;  ///< End of the last phase in the table
+    quint32 firstCycle = 0; ///< Length of the cycle the session starts with
+};
+
+#endif // PACINGSCHEDULE_H
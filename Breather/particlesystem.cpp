@@ -0,0 +1,136 @@
+#include "particlesystem.h"
+#include <QPainter>
+#include <QRandomGenerator>
+#include <QtMath>
+
+namespace
+{
+
+/*!
+ * \brief The ParticleFrame struct Per frame output of one painting thread
+ */
+struct ParticleFrame
+{
+    QVector<float> x;
+    QVector<float> y;
+    QVector<qint32> level;   ///< Alpha level of each particle, 0 is invisible
+    QVector<QPointF> sorted; ///< Positions grouped by alpha level
+
+    void reserve(int count)
+    {
+        if (x.size() >= count) return;
+        x.resize(count);
+        y.resize(count);
+        level.resize(count);
+        sorted.resize(count);
+    }
+};
+
+thread_local ParticleFrame frame;
+
+}
+
+/*!
+ * \brief ParticleSystem::ParticleSystem Constructor
+ * \param count Number of particles, capped at MAX_COUNT
+ * \param seed Same seed, same particles
+ */
+ParticleSystem::ParticleSystem(int count, quint32 seed)
+{
+    count = qBound(0, count, MAX_COUNT);
+    cosA.resize(count);
+    sinA.resize(count);
+    offset.resize(count);
+    speed.resize(count);
+    reach.resize(count);
+    QRandomGenerator random(seed);
+    for (int i = 0; i < count; i++)
+    {
+        float angle = float(random.generateDouble() * 2 * M_PI);
+        cosA[i] = qCos(angle);
+        sinA[i] = qSin(angle);
+        offset[i] = float(random.generateDouble());
+        speed[i] = 1.0f + float(random.generateDouble());
+        reach[i] = 0.5f + 0.5f*float(random.generateDouble());
+    }
+}
+
+/*!
+ * \brief ParticleSystem::count
+ * \return
+ */
+int ParticleSystem::count() const
+{
+    return cosA.size();
+}
+
+/*!
+ * \brief ParticleSystem::bounds Rect the particles of a shape stay in, whatever the ratio
+ *  A particle travels at most one travel range, the larger half axis, out from the shape's edge.
+ * \param shape
+ * \return
+ */
+QRect ParticleSystem::bounds(const QRect &shape)
+{
+    if (shape.isEmpty()) return QRect();
+    const int range = qMax(shape.width(), shape.height()) / 2 + 2; // plus the round pen cap
+    return shape.adjusted(-range, -range, range, range);
+}
+
+/*!
+ * \brief ParticleSystem::paint Place the particles for a completed ratio and draw them around the shape
+ * \param qp
+ * \param shape Rect of the shape the particles flow into or out of
+ * \param ratio Completed ratio of the active mode
+ * \param color Particle color at full alpha level
+ */
+void ParticleSystem::paint(QPainter &qp, const QRect &shape, float ratio, const QColor &color) const
+{
+    const int n = count();
+    if (!n || shape.isEmpty()) return;
+    frame.reserve(n);
+    float *x = frame.x.data(), *y = frame.y.data();
+    qint32 *level = frame.level.data();
+    const float *c = cosA.constData(), *s = sinA.constData(), *o = offset.constData();
+    const float *v = speed.constData(), *r = reach.constData();
+
+    const float cx = shape.center().x(), cy = shape.center().y();
+    const float rx = shape.width() / 2.0f, ry = shape.height() / 2.0f;
+    const float range = qMax(rx, ry);
+
+    // Flat loops only: no branches and no calls, so they vectorize
+    for (int i = 0; i < n; i++)
+    {
+        float p = o[i] + ratio*v[i];
+        p -= float(qint32(p));                  // ratio and offset are never negative, truncation is floor
+        float dist = (1.0f - p) * r[i] * range; // p rises with the ratio, so particles close in while it rises
+        x[i] = cx + c[i]*(rx + dist);
+        y[i] = cy + s[i]*(ry + dist);
+        float alpha = 4.0f*p*(1.0f - p);        // fade in at the far end and out at the shape
+        level[i] = qint32(alpha * (ALPHA_LEVELS - 0.01f));
+    }
+
+    // Counting sort by alpha level so each level is a single drawPoints call
+    int counts[ALPHA_LEVELS] = {};
+    for (int i = 0; i < n; i++) counts[level[i]]++;
+    int starts[ALPHA_LEVELS], fill[ALPHA_LEVELS];
+    for (int l = 0, at = 0; l < ALPHA_LEVELS; l++) { starts[l] = fill[l] = at; at += counts[l]; }
+    QPointF *sorted = frame.sorted.data();
+    for (int i = 0; i < n; i++)
+        sorted[fill[level[i]]++] = QPointF(x[i], y[i]);
+
+    qp.save();
+    QPen pen(color, 2);
+    pen.setCapStyle(Qt::RoundCap);
+    // Level 0 is close enough to transparent to be left out
+    for (int l = 1; l < ALPHA_LEVELS; l++)
+    {
+        if (!counts[l]) continue;
+        QColor shade = color;
+        shade.setAlphaF(color.alphaF() * l / (ALPHA_LEVELS - 1));
+        pen.setColor(shade);
+        qp.setPen(pen);
+        qp.drawPoints(sorted + starts[l], counts[l]);
+    }
+    qp.restore();
+}
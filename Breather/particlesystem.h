@@ -0,0 +1,42 @@
+#ifndef PARTICLESYSTEM_H
+#define PARTICLESYSTEM_H
+
+#include <QVector>
+#include <QRect>
+#include <QColor>
+
+class QPainter;
+
+/*!
+ * \brief The ParticleSystem class Particles flowing into the shape while inhaling and out of it while exhaling
+ *  Particles do not carry any simulation state. Each one has a fixed direction, phase and speed,
+ *  and its place on the way is worked out from the mode's completed ratio, so every window, the
+ *  cycle cache and an export all see the same particles at the same session time. As the ratio
+ *  rises during Inhale they move in, as it falls during Exhale they move out.
+ *  Storage is one array per attribute, so the update is a handful of flat float loops the compiler
+ *  vectorizes. Per frame output goes to buffers owned by the painting thread, sized once, so the
+ *  system itself is read-only after construction and can be shared between threads.
+ *  Points are drawn in batches, one drawPoints call per alpha level.
+ */
+class ParticleSystem
+{
+public:
+    static const int ALPHA_LEVELS = 8;
+    static const int MAX_COUNT = 100000;
+
+    ParticleSystem(int count, quint32 seed = 1);
+
+    int count() const;
+    void paint(QPainter &qp, const QRect &shape, float ratio, const QColor &color) const;
+
+    static QRect bounds(const QRect &shape);
+
+private:
+    QVector<float> cosA;   ///< Direction of travel
+    QVector<float> sinA;
+    QVector<float> offset; ///< Phase along the way, 0..1
+    QVector<float> speed;  ///< Trips per full ratio sweep
+    QVector<float> reach;  ///< Distance covered as a share of the travel range
+};
+
+#endif // PARTICLESYSTEM_H
@@ -0,0 +1,68 @@
+#include "phaselabel.h"
+#include <QPainter>
+#include <QStaticText>
+#include <QHash>
+
+namespace
+{
+
+/// Laid out labels of this thread; key: font pixel size and text
+thread_local QHash<QPair<int,QString>,QStaticText> layouts;
+const int MAX_LAYOUTS = 64; ///< Beyond this the layouts are dropped and built again
+
+}
+
+/*!
+ * \brief PhaseLabel::text String shown for a phase
+ * \param label Text set for the mode, may be empty
+ * \param countdown Append the whole seconds left in the phase
+ * \param remainingMS
+ * \return Empty when there is nothing to show
+ */
+QString PhaseLabel::text(const QString &label, bool countdown, quint32 remainingMS)
+{
+    if (!countdown) return label;
+    QString seconds = QString::number((remainingMS + 999) / 1000);
+    return label.isEmpty() ? seconds : label + ' ' + seconds;
+}
+
+/*!
+ * \brief PhaseLabel::paint Draw a label centred in the shape, black or white, whichever reads better on its color
+ * \param qp
+ * \param xywh Rect of the shape
+ * \param text
+ * \param background Shape color, its alpha is used for the text as well
+ */
+void PhaseLabel::paint(QPainter &qp, const QRect &xywh, const QString &text, const QColor &background)
+{
+    if (text.isEmpty() || xywh.isEmpty()) return;
+    int px = qBound(MIN_PX, xywh.height() / 5 / STEP_PX * STEP_PX, MAX_PX);
+    QPair<int,QString> key(px, text);
+    QFont font = qp.font();
+    font.setPixelSize(px);
+    auto found = layouts.find(key);
+    if (found == layouts.end())
+    {
+        if (layouts.size() >= MAX_LAYOUTS) layouts.clear();
+        QStaticText layout(text);
+        layout.setTextFormat(Qt::PlainText);
+        layout.setPerformanceHint(QStaticText::AggressiveCaching);
+        layout.prepare(QTransform(), font);
+        found = layouts.insert(key, layout);
+    }
+
+    qp.save();
+    // Same font as prepared with, so drawStaticText keeps the layout
+    qp.setFont(font);
+    QSizeF size = found->size();
+    if (size.width() > xywh.width())
+    {
+        qp.restore();
+        return;
+    }
+    QColor ink = qGray(background.rgb()) > 128 ? Qt::black : Qt::white;
+    ink.setAlpha(background.alpha());
+    qp.setPen(ink);
+    qp.drawStaticText(QPointF(xywh.center().x() + 0.5 - size.width()/2, xywh.center().y() + 0.5 - size.height()/2), *found);
+    qp.restore();
+}
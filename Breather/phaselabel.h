@@ -0,0 +1,28 @@
+#ifndef PHASELABEL_H
+#define PHASELABEL_H
+
+#include <QString>
+#include <QRect>
+#include <QColor>
+
+class QPainter;
+
+/*!
+ * \brief The PhaseLabel class Text drawn inside the shape, e.g. "Inhale 3"
+ *  Laid out once per string and font size as a QStaticText, so a frame only blits glyphs that are
+ *  already in the paint engine's glyph cache. Font sizes follow the shape in steps of STEP_PX, so
+ *  a growing shape only lays its text out again every few pixels. Layouts are kept per painting
+ *  thread, since QStaticText may not be shared between threads.
+ */
+class PhaseLabel
+{
+public:
+    static const int STEP_PX = 4;
+    static const int MIN_PX = 10;
+    static const int MAX_PX = 96;
+
+    static QString text(const QString &label, bool countdown, quint32 remainingMS);
+    static void paint(QPainter &qp, const QRect &xywh, const QString &text, const QColor &background);
+};
+
+#endif // PHASELABEL_H
@@ -0,0 +1,211 @@
+#include "qualitygovernor.h"
+#include "logging.h"
+#include "defaults.h"
+#include <QTimer>
+#include <QDir>
+#include <QFile>
+#include <QMetaEnum>
+
+#define GOVERNOR_INTERVAL_MS 2000 ///< How often the governor takes a decision
+#define BUDGET_HIGH 0.5           ///< Step down when painting takes more than this share of a frame
+#define BUDGET_LOW 0.2            ///< Step up when painting takes less than this share of a full fps frame
+#define STEP_UP_AFTER 3           ///< Consecutive calm evaluations needed before stepping up
+
+/*!
+ * \brief The QualityGovernorData struct
+ */
+struct QualityGovernorData
+{
+    QTimer evaluator;          ///< Fires the periodic evaluation
+    quint8 fullFps;            ///< Fps when running at full quality
+    quint8 level = QualityGovernor::Full; ///< Current quality level
+    double paintCostMS = 0;    ///< Exponentially weighted average paint time
+    quint32 samples = 0;       ///< Paints recorded since the last evaluation
+    quint8 calmEvaluations = 0;///< Evaluations in a row with enough headroom
+    bool powerKnown = false;   ///< Whether /sys/class/power_supply gave a usable answer
+    bool onBattery = false;    ///< Running from battery
+};
+
+/*!
+ * \brief QualityGovernor::QualityGovernor Constructor
+ * \param fullFps Fps used at full quality
+ * \param parent
+ */
+QualityGovernor::QualityGovernor(quint8 fullFps, QObject *parent)
+    : QObject(parent)
+{
+    d = new QualityGovernorData;
+    d->fullFps = fullFps;
+    d->evaluator.setInterval(GOVERNOR_INTERVAL_MS);
+    d->evaluator.setTimerType(Qt::VeryCoarseTimer);
+    connect(&d->evaluator, SIGNAL(timeout()), this, SLOT(evaluate()));
+    readPowerState();
+}
+
+/*!
+ * \brief QualityGovernor::~QualityGovernor Destructor
+ */
+QualityGovernor::~QualityGovernor()
+{
+    delete d;
+}
+
+/*!
+ * \brief QualityGovernor::recordPaint Feed the cost of one paint into the running average
+ * \param paintTimeNS
+ */
+void QualityGovernor::recordPaint(qint64 paintTimeNS)
+{
+    double ms = paintTimeNS * 1e-6;
+    d->paintCostMS = d->paintCostMS > 0 ? 0.9*d->paintCostMS + 0.1*ms : ms;
+    d->samples++;
+}
+
+/*!
+ * \brief QualityGovernor::setActive Only evaluate while frames are being painted
+ * \param active
+ */
+void QualityGovernor::setActive(bool active)
+{
+    if (active) d->evaluator.start();
+    else d->evaluator.stop();
+    d->samples = 0;
+}
+
+/*!
+ * \brief QualityGovernor::level
+ * \return
+ */
+quint8 QualityGovernor::level() const
+{
+    return d->level;
+}
+
+/*!
+ * \brief QualityGovernor::fps Fps the animation should run at
+ * \return
+ */
+quint8 QualityGovernor::fps() const
+{
+    return d->level >= FpsCapped ? qMax(1, d->fullFps/2) : d->fullFps;
+}
+
+/*!
+ * \brief QualityGovernor::antialiasing
+ * \return
+ */
+bool QualityGovernor::antialiasing() const
+{
+    return d->level < NoAntialiasing;
+}
+
+/*!
+ * \brief QualityGovernor::simpleOutlines
+ * \return
+ */
+bool QualityGovernor::simpleOutlines() const
+{
+    return d->level >= SimpleOutlines;
+}
+
+/*!
+ * \brief QualityGovernor::effects
+ * \return
+ */
+bool QualityGovernor::effects() const
+{
+    return d->level < NoEffects;
+}
+
+/*!
+ * \brief QualityGovernor::onBattery
+ * \return
+ */
+bool QualityGovernor::onBattery() const
+{
+    return d->onBattery;
+}
+
+/*!
+ * \brief QualityGovernor::readPowerState Read the power state from /sys/class/power_supply
+ *  When nothing readable is found (desktops, other platforms) mains power is assumed.
+ */
+void QualityGovernor::readPowerState()
+{
+    bool mainsOnline = false, discharging = false, known = false;
+    QDir supplies("/sys/class/power_supply");
+    for (const QString &name : supplies.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+        QFile type(supplies.filePath(name + "/type"));
+        if (!type.open(QIODevice::ReadOnly)) continue;
+        QByteArray kind = type.readAll().trimmed();
+        if (kind == "Mains")
+        {
+            QFile online(supplies.filePath(name + "/online"));
+            if (!online.open(QIODevice::ReadOnly)) continue;
+            known = true;
+            mainsOnline |= online.readAll().trimmed() == "1";
+        }
+        else if (kind == "Battery")
+        {
+            QFile status(supplies.filePath(name + "/status"));
+            if (!status.open(QIODevice::ReadOnly)) continue;
+            known = true;
+            discharging |= status.readAll().trimmed() == "Discharging";
+        }
+    }
+    bool battery = known && discharging && !mainsOnline;
+    if (known != d->powerKnown || battery != d->onBattery)
+        qCInfo(lcQuality) << "Power state:" << (!known ? "unknown, assuming mains" : battery ? "battery" : "mains");
+    d->powerKnown = known;
+    d->onBattery = battery;
+}
+
+/*!
+ * \brief QualityGovernor::evaluate Compare the measured paint cost with the frame budget and pick a level
+ */
+void QualityGovernor::evaluate()
+{
+    readPowerState();
+    if (!d->samples) return;
+    d->samples = 0;
+
+    double budgetMS = (double)SEC_TO_MSEC / fps();
+    double fullBudgetMS = (double)SEC_TO_MSEC / d->fullFps;
+
+    if (d->paintCostMS > BUDGET_HIGH*budgetMS && d->level < NoEffects)
+    {
+        d->calmEvaluations = 0;
+        setLevel(d->level + 1, "paint cost over budget");
+    }
+    else if (d->onBattery && d->level < FpsCapped)
+    {
+        d->calmEvaluations = 0;
+        setLevel(FpsCapped, "running on battery");
+    }
+    else if (d->paintCostMS < BUDGET_LOW*fullBudgetMS && d->level > Full
+             && !(d->onBattery && d->level == FpsCapped))
+    {
+        if (++d->calmEvaluations >= STEP_UP_AFTER)
+        {
+            d->calmEvaluations = 0;
+            setLevel(d->level - 1, "headroom available");
+        }
+    }
+    else d->calmEvaluations = 0;
+}
+
+/*!
+ * \brief QualityGovernor::setLevel Switch to a new level and log the decision
+ * \param level
+ * \param reason
+ */
+void QualityGovernor::setLevel(quint8 level, const char *reason)
+{
+    if (level == d->level) return;
+    QMetaEnum levels = QMetaEnum::fromType<Level>();
+    qCInfo(lcQuality) << "Quality" << levels.valueToKey(d->level) << "->" << levels.valueToKey(level)
+                      << ":" << reason << "- paint" << d->paintCostMS << "ms, battery" << d->onBattery;
+    d->level = level;
+    emit levelChanged(level);
+}
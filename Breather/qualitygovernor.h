@@ -0,0 +1,51 @@
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+#include <QObject>
+
+struct QualityGovernorData;
+
+/*!
+ * \brief The QualityGovernor class Steps rendering quality down and up based on paint cost and power state
+ *  Each level keeps the savings of the levels before it.
+ */
+class QualityGovernor : public QObject
+{
+    Q_OBJECT
+public:
+    enum Level : quint8
+    {
+        Full = 0,       ///< Everything on at the configured fps
+        FpsCapped,      ///< Animation fps halved
+        NoAntialiasing, ///< QPainter::Antialiasing off
+        SimpleOutlines, ///< Focus outlines drawn as thin solid lines
+        NoEffects,      ///< Optional effects disabled
+    };
+    Q_ENUM(Level)
+
+    QualityGovernor(quint8 fullFps, QObject *parent = nullptr);
+    ~QualityGovernor();
+
+    void recordPaint(qint64 paintTimeNS);
+    void setActive(bool active);
+
+    quint8 level() const;
+    quint8 fps() const;
+    bool antialiasing() const;
+    bool simpleOutlines() const;
+    bool effects() const;
+    bool onBattery() const;
+
+signals:
+    void levelChanged(quint8 level);
+
+private slots:
+    void evaluate();
+
+private:
+    QualityGovernorData *d;
+    void readPowerState();
+    void setLevel(quint8 level, const char *reason);
+};
+
+#endif // QUALITYGOVERNOR_H
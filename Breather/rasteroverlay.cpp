@@ -0,0 +1,150 @@
+#include "rasteroverlay.h"
+#include "renderer.h"
+#include "metrics.h"
+#include "mainwindow.h"
+#include <QtGui>
+
+/*!
+ * \brief RasterOverlay::RasterOverlay Constructor
+ * \param renderer Renderer shared with the controller
+ * \param frame Frame state shared with the controller
+ * \param controller Object that owns the modes and handles editing input
+ */
+RasterOverlay::RasterOverlay(Renderer *renderer, const FrameState *frame, QObject *controller)
+    : renderer(renderer)
+    , frame(frame)
+    , controller(controller)
+{
+    QSurfaceFormat format;
+    format.setAlphaBufferSize(8);
+    setFormat(format);
+    setFlags(Qt::CustomizeWindowHint | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::BypassWindowManagerHint);
+    setTitle("Breathe");
+    connect(this, SIGNAL(visibleChanged(bool)), this, SIGNAL(visibilityChanged()));
+    connect(this, SIGNAL(windowStateChanged(Qt::WindowState)), this, SIGNAL(visibilityChanged()));
+    connect(this, SIGNAL(xChanged(int)), this, SIGNAL(visibilityChanged()));
+    connect(this, SIGNAL(yChanged(int)), this, SIGNAL(visibilityChanged()));
+}
+
+/*!
+ * \brief RasterOverlay::isSeen Whether any part of the window can currently be seen by the user
+ * \return
+ */
+bool RasterOverlay::isSeen() const
+{
+    if (!isVisible() || !isExposed() || windowState() == Qt::WindowMinimized) return false;
+    Qt::ApplicationState state = QGuiApplication::applicationState();
+    if (state == Qt::ApplicationSuspended || state == Qt::ApplicationHidden) return false;
+    for (QScreen *screen : QGuiApplication::screens())
+        if (screen->geometry().intersects(frameGeometry())) return true;
+    return false;
+}
+
+/*!
+ * \brief RasterOverlay::setClickThrough Make the window transparent for input, or only its shapes take input
+ * \param clickThrough
+ */
+void RasterOverlay::setClickThrough(quint8 clickThrough)
+{
+    this->clickThrough = clickThrough;
+    bool full = clickThrough == MainWindow::FullClickThrough;
+    if (bool(flags() & Qt::WindowTransparentForInput) != full)
+        setFlag(Qt::WindowTransparentForInput, full);
+    if (clickThrough != MainWindow::ShapeClickThrough)
+        setMask(QRegion());
+    inputShape.invalidate();
+    updateInputShape();
+}
+
+/*!
+ * \brief RasterOverlay::updateInputShape Move the input mask along with the shapes, only when it changed by a grid step
+ */
+void RasterOverlay::updateInputShape()
+{
+    QPoint size(width(), height());
+    if (clickThrough == MainWindow::ShapeClickThrough && inputShape.update(size, *frame, renderer->effectsRect(size, *frame)))
+        setMask(inputShape.region());
+}
+
+/*!
+ * \brief RasterOverlay::paintEvent Clear the dirty area and draw the shared frame
+ * \param event
+ */
+void RasterOverlay::paintEvent(QPaintEvent *event)
+{
+    QElapsedTimer paintTime;
+    paintTime.start();
+    QPainter qp(this);
+    qp.setCompositionMode(QPainter::CompositionMode_Source);
+    qp.fillRect(event->rect(), Qt::transparent);
+    qp.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    renderer->paint(qp, QPoint(width(), height()), *frame);
+    qp.end();
+    Metrics::frameRendered(paintTime.nsecsElapsed());
+}
+
+/*!
+ * \brief RasterOverlay::exposeEvent
+ * \param event
+ */
+void RasterOverlay::exposeEvent(QExposeEvent *event)
+{
+    inherited::exposeEvent(event);
+    emit visibilityChanged();
+}
+
+/*!
+ * \brief RasterOverlay::mousePressEvent Start dragging; right click asks for the settings dialog while the title bar is shown
+ * \param event
+ */
+void RasterOverlay::mousePressEvent(QMouseEvent *event)
+{
+    oldPos = event->globalPos();
+    if (event->button() == Qt::RightButton && showTitleBar)
+        emit settingsRequested();
+}
+
+/*!
+ * \brief RasterOverlay::mouseDoubleClickEvent Toggle the showing of title bar
+ * \param event
+ */
+void RasterOverlay::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton) return;
+    showTitleBar = !showTitleBar;
+    if (showTitleBar)
+        setFlags(Qt::CustomizeWindowHint | Qt::WindowTitleHint | Qt::WindowCloseButtonHint | Qt::WindowStaysOnTopHint);
+    else
+        setFlags(Qt::CustomizeWindowHint | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint | Qt::BypassWindowManagerHint);
+    show();
+    if (showTitleBar) requestActivate();
+}
+
+/*!
+ * \brief RasterOverlay::mouseMoveEvent Drag the overlay around
+ * \param event
+ */
+void RasterOverlay::mouseMoveEvent(QMouseEvent *event)
+{
+    QPoint delta = QPoint(event->globalPos() - oldPos);
+    setPosition(position() + delta);
+    oldPos = event->globalPos();
+}
+
+/*!
+ * \brief RasterOverlay::wheelEvent Shape scaling is edited by the controller
+ * \param event
+ */
+void RasterOverlay::wheelEvent(QWheelEvent *event)
+{
+    QCoreApplication::sendEvent(controller, event);
+}
+
+/*!
+ * \brief RasterOverlay::keyPressEvent Focus and position keys are handled by the controller
+ * \param event
+ */
+void RasterOverlay::keyPressEvent(QKeyEvent *event)
+{
+    QCoreApplication::sendEvent(controller, event);
+}
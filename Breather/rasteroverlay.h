@@ -0,0 +1,50 @@
+#ifndef RASTEROVERLAY_H
+#define RASTEROVERLAY_H
+
+#include <QRasterWindow>
+#include "inputshape.h"
+
+class Renderer;
+struct FrameState;
+
+/*!
+ * \brief The RasterOverlay class Lightweight overlay backend on a bare QRasterWindow
+ *  No QMainWindow, menubar, statusbar, central widget or widget backing store: the window
+ *  paints the shapes and nothing else. Selected with --backend raster; MainWindow then only
+ *  acts as the controller and is never shown.
+ */
+class RasterOverlay : public QRasterWindow
+{
+    Q_OBJECT
+public:
+    RasterOverlay(Renderer *renderer, const FrameState *frame, QObject *controller);
+
+    bool isSeen() const;
+    void setClickThrough(quint8 clickThrough);
+    void updateInputShape();
+
+signals:
+    void visibilityChanged();
+    void settingsRequested();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void exposeEvent(QExposeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+
+private:
+    typedef QRasterWindow inherited;
+    Renderer *renderer;       ///< Shared renderer
+    const FrameState *frame;  ///< Shared frame state of the current tick
+    QObject *controller;      ///< Main window receiving keyboard and wheel input
+    QPoint oldPos;            ///< Keeps the position while dragging
+    bool showTitleBar = false;///< To show the title bar : toggled by double click
+    quint8 clickThrough = 0;  ///< Which part of the window lets clicks through, see MainWindow::ClickThrough
+    InputShape inputShape;    ///< Cached input region while only the shapes take input
+};
+
+#endif // RASTEROVERLAY_H
@@ -0,0 +1,239 @@
+#include "reminderscheduler.h"
+#include "logging.h"
+#include "defaults.h"
+#include <QApplication>
+#include <QSettings>
+#include <QTimer>
+#include <QDir>
+#include <climits>
+
+/*!
+ * \brief The ReminderSchedulerData struct
+ */
+struct ReminderSchedulerData
+{
+    QTimer deadline;                ///< The single timer, armed for the next start or end
+    bool enabled = false;           ///< Whether guidance is scheduled at all
+    quint32 sessionMS = 2*60*SEC_TO_MSEC;   ///< Length of a guidance session
+    quint32 intervalMS = 20*60*SEC_TO_MSEC; ///< Time from the start of one session to the next
+    QTime workStart = QTime(0,0);   ///< Sessions only start after this time of day
+    QTime workEnd = QTime(0,0);     ///< ... and before this one; equal to workStart means all day
+    QList<QPair<QTime,QTime>> quiet;///< Ranges of the day without any session
+    bool inSession = false;         ///< Whether a session is running now
+    QDateTime lastStart;            ///< Start of the last session
+    QDateTime next;                 ///< Time the armed deadline stands for
+};
+
+/*!
+ * \brief inRange Whether a time of day lies in [from, to), ranges may wrap around midnight
+ */
+static bool inRange(const QTime &t, const QTime &from, const QTime &to)
+{
+    if (from <= to) return t >= from && t < to;
+    return t >= from || t < to;
+}
+
+/*!
+ * \brief nextAt First time after from at which the clock shows the given time of day
+ */
+static QDateTime nextAt(const QDateTime &from, const QTime &t)
+{
+    QDateTime at(from.date(), t);
+    return at <= from ? at.addDays(1) : at;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+static const Qt::SplitBehavior SKIP_EMPTY = Qt::SkipEmptyParts;
+#else
+static const QString::SplitBehavior SKIP_EMPTY = QString::SkipEmptyParts;
+#endif
+
+/*!
+ * \brief ReminderScheduler::ReminderScheduler Constructor
+ * \param parent
+ */
+ReminderScheduler::ReminderScheduler(QObject *parent)
+    : QObject(parent)
+{
+    d = new ReminderSchedulerData;
+    d->deadline.setSingleShot(true);
+    d->deadline.setTimerType(Qt::VeryCoarseTimer);
+    connect(&d->deadline, SIGNAL(timeout()), this, SLOT(onDeadline()));
+    loadSettings();
+}
+
+/*!
+ * \brief ReminderScheduler::~ReminderScheduler Destructor
+ */
+ReminderScheduler::~ReminderScheduler()
+{
+    delete d;
+}
+
+/*!
+ * \brief ReminderScheduler::loadSettings Read the schedule from the config file
+ */
+void ReminderScheduler::loadSettings()
+{
+    QSettings settings(QString(qApp->applicationName()));
+    settings.setPath(QSettings::IniFormat,QSettings::UserScope,QDir::currentPath());
+    settings.beginGroup("Schedule");
+    d->enabled    = settings.value("enabled", false).toBool();
+    d->sessionMS  = settings.value("sessionMinutes", 2).toDouble() * 60 * SEC_TO_MSEC;
+    d->intervalMS = settings.value("intervalMinutes", 20).toDouble() * 60 * SEC_TO_MSEC;
+    d->workStart  = QTime::fromString(settings.value("workStart", "00:00").toString(), "HH:mm");
+    d->workEnd    = QTime::fromString(settings.value("workEnd", "00:00").toString(), "HH:mm");
+    d->quiet.clear();
+    for (const QString &range : settings.value("quiet", "").toString().split(",", SKIP_EMPTY))
+    {
+        QStringList ends = range.trimmed().split("-");
+        if (ends.length() != 2) continue;
+        QTime from = QTime::fromString(ends.at(0).trimmed(), "HH:mm");
+        QTime to   = QTime::fromString(ends.at(1).trimmed(), "HH:mm");
+        if (from.isValid() && to.isValid()) d->quiet.append(qMakePair(from, to));
+    }
+    settings.endGroup();
+
+    if (!d->workStart.isValid()) d->workStart = QTime(0,0);
+    if (!d->workEnd.isValid())   d->workEnd = d->workStart;
+    if (d->sessionMS == 0 || d->intervalMS < d->sessionMS) d->enabled = false;
+    qCInfo(lcMain) << Q_FUNC_INFO << d->enabled << d->sessionMS << d->intervalMS
+                   << d->workStart << d->workEnd << d->quiet.size();
+}
+
+/*!
+ * \brief ReminderScheduler::isEnabled
+ * \return
+ */
+bool ReminderScheduler::isEnabled() const
+{
+    return d->enabled;
+}
+
+/*!
+ * \brief ReminderScheduler::inSession
+ * \return
+ */
+bool ReminderScheduler::inSession() const
+{
+    return d->inSession;
+}
+
+/*!
+ * \brief ReminderScheduler::isAllowed Whether a session may start at the given time
+ * \param at
+ * \return
+ */
+bool ReminderScheduler::isAllowed(const QDateTime &at) const
+{
+    QTime t = at.time();
+    if (d->workStart != d->workEnd && !inRange(t, d->workStart, d->workEnd)) return false;
+    for (const QPair<QTime,QTime> &range : d->quiet)
+        if (inRange(t, range.first, range.second)) return false;
+    return true;
+}
+
+/*!
+ * \brief ReminderScheduler::nextAllowed Earliest time at or after from at which a session may start
+ *  Jumps straight to the end of whichever window forbids the candidate instead of stepping through time.
+ * \param from
+ * \return
+ */
+QDateTime ReminderScheduler::nextAllowed(const QDateTime &from) const
+{
+    QDateTime candidate = from;
+    // Every jump lands on the boundary of a window, so a handful of iterations is always enough
+    for (int i = 0; i < 2*(d->quiet.size() + 2); i++)
+    {
+        if (isAllowed(candidate)) return candidate;
+        QTime t = candidate.time();
+        QTime target;
+        if (d->workStart != d->workEnd && !inRange(t, d->workStart, d->workEnd))
+            target = d->workStart;
+        else
+            for (const QPair<QTime,QTime> &range : d->quiet)
+                if (inRange(t, range.first, range.second)) { target = range.second; break; }
+        QDateTime jump(candidate.date(), target);
+        if (jump <= candidate) jump = jump.addDays(1);
+        candidate = jump;
+    }
+    return QDateTime(); // everything is forbidden
+}
+
+/*!
+ * \brief ReminderScheduler::sessionEnd When a session starting at the given time ends
+ *  A session never runs past the end of the working hours or into a quiet window.
+ * \param start
+ * \return
+ */
+QDateTime ReminderScheduler::sessionEnd(const QDateTime &start) const
+{
+    QDateTime end = start.addMSecs(d->sessionMS);
+    if (d->workStart != d->workEnd) end = qMin(end, nextAt(start, d->workEnd));
+    for (const QPair<QTime,QTime> &range : d->quiet)
+        end = qMin(end, nextAt(start, range.first));
+    return end;
+}
+
+/*!
+ * \brief ReminderScheduler::start Start waiting for the first session
+ */
+void ReminderScheduler::start()
+{
+    if (!d->enabled) return;
+    d->inSession = false;
+    d->lastStart = QDateTime();
+    arm(nextAllowed(QDateTime::currentDateTime()));
+}
+
+/*!
+ * \brief ReminderScheduler::arm Point the single timer at the next deadline
+ * \param deadline
+ */
+void ReminderScheduler::arm(const QDateTime &deadline)
+{
+    d->next = deadline;
+    if (!deadline.isValid())
+    {
+        qCWarning(lcMain) << Q_FUNC_INFO << "Schedule never allows a session";
+        d->deadline.stop();
+        return;
+    }
+    qint64 wait = qBound<qint64>(0, QDateTime::currentDateTime().msecsTo(deadline), INT_MAX);
+    qCInfo(lcMain) << Q_FUNC_INFO << (d->inSession ? "session ends" : "next session") << deadline;
+    d->deadline.start(wait);
+}
+
+/*!
+ * \brief ReminderScheduler::onDeadline Start or end a session, then arm the timer for the following deadline
+ */
+void ReminderScheduler::onDeadline()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    // Coarse timers and clock changes may wake us early
+    if (now < d->next.addMSecs(-SEC_TO_MSEC))
+    {
+        arm(d->next);
+        return;
+    }
+
+    if (d->inSession)
+    {
+        d->inSession = false;
+        emit sessionEnded();
+        arm(nextAllowed(qMax(d->lastStart.addMSecs(d->intervalMS), now)));
+    }
+    else
+    {
+        // A late wakeup, e.g. after suspend, may land in quiet hours or outside working hours
+        if (!isAllowed(now))
+        {
+            arm(nextAllowed(now));
+            return;
+        }
+        d->inSession = true;
+        d->lastStart = now;
+        emit sessionStarted();
+        arm(sessionEnd(now));
+    }
+}
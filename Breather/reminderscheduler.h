@@ -0,0 +1,44 @@
+#ifndef REMINDERSCHEDULER_H
+#define REMINDERSCHEDULER_H
+
+#include <QObject>
+#include <QDateTime>
+
+struct ReminderSchedulerData;
+
+/*!
+ * \brief The ReminderScheduler class Shows guidance periodically, e.g. 2 minutes every 20 minutes
+ *  Only one timer is ever armed, for the earliest upcoming start or end, so nothing runs between sessions.
+ *  A session ends early at the end of the working hours or the start of a quiet window.
+ *  Configured in the "Schedule" group of the settings file:
+ *  enabled, sessionMinutes, intervalMinutes, workStart, workEnd (HH:mm) and
+ *  quiet (comma separated HH:mm-HH:mm ranges).
+ */
+class ReminderScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    ReminderScheduler(QObject *parent = nullptr);
+    ~ReminderScheduler();
+
+    void loadSettings();
+    bool isEnabled() const;
+    bool inSession() const;
+    void start();
+    bool isAllowed(const QDateTime &at) const;
+    QDateTime nextAllowed(const QDateTime &from) const;
+    QDateTime sessionEnd(const QDateTime &start) const;
+
+signals:
+    void sessionStarted();
+    void sessionEnded();
+
+private slots:
+    void onDeadline();
+
+private:
+    ReminderSchedulerData *d;
+    void arm(const QDateTime &deadline);
+};
+
+#endif // REMINDERSCHEDULER_H
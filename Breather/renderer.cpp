@@ -0,0 +1,534 @@
+#include "renderer.h"
+#include "mode.h"
+#include "sessionclock.h"
+#include "mainwindow.h"
+#include "cyclecache.h"
+#include "shaperegistry.h"
+#include "shapemorph.h"
+#include "colorramp.h"
+#include "glowcache.h"
+#include "particlesystem.h"
+#include "phaselabel.h"
+#include "breathsensor.h"
+#include <QPainter>
+#include <QSharedPointer>
+
+/*!
+ * \brief The RendererData struct
+ */
+struct RendererData
+{
+    SessionClock *clock;          ///< Shared session clock every window is driven by
+    quint8 focus = MainWindow::NoFocus; ///< Which pair of modes is being edited
+    bool antialiasing = true;     ///< Quality: antialiased shapes
+    bool simpleOutlines = false;  ///< Quality: thin solid focus outlines
+    bool effects = true;          ///< Quality: optional effects enabled
+    qreal windowOpacity = 1;      ///< Window opacity folded into the shape colors, 1 when the window itself is faded
+    const CycleCache *cache = nullptr; ///< Pre-rendered cycle played back instead of rasterizing, if any
+    quint32 morphMS = 0;          ///< Time the active shape takes to morph out of the previous one, 0 to switch at once
+    quint8 glowRadius = 0;        ///< Soft glow around the active shape while effects are on, 0 for none
+    QSharedPointer<const ParticleSystem> particles; ///< Breath flow particles while effects are on, read-only so renderers share it
+    const BreathSensor *sensor = nullptr; ///< Measured breath drawn beside the shape, if any
+};
+
+/*!
+ * \brief faded Scale a color's alpha by a window opacity
+ */
+static QColor faded(QColor color, qreal opacity)
+{
+    color.setAlphaF(color.alphaF() * opacity);
+    return color;
+}
+
+/*!
+ * \brief measuredTrack Rect of the measured breath bar beside a shape, on its right unless that leaves the window
+ */
+static QRect measuredTrack(const QPoint &size, const QRect &xywh)
+{
+    int width = qMax(4, xywh.width() / 20), gap = width;
+    int x = xywh.right() + gap;
+    if (x + width > size.x()) x = xywh.left() - gap - width;
+    return QRect(x, xywh.top(), width, xywh.height());
+}
+
+/*!
+ * \brief Renderer::Renderer Constructor
+ * \param clock
+ */
+Renderer::Renderer(SessionClock *clock)
+{
+    d = new RendererData;
+    d->clock = clock;
+}
+
+/*!
+ * \brief Renderer::~Renderer Destructor
+ */
+Renderer::~Renderer()
+{
+    delete d;
+}
+
+/*!
+ * \brief Renderer::frame Work out what is shown at the given session time
+ * \param sessionMS
+ * \return
+ */
+FrameState Renderer::frame(qint64 sessionMS) const
+{
+    FrameState state;
+    state.currMode = d->clock->locate(sessionMS, state.elapsedMS, &state.lastMode, &state.remainingMS);
+    return state;
+}
+
+/*!
+ * \brief Renderer::effectsRect Rect of what a frame draws outside the two shapes' own rects
+ *  Glow, particles, the measured bar and a morph between the shapes. A window mask has to
+ *  cover this too, or it cuts them off.
+ * \param size Size of the window the frame is drawn in
+ * \param state
+ * \return Empty when nothing is drawn outside the shapes
+ */
+QRect Renderer::effectsRect(const QPoint &size, const FrameState &state) const
+{
+    if (!state.currMode) return QRect();
+    QRect currRect = state.currMode->getShapeCoord(state.elapsedMS, size);
+    QRect rect;
+    if (d->effects && d->glowRadius)
+        rect |= GlowCache::bounds(currRect, d->glowRadius);
+    quint8 mode = state.currMode->getMode();
+    if (d->effects && d->particles && (mode == Modes::Inhale || mode == Modes::Exhale))
+        rect |= ParticleSystem::bounds(currRect);
+    if (d->sensor && d->sensor->hasSignal() && !currRect.isEmpty())
+        rect |= measuredTrack(size, currRect).adjusted(-1, -1, 1, 1);
+    QPolygonF morph;
+    QColor color;
+    if (morphCurrent(size, state, morph, color))
+        rect |= morph.boundingRect().toAlignedRect();
+    return rect;
+}
+
+/*!
+ * \brief Renderer::setFocus
+ * \param focus
+ */
+void Renderer::setFocus(quint8 focus)
+{
+    d->focus = focus;
+}
+
+/*!
+ * \brief Renderer::getFocus
+ * \return
+ */
+quint8 Renderer::getFocus() const
+{
+    return d->focus;
+}
+
+/*!
+ * \brief Renderer::setQuality Apply the current quality governor level
+ * \param antialiasing
+ * \param simpleOutlines
+ * \param effects
+ */
+void Renderer::setQuality(bool antialiasing, bool simpleOutlines, bool effects)
+{
+    d->antialiasing = antialiasing;
+    d->simpleOutlines = simpleOutlines;
+    d->effects = effects;
+}
+
+/*!
+ * \brief Renderer::setWindowOpacity Fold the window opacity into the shape colors instead of fading the whole window
+ *  Pass 1 when the window is faded with QWidget::setWindowOpacity.
+ * \param opacity
+ */
+void Renderer::setWindowOpacity(qreal opacity)
+{
+    d->windowOpacity = opacity;
+}
+
+/*!
+ * \brief Renderer::setCycleCache Play frames back from a pre-rendered cycle whenever it matches what is drawn
+ * \param cache nullptr to always rasterize
+ */
+void Renderer::setCycleCache(const CycleCache *cache)
+{
+    d->cache = cache;
+}
+
+/*!
+ * \brief Renderer::setMorphMS Morph each shape out of the previous one at the start of its phase
+ * \param morphMS Length of the morph, 0 switches shapes at the phase boundary
+ */
+void Renderer::setMorphMS(quint32 morphMS)
+{
+    d->morphMS = morphMS;
+}
+
+/*!
+ * \brief Renderer::setGlow Soft glow around the active shape, drawn while the quality governor allows effects
+ * \param radius Blur radius in pixels, 0 for no glow
+ */
+void Renderer::setGlow(quint8 radius)
+{
+    d->glowRadius = radius;
+}
+
+/*!
+ * \brief Renderer::setParticles Particles flowing into the shape while inhaling and out of it while exhaling
+ *  Drawn while the quality governor allows effects.
+ * \param count 0 for none
+ */
+void Renderer::setParticles(int count)
+{
+    if (count > 0) d->particles.reset(new ParticleSystem(count));
+    else d->particles.reset();
+}
+
+/*!
+ * \brief Renderer::paintParticles Draw the breath flow particles of the active mode, before its shape
+ * \param qp
+ * \param xywh
+ * \param state
+ * \param color
+ */
+void Renderer::paintParticles(QPainter &qp, const QRect &xywh, const FrameState &state, const QColor &color) const
+{
+    if (!d->effects || !d->particles) return;
+    quint8 mode = state.currMode->getMode();
+    if (mode != Modes::Inhale && mode != Modes::Exhale) return;
+    d->particles->paint(qp, xywh, state.currMode->getRatioCompleted(state.elapsedMS), color);
+}
+
+/*!
+ * \brief Renderer::setBreathSensor Show the breath measured by a sensor beside the target shape
+ *  The sensor is live, so the cycle cache is not used while one is set.
+ * \param sensor nullptr for none
+ */
+void Renderer::setBreathSensor(const BreathSensor *sensor)
+{
+    d->sensor = sensor;
+}
+
+/*!
+ * \brief Renderer::paintMeasured Draw the measured breath level as a bar beside the active shape
+ *  The level is read when the frame is painted, so it is at most one frame old.
+ * \param qp
+ * \param size
+ * \param xywh
+ * \param color
+ */
+void Renderer::paintMeasured(QPainter &qp, const QPoint &size, const QRect &xywh, const QColor &color) const
+{
+    if (!d->sensor || !d->sensor->hasSignal() || xywh.isEmpty()) return;
+    QRect track = measuredTrack(size, xywh);
+    int filled = qRound(track.height() * d->sensor->level());
+    qp.save();
+    qp.setPen(QPen(color, 1));
+    qp.setBrush(Qt::NoBrush);
+    qp.drawRect(track);
+    qp.setPen(Qt::NoPen);
+    qp.setBrush(color);
+    qp.drawRect(QRect(track.left(), track.bottom() - filled + 1, track.width(), filled));
+    qp.restore();
+}
+
+/*!
+ * \brief Renderer::paintLabel Draw the label and countdown of the active mode inside its shape
+ * \param qp
+ * \param xywh
+ * \param state
+ * \param color Shape color the text has to read on
+ */
+void Renderer::paintLabel(QPainter &qp, const QRect &xywh, const FrameState &state, const QColor &color) const
+{
+    Mode *mode = state.currMode;
+    QString text = PhaseLabel::text(mode->getLabel(), mode->getCountdown(), state.remainingMS);
+    PhaseLabel::paint(qp, xywh, text, color);
+}
+
+/*!
+ * \brief Renderer::paintGlow Draw the glow of the active shape, before the shape itself
+ * \param qp
+ * \param xywh
+ * \param shape
+ * \param color
+ */
+void Renderer::paintGlow(QPainter &qp, const QRect &xywh, quint8 shape, const QColor &color) const
+{
+    if (d->effects && d->glowRadius)
+        GlowCache::draw(qp, xywh, shape, d->glowRadius, color);
+}
+
+/*!
+ * \brief Renderer::morphCurrent Outline and color of the active shape while it morphs out of the previous one
+ *  Position, size, outline and color all blend from the previous mode's end state, eased in and out.
+ *  Artwork shapes are drawn from images and switch at once.
+ * \param size
+ * \param state
+ * \param outline Set while morphing
+ * \param color Set while morphing
+ * \return False when not morphing, the shape is then drawn as usual
+ */
+bool Renderer::morphCurrent(const QPoint &size, const FrameState &state, QPolygonF &outline, QColor &color) const
+{
+    if (!d->morphMS || !state.lastMode || state.elapsedMS >= d->morphMS) return false;
+    quint8 from = state.lastMode->getShape(), to = state.currMode->getShape();
+    if (ShapeRegistry::isArtwork(from) || ShapeRegistry::isArtwork(to)) return false;
+
+    float t = float(state.elapsedMS) / d->morphMS;
+    t = t*t*(3 - 2*t);
+    ShapeMorph::interpolate(ShapeMorph::outline(from), state.lastMode->getEndShapeCoord(size),
+                            ShapeMorph::outline(to), state.currMode->getShapeCoord(state.elapsedMS, size), t, outline);
+    color = ColorRamp::mix(state.lastMode->getEndColor(), state.currMode->getColorAt(state.elapsedMS), t);
+    return true;
+}
+
+/*!
+ * \brief Renderer::copySettings Draw like another renderer: same focus, quality and opacity, but keep own clock and cache
+ * \param other
+ */
+void Renderer::copySettings(const Renderer &other)
+{
+    d->focus = other.d->focus;
+    d->antialiasing = other.d->antialiasing;
+    d->simpleOutlines = other.d->simpleOutlines;
+    d->effects = other.d->effects;
+    d->windowOpacity = other.d->windowOpacity;
+    d->morphMS = other.d->morphMS;
+    d->glowRadius = other.d->glowRadius;
+    d->particles = other.d->particles;
+}
+
+/*!
+ * \brief Renderer::isModeInFocus Get the combo mode in focus since we are sharing shapes for two modes - ex. Inhale or Exhale mode will return Focus::InhaleExhale
+ * \param mode
+ * \param focus
+ * \return
+ */
+bool Renderer::isModeInFocus(quint8 mode, quint8 focus)
+{
+    if ( ((mode == Modes::Inhale || mode == Modes::Exhale ) && focus == MainWindow::InhaleExhale)
+      || ((mode == Modes::HoldOut || mode == Modes::HoldIn) && focus == MainWindow::HoldInOut) )
+        return true;
+    return false;
+}
+
+/*!
+ * \brief Renderer::focusPen Outline drawn around the shapes being edited
+ * \return
+ */
+QPen Renderer::focusPen() const
+{
+    if (d->simpleOutlines)
+        return QPen(Qt::gray, 1, Qt::SolidLine);
+    return QPen(Qt::gray, 3, Qt::DashDotLine);
+}
+
+/*!
+ * \brief Renderer::drawShape Draw shapes based on given input and shape set in current mode
+ * \param qp
+ * \param xywh
+ * \param shape
+ */
+void Renderer::drawShape(QPainter &qp, const QRect &xywh, quint8 shape)
+{
+    switch (shape)
+    {
+        case Shape::Ellipse:
+        {
+            qp.drawEllipse(xywh);
+            break;
+        }
+        case Shape::Rectangle:
+        {
+            qp.drawRect(xywh);
+            break;
+        }
+        case Shape::RoundedRectangle:
+        {
+            qp.drawRoundRect(xywh);
+            break;
+        }
+        default:
+        {
+            ShapeRegistry::draw(qp, xywh, shape);
+            break;
+        }
+    }
+}
+
+/*!
+ * \brief Renderer::shapePath Outline of a shape as a path, matching what drawShape draws
+ * \param xywh
+ * \param shape
+ * \return
+ */
+QPainterPath Renderer::shapePath(const QRect &xywh, quint8 shape)
+{
+    QPainterPath path;
+    switch (shape)
+    {
+        case Shape::Ellipse:          path.addEllipse(xywh); break;
+        case Shape::Rectangle:        path.addRect(xywh); break;
+        case Shape::RoundedRectangle: path.addRoundedRect(xywh, 25, 25, Qt::RelativeSize); break;
+        default:                      path = ShapeRegistry::path(shape, xywh); break;
+    }
+    return path;
+}
+
+/*!
+ * \brief Renderer::paint Draw one frame into a window of the given size
+ * \param qp
+ * \param size Size of the target window, the geometry context of this paint
+ * \param state
+ */
+void Renderer::paint(QPainter &qp, const QPoint &size, const FrameState &state) const
+{
+    if (!state.currMode) return;
+    // Focus outlines are never cached, editing always shows the live shapes; neither is a scheduled
+    // countdown, the cache only knows the mode timings
+    bool cacheable = d->focus == MainWindow::NoFocus && !d->sensor && !(d->clock->schedule() && state.currMode->getCountdown());
+    if (d->cache && cacheable && d->cache->paint(qp, size, state)) return;
+    qp.setRenderHint(QPainter::Antialiasing, d->antialiasing);
+    if (d->windowOpacity < 1)
+    {
+        paintFolded(qp, size, state);
+        return;
+    }
+    QPen pen(Qt::NoPen);
+
+    if (!(!state.lastMode))
+    {
+        if (isModeInFocus(state.lastMode->getMode(), d->focus))
+                pen = focusPen();
+        qp.setPen(pen);
+        qp.setBrush(state.lastMode->getEndColor());
+        drawShape(qp, state.lastMode->getEndShapeCoord(size), state.lastMode->getShape());
+    }
+
+    // If we are editing any mode using numpad or Ctrl+Scroll, this will draw an outline around it to show that this shape is being edited
+    if (isModeInFocus(state.currMode->getMode(), d->focus))
+        pen = focusPen();
+    else pen = QPen(Qt::NoPen);
+    qp.setPen(pen);
+    QPolygonF morph;
+    QColor color = state.currMode->getColorAt(state.elapsedMS);
+    bool morphing = morphCurrent(size, state, morph, color);
+    QRect currRect = state.currMode->getShapeCoord(state.elapsedMS, size);
+    paintParticles(qp, currRect, state, color);
+    paintGlow(qp, currRect, state.currMode->getShape(), color);
+    qp.setBrush(color);
+    if (morphing) qp.drawPolygon(morph);
+    else drawShape(qp, currRect, state.currMode->getShape());
+    paintLabel(qp, currRect, state, color);
+    paintMeasured(qp, size, currRect, color);
+}
+
+/*!
+ * \brief Renderer::paintFolded Per-pixel alpha: draw what the compositor would show for a faded window
+ *  A window faded to opacity o shows o*(curr over last). Folding o into each color alone is exact
+ *  outside the overlap only, so the current shape, or its morph, is drawn once more clipped to the
+ *  last shape with Source composition and the exact composite color. The rasterizer intersects the
+ *  two, no path boolean is built per frame, and the fill's coverage blends antialiased edges exactly.
+ *  The pens are opaque, so Source composition with alpha o gives their exact result as well; where
+ *  the last shape's outline runs under the current shape it gets the current color over it.
+ *  Glow and particles in the overlap are replaced like the shapes, both shapes cover them anyway.
+ * \param qp
+ * \param size
+ * \param state
+ */
+void Renderer::paintFolded(QPainter &qp, const QPoint &size, const FrameState &state) const
+{
+    qreal o = d->windowOpacity;
+    QPen outline = focusPen();
+    outline.setColor(faded(outline.color(), o));
+    QRect currRect = state.currMode->getShapeCoord(state.elapsedMS, size);
+    QColor curr = state.currMode->getColorAt(state.elapsedMS);
+    QPolygonF morph;
+    bool morphing = morphCurrent(size, state, morph, curr);
+
+    qp.setPen(Qt::NoPen);
+    qp.setBrush(faded(curr, o));
+    if (!state.lastMode)
+    {
+        paintParticles(qp, currRect, state, faded(curr, o));
+        paintGlow(qp, currRect, state.currMode->getShape(), faded(curr, o));
+        drawShape(qp, currRect, state.currMode->getShape());
+    }
+    else
+    {
+        QRect lastRect = state.lastMode->getEndShapeCoord(size);
+        QColor last = state.lastMode->getEndColor();
+        qp.setBrush(faded(last, o));
+        drawShape(qp, lastRect, state.lastMode->getShape());
+
+        paintParticles(qp, currRect, state, faded(curr, o));
+        paintGlow(qp, currRect, state.currMode->getShape(), faded(curr, o));
+        qp.setPen(Qt::NoPen);
+        qp.setBrush(faded(curr, o));
+        if (morphing) qp.drawPolygon(morph);
+        else drawShape(qp, currRect, state.currMode->getShape());
+
+        // Exact o*(curr over last), premultiplied then turned back into a QColor
+        qreal a2 = curr.alphaF(), a1 = last.alphaF();
+        qreal alpha = o*(a2 + (1-a2)*a1);
+        QRect overlap = (morphing ? morph.boundingRect().toAlignedRect() : currRect) & lastRect;
+        if (!overlap.isEmpty() && alpha > 0)
+        {
+            QColor exact;
+            exact.setRgbF(o*(a2*curr.redF()   + (1-a2)*a1*last.redF())/alpha,
+                          o*(a2*curr.greenF() + (1-a2)*a1*last.greenF())/alpha,
+                          o*(a2*curr.blueF()  + (1-a2)*a1*last.blueF())/alpha,
+                          alpha);
+            qp.save();
+            qp.setClipRect(overlap.adjusted(-1, -1, 1, 1));
+            qp.setClipPath(shapePath(lastRect, state.lastMode->getShape()), Qt::IntersectClip);
+            qp.setCompositionMode(QPainter::CompositionMode_Source);
+            qp.setBrush(exact);
+            if (morphing) qp.drawPolygon(morph);
+            else drawShape(qp, currRect, state.currMode->getShape());
+            qp.restore();
+        }
+
+        // The last shape's outline after the fix-up, so the overlap fill cannot wipe it
+        if (isModeInFocus(state.lastMode->getMode(), d->focus))
+        {
+            QColor pen = focusPen().color();
+            QColor under;
+            under.setRgbF(a2*curr.redF()   + (1-a2)*pen.redF(),
+                          a2*curr.greenF() + (1-a2)*pen.greenF(),
+                          a2*curr.blueF()  + (1-a2)*pen.blueF(),
+                          o);
+            QPainterPath currPath;
+            if (morphing) currPath.addPolygon(morph);
+            else currPath = shapePath(currRect, state.currMode->getShape());
+            qp.save();
+            qp.setCompositionMode(QPainter::CompositionMode_Source);
+            qp.setBrush(Qt::NoBrush);
+            qp.setPen(outline);
+            drawShape(qp, lastRect, state.lastMode->getShape());
+            QPen covered = outline;
+            covered.setColor(under);
+            qp.setClipPath(currPath);
+            qp.setPen(covered);
+            drawShape(qp, lastRect, state.lastMode->getShape());
+            qp.restore();
+        }
+    }
+
+    paintLabel(qp, currRect, state, faded(curr, o));
+    paintMeasured(qp, size, currRect, faded(curr, o));
+
+    if (isModeInFocus(state.currMode->getMode(), d->focus))
+    {
+        qp.setCompositionMode(QPainter::CompositionMode_Source);
+        qp.setPen(outline);
+        qp.setBrush(Qt::NoBrush);
+        if (morphing) qp.drawPolygon(morph);
+        else drawShape(qp, currRect, state.currMode->getShape());
+        qp.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <QPoint>
+#include <QRect>
+#include <QPen>
+#include <QPainterPath>
+#include <QPolygonF>
+
+class Mode;
+class QPainter;
+class SessionClock;
+class CycleCache;
+class BreathSensor;
+struct RendererData;
+
+/*!
+ * \brief The FrameState struct What is shown at one tick, shared by every overlay window
+ */
+struct FrameState
+{
+    Mode *currMode = nullptr;  ///< Active mode
+    Mode *lastMode = nullptr;  ///< Mode before the active one, drawn at its end size underneath
+    quint32 elapsedMS = 0;     ///< Time spent in the active mode
+    quint32 remainingMS = 0;   ///< Time left in the active phase, differs from the mode's own time under a pacing schedule
+};
+
+/*!
+ * \brief The Renderer class Draws a frame for a window of any size
+ *  The frame state is derived once per tick from the shared session clock, each window then only
+ *  runs the geometry for its own size and draws, so all overlays stay phase-locked.
+ */
+class Renderer
+{
+public:
+    Renderer(SessionClock *clock);
+    ~Renderer();
+
+    FrameState frame(qint64 sessionMS) const;
+    void paint(QPainter &qp, const QPoint &size, const FrameState &state) const;
+    QRect effectsRect(const QPoint &size, const FrameState &state) const;
+
+    void setFocus(quint8 focus);
+    quint8 getFocus() const;
+    void setQuality(bool antialiasing, bool simpleOutlines, bool effects);
+    void setWindowOpacity(qreal opacity);
+    void setCycleCache(const CycleCache *cache);
+    void setMorphMS(quint32 morphMS);
+    void setGlow(quint8 radius);
+    void setParticles(int count);
+    void setBreathSensor(const BreathSensor *sensor);
+    void copySettings(const Renderer &other);
+
+    static bool isModeInFocus(quint8 mode, quint8 focus);
+    static void drawShape(QPainter &qp, const QRect &xywh, quint8 shape);
+    static QPainterPath shapePath(const QRect &xywh, quint8 shape);
+
+private:
+    RendererData *d;
+    QPen focusPen() const;
+    void paintFolded(QPainter &qp, const QPoint &size, const FrameState &state) const;
+    void paintParticles(QPainter &qp, const QRect &xywh, const FrameState &state, const QColor &color) const;
+    void paintMeasured(QPainter &qp, const QPoint &size, const QRect &xywh, const QColor &color) const;
+    void paintLabel(QPainter &qp, const QRect &xywh, const FrameState &state, const QColor &color) const;
+    void paintGlow(QPainter &qp, const QRect &xywh, quint8 shape, const QColor &color) const;
+    bool morphCurrent(const QPoint &size, const FrameState &state, QPolygonF &outline, QColor &color) const;
+    Q_DISABLE_COPY(Renderer)
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,159 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <utility>
+
+/*!
+ * \brief The MpscRingBuffer class Bounded lock-free queue for many producers and a single consumer
+ *  Every slot carries a sequence number (D. Vyukov's bounded queue) so producers only race on
+ *  one compare-and-swap and the consumer never needs one. Capacity must be a power of two.
+ */
+template <typename T, quint32 Capacity>
+class MpscRingBuffer
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscRingBuffer()
+    {
+        for (quint32 i = 0; i < Capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /*!
+     * \brief push Enqueue an item, safe to call from any thread
+     * \param item
+     * \return false when the queue is full; the item is left untouched
+     */
+    bool push(T &&item)
+    {
+        quint64 pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &cells[pos & (Capacity - 1)];
+            quint64 seq = cell->sequence.load(std::memory_order_acquire);
+            qint64 diff = (qint64)seq - (qint64)pos;
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) return false;
+            else pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+        cell->data = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * \brief pop Dequeue an item, must only be called from the consumer thread
+     * \param item
+     * \return false when the queue is empty
+     */
+    bool pop(T &item)
+    {
+        quint64 pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell = &cells[pos & (Capacity - 1)];
+        quint64 seq = cell->sequence.load(std::memory_order_acquire);
+        if ((qint64)seq - (qint64)(pos + 1) < 0) return false;
+        dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        item = std::move(cell->data);
+        cell->data = T();
+        cell->sequence.store(pos + Capacity, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<quint64> sequence;
+        T data;
+    };
+    Cell cells[Capacity];
+    alignas(64) std::atomic<quint64> enqueuePos {0}; ///< Next slot producers claim
+    alignas(64) std::atomic<quint64> dequeuePos {0}; ///< Next slot the consumer reads
+};
+
+/*!
+ * \brief The SpscRingBuffer class Bounded lock-free queue of plain values for one producer and one consumer
+ *  Values are copied in and out in bulk, so an audio callback can take a whole buffer at once.
+ *  Each side owns one index and only reads the other's, nothing ever blocks. Capacity must be a
+ *  power of two.
+ */
+template <typename T, quint32 Capacity>
+class SpscRingBuffer
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    /*!
+     * \brief write Append up to count values, must only be called from the producer thread
+     * \param data
+     * \param count
+     * \return Number of values written, less than count when the queue is full
+     */
+    quint32 write(const T *data, quint32 count)
+    {
+        quint64 head = writePos.load(std::memory_order_relaxed);
+        quint64 tail = readPos.load(std::memory_order_acquire);
+        count = qMin<quint32>(count, Capacity - quint32(head - tail));
+        for (quint32 i = 0; i < count; i++)
+            values[(head + i) & (Capacity - 1)] = data[i];
+        writePos.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /*!
+     * \brief read Take up to count values, must only be called from the consumer thread
+     * \param data
+     * \param count
+     * \return Number of values read, less than count when the queue ran empty
+     */
+    quint32 read(T *data, quint32 count)
+    {
+        quint64 tail = readPos.load(std::memory_order_relaxed);
+        quint64 head = writePos.load(std::memory_order_acquire);
+        count = qMin<quint32>(count, quint32(head - tail));
+        for (quint32 i = 0; i < count; i++)
+            data[i] = values[(tail + i) & (Capacity - 1)];
+        readPos.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    /*!
+     * \brief space Values that can be written right now, exact on the producer side
+     * \return
+     */
+    quint32 space() const
+    {
+        return Capacity - quint32(writePos.load(std::memory_order_relaxed) - readPos.load(std::memory_order_acquire));
+    }
+
+    /*!
+     * \brief available Values that can be read right now, exact on the consumer side
+     * \return
+     */
+    quint32 available() const
+    {
+        return quint32(writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_relaxed));
+    }
+
+    /*!
+     * \brief clear Drop everything queued, only while neither side is running
+     */
+    void clear()
+    {
+        readPos.store(writePos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+private:
+    T values[Capacity];
+    alignas(64) std::atomic<quint64> writePos {0}; ///< Only the producer moves it
+    alignas(64) std::atomic<quint64> readPos {0};  ///< Only the consumer moves it
+};
+
+#endif // RINGBUFFER_H
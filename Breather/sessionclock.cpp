@@ -0,0 +1,232 @@
+#include "sessionclock.h"
+#include "mode.h"
+#include "pacingschedule.h"
+#include <QElapsedTimer>
+
+/*!
+ * \brief The SessionClockData struct
+ */
+struct SessionClockData
+{
+    QElapsedTimer clock;    ///< Monotonic time since the session started
+    Mode *first = nullptr;  ///< Mode the cycle starts with, the rest is reached through Mode::getNext
+    qint64 originMS = 0;    ///< Session time at which the current cycle numbering starts
+    QSharedPointer<const PacingSchedule> schedule; ///< Phase table to follow instead of the mode timings, if any
+};
+
+/*!
+ * \brief SessionClock::SessionClock Constructor
+ */
+SessionClock::SessionClock()
+{
+    d = new SessionClockData;
+}
+
+/*!
+ * \brief SessionClock::~SessionClock Destructor
+ */
+SessionClock::~SessionClock()
+{
+    delete d;
+}
+
+/*!
+ * \brief SessionClock::start (Re)start the session at the beginning of the first mode
+ */
+void SessionClock::start()
+{
+    d->originMS = 0;
+    d->clock.start();
+}
+
+/*!
+ * \brief SessionClock::isRunning
+ * \return
+ */
+bool SessionClock::isRunning() const
+{
+    return d->clock.isValid();
+}
+
+/*!
+ * \brief SessionClock::setFirstMode Set the mode every cycle starts with
+ * \param first
+ */
+void SessionClock::setFirstMode(Mode *first)
+{
+    d->first = first;
+}
+
+/*!
+ * \brief SessionClock::setSchedule Take the phases from a precomputed table, starting at the session start
+ *  While a schedule is set rebase() does nothing, the table stays anchored to the session time.
+ * \param schedule nullptr to go back to the mode timings
+ */
+void SessionClock::setSchedule(QSharedPointer<const PacingSchedule> schedule)
+{
+    d->schedule = schedule;
+    if (schedule) d->originMS = 0;
+}
+
+/*!
+ * \brief SessionClock::schedule
+ * \return
+ */
+QSharedPointer<const PacingSchedule> SessionClock::schedule() const
+{
+    return d->schedule;
+}
+
+/*!
+ * \brief SessionClock::follow Use the schedule of another clock, aligned so both clocks are at the same point of it now
+ *  For private clocks started at a different moment than the session, e.g. the audio clock.
+ * \param other
+ */
+void SessionClock::follow(const SessionClock &other)
+{
+    d->schedule = other.d->schedule;
+    if (d->schedule) d->originMS = elapsedMS() - (other.elapsedMS() - other.d->originMS);
+}
+
+/*!
+ * \brief SessionClock::find Mode of the cycle with the given Modes value
+ * \param mode
+ * \return nullptr when it is not part of the cycle
+ */
+Mode *SessionClock::find(quint8 mode) const
+{
+    Mode *m = d->first;
+    do
+    {
+        if (m->getMode() == mode) return m;
+        m = m->getNext();
+    } while (m && m != d->first);
+    return nullptr;
+}
+
+/*!
+ * \brief SessionClock::elapsedMS Time since the session started
+ * \return
+ */
+qint64 SessionClock::elapsedMS() const
+{
+    return d->clock.isValid() ? d->clock.elapsed() : 0;
+}
+
+/*!
+ * \brief SessionClock::cycleMS Length of one full cycle through all modes
+ *  Under a pacing schedule that is the first cycle of its table, the mode timings are then only
+ *  what the progress is scaled onto.
+ * \return
+ */
+quint32 SessionClock::cycleMS() const
+{
+    if (d->first && d->schedule && d->schedule->phaseCount() > 0) return d->schedule->firstCycleMS();
+    return modesMS();
+}
+
+/*!
+ * \brief SessionClock::modesMS Sum of the mode timings, the cycle the clock runs without a schedule
+ * \return
+ */
+quint32 SessionClock::modesMS() const
+{
+    if (!d->first) return 0;
+    quint32 total = 0;
+    Mode *mode = d->first;
+    do
+    {
+        total += mode->getTimeMS();
+        mode = mode->getNext();
+    } while (mode && mode != d->first);
+    return total;
+}
+
+/*!
+ * \brief SessionClock::locate Find the mode active at the given session time
+ * \param sessionMS
+ * \param elapsedInModeMS Time already spent in the returned mode
+ * \param previous Mode active before the returned one, nullptr during the very first phase
+ * \param remainingMS Time left until the next phase
+ * \return
+ */
+Mode *SessionClock::locate(qint64 sessionMS, quint32 &elapsedInModeMS, Mode **previous, quint32 *remainingMS) const
+{
+    elapsedInModeMS = 0;
+    if (previous) *previous = nullptr;
+    if (remainingMS) *remainingMS = 0;
+    if (d->first && d->schedule)
+    {
+        quint8 id, previousId;
+        quint32 inPhaseMS, phaseMS;
+        if (d->schedule->locate(sessionMS - d->originMS, id, inPhaseMS, phaseMS, &previousId))
+        {
+            Mode *mode = find(id);
+            if (mode)
+            {
+                elapsedInModeMS = quint32(quint64(inPhaseMS) * mode->getTimeMS() / phaseMS);
+                if (previous && previousId != PacingSchedule::NO_MODE) *previous = find(previousId);
+                if (remainingMS) *remainingMS = phaseMS - inPhaseMS;
+                return mode;
+            }
+        }
+    }
+    quint32 cycle = modesMS();
+    if (!d->first || cycle == 0) return d->first;
+
+    qint64 sinceOrigin = qMax<qint64>(0, sessionMS - d->originMS);
+    quint32 inCycle = sinceOrigin % cycle;
+    bool firstCycle = sinceOrigin < cycle;
+
+    Mode *last = nullptr, *mode = d->first;
+    // Zero length modes are skipped, they never become active
+    while (inCycle >= mode->getTimeMS())
+    {
+        inCycle -= mode->getTimeMS();
+        last = mode;
+        mode = mode->getNext();
+    }
+    if (!last && !firstCycle)
+    {
+        last = d->first;
+        while (last->getNext() != d->first) last = last->getNext();
+    }
+    elapsedInModeMS = inCycle;
+    if (previous) *previous = last;
+    if (remainingMS) *remainingMS = mode->getTimeMS() - inCycle;
+    return mode;
+}
+
+/*!
+ * \brief SessionClock::current Mode active right now
+ * \param elapsedInModeMS
+ * \param previous
+ * \param remainingMS
+ * \return
+ */
+Mode *SessionClock::current(quint32 &elapsedInModeMS, Mode **previous, quint32 *remainingMS) const
+{
+    return locate(elapsedMS(), elapsedInModeMS, previous, remainingMS);
+}
+
+/*!
+ * \brief SessionClock::rebase Shift the cycle so that the given mode is active with the given progress now
+ *  Used after the mode timings changed, so the animation carries on instead of jumping to another phase.
+ * \param mode
+ * \param elapsedInModeMS
+ */
+void SessionClock::rebase(Mode *mode, quint32 elapsedInModeMS)
+{
+    if (!d->first || !mode || d->schedule) return;
+    qint64 offset = qMin(elapsedInModeMS, mode->getTimeMS());
+    for (Mode *m = d->first; m != mode; m = m->getNext())
+    {
+        offset += m->getTimeMS();
+        if (m->getNext() == d->first) return; // mode is not part of this cycle
+    }
+    qint64 now = elapsedMS();
+    // Keep the cycle count so the first phase does not lose its previous mode
+    qint64 cycle = modesMS();
+    qint64 completed = (cycle > 0 && now - d->originMS >= cycle) ? cycle : 0;
+    d->originMS = now - offset - completed;
+}
@@ -0,0 +1,44 @@
+#ifndef SESSIONCLOCK_H
+#define SESSIONCLOCK_H
+
+#include <QtGlobal>
+#include <QSharedPointer>
+
+class Mode;
+class PacingSchedule;
+struct SessionClockData;
+
+/*!
+ * \brief The SessionClock class Maps time since the session started onto the breathing cycle
+ *  The phase is always derived from one monotonic clock instead of chaining timers, so it stays
+ *  correct across pauses, hidden windows and late timer callbacks.
+ *  With a PacingSchedule the phases come from its table instead of the mode timings, and the
+ *  progress handed out is scaled onto the mode's own time, so modes can be drawn as usual.
+ */
+class SessionClock
+{
+public:
+    SessionClock();
+    ~SessionClock();
+
+    void start();
+    bool isRunning() const;
+    void setFirstMode(Mode *first);
+    void setSchedule(QSharedPointer<const PacingSchedule> schedule);
+    QSharedPointer<const PacingSchedule> schedule() const;
+    void follow(const SessionClock &other);
+
+    qint64  elapsedMS() const;
+    quint32 cycleMS() const;
+    Mode*   locate(qint64 sessionMS, quint32 &elapsedInModeMS, Mode **previous = nullptr, quint32 *remainingMS = nullptr) const;
+    Mode*   current(quint32 &elapsedInModeMS, Mode **previous = nullptr, quint32 *remainingMS = nullptr) const;
+    void    rebase(Mode *mode, quint32 elapsedInModeMS);
+
+private:
+    Mode *find(quint8 mode) const;
+    quint32 modesMS() const;
+    SessionClockData *d;
+    Q_DISABLE_COPY(SessionClock)
+};
+
+#endif // SESSIONCLOCK_H
@@ -0,0 +1,288 @@
+#include "sessionexporter.h"
+#include "sessionclock.h"
+#include "pacingschedule.h"
+#include "renderer.h"
+#include "logging.h"
+#include <QImage>
+#include <QPainter>
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QElapsedTimer>
+
+/*!
+ * \brief The SessionExporterData struct
+ */
+struct SessionExporterData
+{
+    SessionClock clock;     ///< Private clock, only used to map frame times onto the modes
+    Renderer *renderer;     ///< Private renderer so the on-screen focus and quality never leak into the export
+};
+
+/*!
+ * \brief The ReorderBuffer class Bounded window of encoded frames, written out strictly in frame order
+ *  A worker that is more than one window ahead of the writer waits, so memory use stays bounded.
+ *  The worker holding the oldest missing frame never waits, as long as the window is at least as
+ *  large as the number of workers.
+ */
+class ReorderBuffer
+{
+public:
+    ReorderBuffer(int window) : slots(window), ready(window, false) {}
+
+    /*!
+     * \brief put Hand over an encoded frame, waits while it is too far ahead of the writer
+     */
+    void put(int index, const QByteArray &payload)
+    {
+        QMutexLocker lock(&mutex);
+        while (index >= nextOut + slots.size() && !cancelled)
+            freed.wait(&mutex);
+        if (cancelled) return;
+        slots[index % slots.size()] = payload;
+        ready[index % slots.size()] = true;
+        filled.wakeAll();
+    }
+
+    /*!
+     * \brief take Get the next frame in order, waits until it has been rendered
+     */
+    bool take(QByteArray &payload)
+    {
+        QMutexLocker lock(&mutex);
+        int slot = nextOut % slots.size();
+        while (!ready[slot] && !cancelled)
+            filled.wait(&mutex);
+        if (cancelled) return false;
+        payload.swap(slots[slot]);
+        slots[slot].clear();
+        ready[slot] = false;
+        nextOut++;
+        freed.wakeAll();
+        return true;
+    }
+
+    /*!
+     * \brief cancel Release every waiting thread, e.g. after a write error
+     */
+    void cancel()
+    {
+        QMutexLocker lock(&mutex);
+        cancelled = true;
+        freed.wakeAll();
+        filled.wakeAll();
+    }
+
+    bool isCancelled()
+    {
+        QMutexLocker lock(&mutex);
+        return cancelled;
+    }
+
+private:
+    QMutex mutex;
+    QWaitCondition filled;     ///< A frame was put
+    QWaitCondition freed;      ///< The writer took a frame, the window moved on
+    QVector<QByteArray> slots; ///< Encoded frames, indexed by frame number modulo the window
+    QVector<bool> ready;       ///< Whether a slot holds its frame
+    int nextOut = 0;           ///< Next frame the writer needs
+    bool cancelled = false;
+};
+
+/*!
+ * \brief The ExportWorker class Renders and encodes frames until none are left
+ */
+class ExportWorker : public QRunnable
+{
+public:
+    ExportWorker(const Renderer *renderer, ReorderBuffer *buffer, QAtomicInt *nextFrame,
+                 int frames, const QSize &size, quint8 fps, bool png)
+        : renderer(renderer), buffer(buffer), nextFrame(nextFrame)
+        , frames(frames), size(size), fps(fps), png(png) {}
+
+    void run() override
+    {
+        QImage image(size, QImage::Format_ARGB32_Premultiplied);
+        for (int index = nextFrame->fetchAndAddRelaxed(1); index < frames && !buffer->isCancelled();
+             index = nextFrame->fetchAndAddRelaxed(1))
+        {
+            // Y4M has no alpha channel, so the shapes are composed over black there
+            image.fill(png ? Qt::transparent : Qt::black);
+            QPainter qp(&image);
+            renderer->paint(qp, QPoint(size.width(), size.height()), renderer->frame(qint64(index)*1000/fps));
+            qp.end();
+
+            QByteArray payload;
+            if (png)
+            {
+                QBuffer out(&payload);
+                out.open(QIODevice::WriteOnly);
+                image.save(&out, "PNG");
+            }
+            else
+            {
+                payload = "FRAME\n" + SessionExporter::toYuv420(image);
+            }
+            buffer->put(index, payload);
+        }
+    }
+
+private:
+    const Renderer *renderer;
+    ReorderBuffer *buffer;
+    QAtomicInt *nextFrame;
+    int frames;
+    QSize size;
+    quint8 fps;
+    bool png;
+};
+
+/*!
+ * \brief SessionExporter::SessionExporter Constructor
+ * \param firstMode Mode the cycle starts with, the configured modes are only read while exporting
+ * \param settings Renderer to take quality, opacity and morphing from, never its focus outlines
+ */
+SessionExporter::SessionExporter(Mode *firstMode, const Renderer *settings)
+{
+    d = new SessionExporterData;
+    d->clock.setFirstMode(firstMode);
+    d->renderer = new Renderer(&d->clock);
+    if (settings)
+    {
+        d->renderer->copySettings(*settings);
+        d->renderer->setFocus(0);
+    }
+}
+
+/*!
+ * \brief SessionExporter::~SessionExporter Destructor
+ */
+SessionExporter::~SessionExporter()
+{
+    delete d->renderer;
+    delete d;
+}
+
+/*!
+ * \brief SessionExporter::setSchedule Export the phases of a pacing schedule instead of the plain mode timings
+ * \param schedule
+ */
+void SessionExporter::setSchedule(QSharedPointer<const PacingSchedule> schedule)
+{
+    d->clock.setSchedule(schedule);
+}
+
+/*!
+ * \brief SessionExporter::toYuv420 Convert a frame to planar BT.601 studio range YUV 4:2:0, as Y4M C420jpeg expects
+ * \param image Premultiplied frame with even width and height; over black its color channels are the visible color
+ * \return Y plane followed by the U and V planes
+ */
+QByteArray SessionExporter::toYuv420(const QImage &image)
+{
+    const int w = image.width(), h = image.height();
+    QByteArray yuv(w*h + 2*(w/2)*(h/2), Qt::Uninitialized);
+    uchar *yPlane = reinterpret_cast<uchar*>(yuv.data());
+    uchar *uPlane = yPlane + w*h;
+    uchar *vPlane = uPlane + (w/2)*(h/2);
+    for (int y = 0; y < h; y += 2)
+    {
+        const QRgb *row[2] = { reinterpret_cast<const QRgb*>(image.constScanLine(y)),
+                               reinterpret_cast<const QRgb*>(image.constScanLine(y+1)) };
+        for (int x = 0; x < w; x += 2)
+        {
+            int r = 0, g = 0, b = 0;
+            for (int dy = 0; dy < 2; dy++)
+                for (int dx = 0; dx < 2; dx++)
+                {
+                    QRgb px = row[dy][x+dx];
+                    int pr = qRed(px), pg = qGreen(px), pb = qBlue(px);
+                    yPlane[(y+dy)*w + x+dx] = uchar(((66*pr + 129*pg + 25*pb + 128) >> 8) + 16);
+                    r += pr; g += pg; b += pb;
+                }
+            r = (r+2)/4; g = (g+2)/4; b = (b+2)/4;
+            uPlane[(y/2)*(w/2) + x/2] = uchar(((-38*r - 74*g + 112*b + 128) >> 8) + 128);
+            vPlane[(y/2)*(w/2) + x/2] = uchar(((112*r - 94*g - 18*b + 128) >> 8) + 128);
+        }
+    }
+    return yuv;
+}
+
+/*!
+ * \brief SessionExporter::run Render a session and write it to disk, blocks until done
+ * \param path Output file, .y4m for a raw video stream or .png for a numbered PNG sequence
+ * \param size Frame size, rounded down to even dimensions for Y4M
+ * \param fps
+ * \param durationMS Session length; 0 exports one full breathing cycle
+ * \param threads Number of render threads
+ * \return False if nothing could be exported or writing failed
+ */
+bool SessionExporter::run(const QString &path, const QSize &size, quint8 fps, qint64 durationMS, int threads)
+{
+    bool png = QFileInfo(path).suffix().compare("png", Qt::CaseInsensitive) == 0;
+    QSize frameSize = png ? size : QSize(size.width() & ~1, size.height() & ~1);
+    if (durationMS <= 0) durationMS = d->clock.cycleMS();
+    int frames = int(durationMS*fps/1000);
+    if (frameSize.isEmpty() || fps == 0 || frames <= 0)
+    {
+        qCWarning(lcMain) << Q_FUNC_INFO << "nothing to export" << frameSize << fps << durationMS;
+        return false;
+    }
+    threads = qMax(1, threads);
+
+    QFile video(path);
+    if (!png)
+    {
+        if (!video.open(QIODevice::WriteOnly))
+        {
+            qCWarning(lcMain) << Q_FUNC_INFO << video.errorString();
+            return false;
+        }
+        video.write(QString("YUV4MPEG2 W%1 H%2 F%3:1 Ip A1:1 C420jpeg\n")
+                    .arg(frameSize.width()).arg(frameSize.height()).arg(fps).toLatin1());
+    }
+    QFileInfo info(path);
+    QString pattern = info.dir().filePath(info.completeBaseName() + "_%1.png");
+
+    QElapsedTimer wallTime;
+    wallTime.start();
+    ReorderBuffer buffer(2*threads);
+    QAtomicInt nextFrame(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for (int i = 0; i < threads; i++)
+        pool.start(new ExportWorker(d->renderer, &buffer, &nextFrame, frames, frameSize, fps, png));
+
+    // The calling thread is the only writer, frames arrive here in order
+    bool ok = true;
+    QByteArray payload;
+    for (int index = 0; index < frames && buffer.take(payload); index++)
+    {
+        if (png)
+        {
+            QFile still(pattern.arg(index, 5, 10, QChar('0')));
+            ok = still.open(QIODevice::WriteOnly) && still.write(payload) == payload.size();
+        }
+        else
+        {
+            ok = video.write(payload) == payload.size();
+        }
+        if (!ok)
+        {
+            qCWarning(lcMain) << Q_FUNC_INFO << "write failed at frame" << index;
+            buffer.cancel();
+            break;
+        }
+    }
+    pool.waitForDone();
+
+    qCInfo(lcMain) << Q_FUNC_INFO << frames << "frames" << frameSize << "on" << threads << "threads in"
+                   << wallTime.elapsed() << "ms";
+    return ok;
+}
@@ -0,0 +1,41 @@
+#ifndef SESSIONEXPORTER_H
+#define SESSIONEXPORTER_H
+
+#include <QString>
+#include <QSize>
+#include <QByteArray>
+#include <QThread>
+#include <QSharedPointer>
+
+class Mode;
+class QImage;
+class Renderer;
+class PacingSchedule;
+struct SessionExporterData;
+
+/*!
+ * \brief The SessionExporter class Renders a breathing session to a video file without any window
+ *  Every frame only depends on its session time, so frames are rendered and encoded on a thread
+ *  pool and handed to the writer through a bounded reorder buffer that restores their order.
+ *  The output format follows the file suffix: .y4m writes one raw YUV 4:2:0 stream, .png writes
+ *  a numbered PNG sequence next to the given path.
+ */
+class SessionExporter
+{
+public:
+    SessionExporter(Mode *firstMode, const Renderer *settings = nullptr);
+    ~SessionExporter();
+
+    void setSchedule(QSharedPointer<const PacingSchedule> schedule);
+
+    bool run(const QString &path, const QSize &size, quint8 fps, qint64 durationMS,
+             int threads = QThread::idealThreadCount());
+
+    static QByteArray toYuv420(const QImage &image);
+
+private:
+    SessionExporterData *d;
+    Q_DISABLE_COPY(SessionExporter)
+};
+
+#endif // SESSIONEXPORTER_H
@@ -0,0 +1,229 @@
+#include "sessionstats.h"
+#include "eventlog.h"
+#include "mode.h"
+#include "logging.h"
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QRunnable>
+
+namespace
+{
+const quint32 CHECKPOINT_MAGIC = 0x42535453; // "BSTS"
+const quint32 CHECKPOINT_VERSION = 1;
+const int RATE_DAYS = 30; ///< Days the typical breath rate is taken over
+
+/*!
+ * \brief accumulate Add the aggregates of one day to a sum over days
+ */
+void accumulate(SessionStats::Day &sum, const SessionStats::Day &day)
+{
+    sum.sessions += day.sessions;
+    sum.cycles += day.cycles;
+    sum.guidedMS += day.guidedMS;
+    sum.adherenceSum += day.adherenceSum;
+    sum.adherenceSamples += day.adherenceSamples;
+}
+
+/*!
+ * \brief writeCheckpoint Save aggregates, replacing the previous checkpoint atomically
+ * \return
+ */
+bool writeCheckpoint(const QString &path, const QMap<qint64, SessionStats::Day> &days, quint64 lastSequence)
+{
+    QSaveFile out(path);
+    if (!out.open(QIODevice::WriteOnly)) return false;
+    QDataStream stream(&out);
+    stream << CHECKPOINT_MAGIC << CHECKPOINT_VERSION << lastSequence << quint32(days.size());
+    for (auto it = days.constBegin(); it != days.constEnd(); ++it)
+        stream << it.key() << it->sessions << it->cycles << it->guidedMS << it->adherenceSum << it->adherenceSamples;
+    if (!out.commit())
+    {
+        qCWarning(lcMain) << "Stats: cannot write" << path;
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief The CheckpointWriter class Writes a snapshot of the aggregates on a worker thread
+ */
+class CheckpointWriter : public QRunnable
+{
+public:
+    CheckpointWriter(const QString &path, const QMap<qint64, SessionStats::Day> &days, quint64 lastSequence)
+        : path(path), days(days), lastSequence(lastSequence) {}
+
+    void run() override
+    {
+        writeCheckpoint(path, days, lastSequence);
+    }
+
+private:
+    QString path;
+    QMap<qint64, SessionStats::Day> days; ///< Implicitly shared, the copy is made when the next event changes a day
+    quint64 lastSequence;
+};
+}
+
+/*!
+ * \brief SessionStats::SessionStats Constructor, empty until open()
+ */
+SessionStats::SessionStats()
+{
+    writer.setMaxThreadCount(1);
+}
+
+/*!
+ * \brief SessionStats::~SessionStats Destructor, waits for the queued checkpoints and saves what is not saved yet
+ */
+SessionStats::~SessionStats()
+{
+    writer.waitForDone();
+    if (sinceCheckpoint) checkpoint();
+}
+
+/*!
+ * \brief SessionStats::open Load the checkpoint of a log directory and catch up with the events after it
+ * \param dir Event log directory
+ * \return False when the checkpoint could not be written
+ */
+bool SessionStats::open(const QString &dir)
+{
+    writer.waitForDone();
+    days.clear();
+    lastSequence = 0;
+    sinceCheckpoint = 0;
+    path.clear();
+    QString file = QDir(dir).filePath("stats.ckpt");
+
+    QFile in(file);
+    if (in.open(QIODevice::ReadOnly))
+    {
+        QDataStream stream(&in);
+        quint32 magic, version, count;
+        quint64 sequence;
+        stream >> magic >> version >> sequence >> count;
+        if (magic == CHECKPOINT_MAGIC && version == CHECKPOINT_VERSION && stream.status() == QDataStream::Ok)
+        {
+            for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++)
+            {
+                qint64 julian;
+                Day day;
+                stream >> julian >> day.sessions >> day.cycles >> day.guidedMS >> day.adherenceSum >> day.adherenceSamples;
+                days.insert(julian, day);
+            }
+            if (stream.status() == QDataStream::Ok) lastSequence = sequence;
+            else days.clear();
+        }
+    }
+
+    // Checkpoints are only written once caught up, a replay of months is saved once at the end
+    quint64 loaded = lastSequence;
+    EventLog::read(dir, lastSequence + 1, [this](const EventRecord &record) { add(record); });
+    path = file;
+    qCInfo(lcMain) << "Stats:" << days.size() << "days from the checkpoint at" << loaded
+                   << "and" << lastSequence - loaded << "events after it";
+    return sinceCheckpoint ? checkpoint() : true;
+}
+
+/*!
+ * \brief SessionStats::add Fold one event into the aggregate of its day
+ *  Events up to the last one already included are ignored, so replaying is harmless.
+ * \param record
+ */
+void SessionStats::add(const EventRecord &record)
+{
+    if (record.sequence <= lastSequence) return;
+    lastSequence = record.sequence;
+    Day &day = days[QDateTime::fromMSecsSinceEpoch(record.timeMS).date().toJulianDay()];
+    switch (record.type)
+    {
+    case EventLog::SessionStarted:
+        day.sessions++;
+        break;
+    case EventLog::Phase:
+        if (record.mode == Modes::Inhale) day.cycles++;
+        day.guidedMS += record.arg;
+        break;
+    case EventLog::Adherence:
+        day.adherenceSum += record.value;
+        day.adherenceSamples++;
+        break;
+    }
+    if (++sinceCheckpoint >= CHECKPOINT_EVENTS && !path.isEmpty()) checkpointLater();
+}
+
+/*!
+ * \brief SessionStats::checkpoint Save the aggregates now, replacing the previous checkpoint atomically
+ *  Waits for the queued checkpoints first, so an older snapshot cannot replace this one.
+ * \return
+ */
+bool SessionStats::checkpoint()
+{
+    if (path.isEmpty()) return false;
+    writer.waitForDone();
+    if (!writeCheckpoint(path, days, lastSequence)) return false;
+    sinceCheckpoint = 0;
+    return true;
+}
+
+/*!
+ * \brief SessionStats::checkpointLater Queue a snapshot of the aggregates for the writer thread
+ *  The snapshot shares the days until the next event changes one, so queueing costs no copy.
+ */
+void SessionStats::checkpointLater()
+{
+    writer.start(new CheckpointWriter(path, days, lastSequence));
+    sinceCheckpoint = 0;
+}
+
+/*!
+ * \brief SessionStats::streak Days in a row with at least one cycle, up to today
+ *  A day without cycles yet does not break the streak before it is over.
+ * \param today
+ * \return
+ */
+int SessionStats::streak(const QDate &today) const
+{
+    qint64 day = today.toJulianDay();
+    if (days.value(day).cycles == 0) day--;
+    int count = 0;
+    while (days.value(day).cycles > 0)
+    {
+        count++;
+        day--;
+    }
+    return count;
+}
+
+/*!
+ * \brief SessionStats::summary Text for the stats pane of the Dialog
+ * \param today
+ * \return
+ */
+QString SessionStats::summary(const QDate &today) const
+{
+    qint64 now = today.toJulianDay();
+    Day total, week, recent;
+    for (auto it = days.constBegin(); it != days.constEnd(); ++it)
+    {
+        qint64 age = now - it.key();
+        accumulate(total, *it);
+        if (age >= 0 && age < 7) accumulate(week, *it);
+        if (age >= 0 && age < RATE_DAYS) accumulate(recent, *it);
+    }
+    Day day = days.value(now);
+
+    QString text = QString("Today: %1 cycles, %2 min\n").arg(day.cycles).arg(day.guidedMS / 60000);
+    text += QString("Last 7 days: %1 cycles, %2 min").arg(week.cycles).arg(week.guidedMS / 60000);
+    if (week.adherenceSamples)
+        text += QString(", %1% in step").arg(qRound(100 * week.adherenceSum / week.adherenceSamples));
+    text += QString("\nStreak: %1 days").arg(streak(today));
+    if (recent.guidedMS)
+        text += QString("    Typical rate: %1 breaths/min").arg(recent.cycles * 60000.0 / recent.guidedMS, 0, 'f', 1);
+    text += QString("    Total: %1 h in %2 sessions").arg(total.guidedMS / 3600000.0, 0, 'f', 1).arg(total.sessions);
+    return text;
+}
@@ -0,0 +1,56 @@
+#ifndef SESSIONSTATS_H
+#define SESSIONSTATS_H
+
+#include <QMap>
+#include <QString>
+#include <QDate>
+#include <QThreadPool>
+
+struct EventRecord;
+
+/*!
+ * \brief The SessionStats class Per-day aggregates of the event log, kept up to date event by event
+ *  Every event only updates the aggregate of its day. The aggregates are checkpointed next to
+ *  the log together with the last sequence they include, so opening replays only the events
+ *  recorded after the checkpoint and every statistic is computed from days, never from events.
+ *  The periodic checkpoints are written by a worker from a snapshot of the days, so the file
+ *  system's flush never holds up the thread recording the events.
+ */
+class SessionStats
+{
+public:
+    static const quint32 CHECKPOINT_EVENTS = 256; ///< Events between two checkpoints
+
+    /*!
+     * \brief The Day struct Aggregates of one local calendar day
+     */
+    struct Day
+    {
+        quint32 sessions = 0;
+        quint32 cycles = 0;          ///< Inhale phases started
+        quint64 guidedMS = 0;        ///< Length of the phases started
+        double  adherenceSum = 0;
+        quint32 adherenceSamples = 0;
+    };
+
+    SessionStats();
+    ~SessionStats();
+
+    bool open(const QString &dir);
+    void add(const EventRecord &record);
+    bool checkpoint();
+
+    QString summary(const QDate &today = QDate::currentDate()) const;
+    int streak(const QDate &today = QDate::currentDate()) const;
+
+private:
+    QMap<qint64, Day> days;   ///< By Julian day
+    QString path;             ///< Checkpoint file, empty until open()
+    quint64 lastSequence = 0; ///< Last event included in the aggregates
+    quint32 sinceCheckpoint = 0;
+    QThreadPool writer;       ///< Writes the periodic checkpoints one at a time, in order
+    void checkpointLater();
+    Q_DISABLE_COPY(SessionStats)
+};
+
+#endif // SESSIONSTATS_H
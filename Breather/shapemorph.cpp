@@ -0,0 +1,104 @@
+#include "shapemorph.h"
+#include "renderer.h"
+#include <QHash>
+#include <QMutex>
+#include <QPainterPath>
+#include <QtMath>
+#include <algorithm>
+
+namespace
+{
+QHash<quint8,ShapeMorph::Outline> outlines; ///< Unit outlines by shape, never removed so references stay valid
+QMutex outlinesMutex;
+
+/// Size the shape paths are built at before resampling, large enough for smooth curves
+const int RESAMPLE_PX = 512;
+
+/*!
+ * \brief resample Walk a shape path by arc length and store POINTS unit points, aligned for morphing
+ */
+ShapeMorph::Outline resample(quint8 shape)
+{
+    QPainterPath path = Renderer::shapePath(QRect(0, 0, RESAMPLE_PX, RESAMPLE_PX), shape);
+    QVector<QPointF> points(ShapeMorph::POINTS);
+    for (int i = 0; i < ShapeMorph::POINTS; i++)
+        points[i] = path.isEmpty() ? QPointF() : path.pointAtPercent(qreal(i) / ShapeMorph::POINTS) / RESAMPLE_PX;
+
+    // Same winding for every shape: reverse clockwise outlines (shoelace area, y pointing down)
+    qreal area = 0;
+    for (int i = 0; i < points.size(); i++)
+    {
+        const QPointF &a = points[i], &b = points[(i+1) % points.size()];
+        area += a.x()*b.y() - b.x()*a.y();
+    }
+    if (area > 0) std::reverse(points.begin(), points.end());
+
+    // Same start for every shape: the point closest to straight up from the centre
+    int start = 0;
+    qreal best = 4;
+    for (int i = 0; i < points.size(); i++)
+    {
+        qreal angle = qAbs(qAtan2(points[i].x() - 0.5, 0.5 - points[i].y()));
+        if (angle < best)
+        {
+            best = angle;
+            start = i;
+        }
+    }
+    std::rotate(points.begin(), points.begin() + start, points.end());
+
+    ShapeMorph::Outline outline;
+    outline.x.resize(ShapeMorph::POINTS);
+    outline.y.resize(ShapeMorph::POINTS);
+    for (int i = 0; i < ShapeMorph::POINTS; i++)
+    {
+        outline.x[i] = float(points[i].x());
+        outline.y[i] = float(points[i].y());
+    }
+    return outline;
+}
+
+}
+
+/*!
+ * \brief ShapeMorph::outline Unit outline of a shape, resampled on first use
+ * \param shape
+ * \return Stays valid for the life time of the process
+ */
+const ShapeMorph::Outline &ShapeMorph::outline(quint8 shape)
+{
+    QMutexLocker lock(&outlinesMutex);
+    auto found = outlines.find(shape);
+    if (found == outlines.end()) found = outlines.insert(shape, resample(shape));
+    return *found;
+}
+
+/*!
+ * \brief ShapeMorph::interpolate Place both outlines on their rects and blend them
+ *  Both placements and the blend fold into x = a*from.x + b*to.x + c per point.
+ * \param from
+ * \param fromRect
+ * \param to
+ * \param toRect
+ * \param t 0 gives the from outline, 1 the to outline
+ * \param out Reused between frames, resized only once
+ */
+void ShapeMorph::interpolate(const Outline &from, const QRectF &fromRect,
+                             const Outline &to, const QRectF &toRect, float t, QPolygonF &out)
+{
+    const float s = 1 - t;
+    const float ax = s*fromRect.width(),  bx = t*toRect.width(),  cx = s*fromRect.x() + t*toRect.x();
+    const float ay = s*fromRect.height(), by = t*toRect.height(), cy = s*fromRect.y() + t*toRect.y();
+    const float *fx = from.x.constData(), *fy = from.y.constData();
+    const float *tx = to.x.constData(),   *ty = to.y.constData();
+    float x[POINTS], y[POINTS];
+    for (int i = 0; i < POINTS; i++)
+    {
+        x[i] = ax*fx[i] + bx*tx[i] + cx;
+        y[i] = ay*fy[i] + by*ty[i] + cy;
+    }
+    out.resize(POINTS);
+    QPointF *points = out.data();
+    for (int i = 0; i < POINTS; i++)
+        points[i] = QPointF(x[i], y[i]);
+}
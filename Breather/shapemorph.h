@@ -0,0 +1,34 @@
+#ifndef SHAPEMORPH_H
+#define SHAPEMORPH_H
+
+#include <QVector>
+#include <QRectF>
+#include <QPolygonF>
+
+/*!
+ * \brief The ShapeMorph class Morph the outline of one shape into another
+ *  Every shape's outline is resampled once into POINTS points of a unit square, evenly spaced by
+ *  arc length, counter-clockwise, starting at the point nearest to the top centre. With matching
+ *  point counts and start points a morph is just a per-point lerp between two outlines placed on
+ *  their rects, which reduces to one multiply-add per coordinate and draws as a single polygon.
+ */
+class ShapeMorph
+{
+public:
+    static const int POINTS = 128;
+
+    /*!
+     * \brief The Outline struct Unit outline in structure-of-arrays layout, so the lerp loop vectorizes
+     */
+    struct Outline
+    {
+        QVector<float> x;
+        QVector<float> y;
+    };
+
+    static const Outline &outline(quint8 shape);
+    static void interpolate(const Outline &from, const QRectF &fromRect,
+                            const Outline &to, const QRectF &toRect, float t, QPolygonF &out);
+};
+
+#endif // SHAPEMORPH_H
@@ -0,0 +1,35 @@
+#ifndef SHAPEPROVIDER_H
+#define SHAPEPROVIDER_H
+
+#include <QtPlugin>
+#include <QString>
+#include <QSize>
+#include <QPainterPath>
+
+/*!
+ * \brief The ShapeProvider class Interface for shapes beyond the built-in ellipse and rectangles
+ *  A provider only describes geometry. ShapeRegistry calls path() once per quantized size bucket
+ *  and caches the result, so a provider may build paths as complex as it likes.
+ *  Plugins implement it in a QObject with Q_PLUGIN_METADATA(IID ShapeProvider_iid) and
+ *  Q_INTERFACES(ShapeProvider), and are loaded from the "shapes" directory next to the binary.
+ */
+class ShapeProvider
+{
+public:
+    virtual ~ShapeProvider() {}
+
+    /*!
+     * \brief name Unique name, shown in the settings dialog and stored in the config file
+     */
+    virtual QString name() const = 0;
+
+    /*!
+     * \brief path Outline of the shape filling the rect (0,0) - (size.width(), size.height())
+     */
+    virtual QPainterPath path(const QSize &size) const = 0;
+};
+
+#define ShapeProvider_iid "org.breather.ShapeProvider/1.0"
+Q_DECLARE_INTERFACE(ShapeProvider, ShapeProvider_iid)
+
+#endif // SHAPEPROVIDER_H
@@ -0,0 +1,317 @@
+#include "shaperegistry.h"
+#include "shapeprovider.h"
+#include "artworkcache.h"
+#include "mode.h"
+#include "logging.h"
+#include <QPainter>
+#include <QPluginLoader>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QtMath>
+
+namespace
+{
+
+/*!
+ * \brief The StarShape class Five pointed star
+ */
+class StarShape : public ShapeProvider
+{
+public:
+    QString name() const override { return "Star"; }
+    QPainterPath path(const QSize &size) const override
+    {
+        QPainterPath path;
+        QPointF centre(size.width()/2.0, size.height()/2.0);
+        for (int i = 0; i < 10; i++)
+        {
+            qreal radius = (i % 2) ? 0.4 : 1.0;
+            qreal angle = -M_PI/2 + i*M_PI/5;
+            QPointF point(centre.x() + radius*centre.x()*qCos(angle), centre.y() + radius*centre.y()*qSin(angle));
+            if (i == 0) path.moveTo(point);
+            else path.lineTo(point);
+        }
+        path.closeSubpath();
+        return path;
+    }
+};
+
+/*!
+ * \brief The WaveShape class Rect with a wavy top edge
+ */
+class WaveShape : public ShapeProvider
+{
+public:
+    QString name() const override { return "Wave"; }
+    QPainterPath path(const QSize &size) const override
+    {
+        const int waves = 3;
+        qreal w = size.width(), h = size.height(), amplitude = h*0.1, step = w/(2*waves);
+        QPainterPath path(QPointF(0, h));
+        path.lineTo(0, amplitude);
+        for (int i = 0; i < 2*waves; i++)
+            path.quadTo(step*i + step/2, (i % 2) ? 2*amplitude : 0, step*(i+1), amplitude);
+        path.lineTo(w, h);
+        path.closeSubpath();
+        return path;
+    }
+};
+
+/*!
+ * \brief The ArtworkShape class SVG or bitmap artwork; its outline is the rect it is drawn in
+ */
+class ArtworkShape : public ShapeProvider
+{
+public:
+    ArtworkShape(const QString &name, ArtworkCache *cache) : shapeName(name), cache(cache) {}
+    QString name() const override { return shapeName; }
+    QPainterPath path(const QSize &size) const override
+    {
+        QPainterPath path;
+        path.addRect(0, 0, size.width(), size.height());
+        return path;
+    }
+    QString shapeName;
+    ArtworkCache *cache;
+};
+
+/// Memory each artwork's mip levels may take
+const qint64 ARTWORK_BUDGET_BYTES = 16*1024*1024;
+
+QList<ShapeProvider*> providers;       ///< Index i is shape Shape::FirstCustom + i
+QHash<quint8,ArtworkCache*> artwork;   ///< Artwork shapes, drawn from their raster cache instead of a path
+/*!
+ * \brief The CachedPath struct Outline of one shape bucket and when it was last used
+ */
+struct CachedPath
+{
+    QPainterPath path;
+    quint64 lastUse = 0;
+};
+
+QHash<quint32,CachedPath> pathCache;   ///< Key: shape, bucket width and bucket height
+QMutex cacheMutex;
+quint64 pathUseCounter = 0;
+const int MAX_CACHED_PATHS = 512;      ///< Beyond this the least recently used path is dropped, a window size change can leave many stale buckets
+
+/*!
+ * \brief addBuiltins Register the shapes shipped with the binary the first time the registry is used
+ */
+void addBuiltins()
+{
+    static bool added = false;
+    if (added) return;
+    added = true;
+    providers.append(new StarShape);
+    providers.append(new WaveShape);
+}
+
+}
+
+/*!
+ * \brief ShapeRegistry::add Register a provider, the registry keeps it for the life time of the process
+ * \param provider
+ * \return Shape number to store in a Mode, or Shape::Ellipse if no number is left
+ */
+quint8 ShapeRegistry::add(ShapeProvider *provider)
+{
+    addBuiltins();
+    if (!provider || Shape::FirstCustom + providers.size() > 0xFF) return Shape::Ellipse;
+    providers.append(provider);
+    qCInfo(lcMain) << Q_FUNC_INFO << provider->name();
+    return Shape::FirstCustom + providers.size() - 1;
+}
+
+/*!
+ * \brief ShapeRegistry::loadPlugins Register every ShapeProvider plugin found in a directory
+ * \param directory
+ * \return Number of providers added
+ */
+int ShapeRegistry::loadPlugins(const QString &directory)
+{
+    int count = 0;
+    QDir dir(directory);
+    for (const QString &file : dir.entryList(QDir::Files, QDir::Name))
+    {
+        QPluginLoader loader(dir.absoluteFilePath(file));
+        ShapeProvider *provider = qobject_cast<ShapeProvider*>(loader.instance());
+        if (!provider)
+        {
+            qCWarning(lcMain) << Q_FUNC_INFO << file << loader.errorString();
+            continue;
+        }
+        add(provider);
+        count++;
+    }
+    return count;
+}
+
+/*!
+ * \brief ShapeRegistry::loadArtwork Register every .svg and bitmap found in a directory as a shape named after the file
+ * \param directory
+ * \return Number of shapes added
+ */
+int ShapeRegistry::loadArtwork(const QString &directory)
+{
+    int count = 0;
+    QDir dir(directory);
+    for (const QString &file : dir.entryList({"*.svg", "*.png", "*.jpg"}, QDir::Files, QDir::Name))
+    {
+        ArtworkCache *cache = new ArtworkCache(dir.absoluteFilePath(file), ARTWORK_BUDGET_BYTES);
+        if (!cache->isValid())
+        {
+            delete cache;
+            continue;
+        }
+        quint8 shape = add(new ArtworkShape(QFileInfo(file).completeBaseName(), cache));
+        if (shape == Shape::Ellipse) break;
+        artwork.insert(shape, cache);
+        count++;
+    }
+    return count;
+}
+
+/*!
+ * \brief ShapeRegistry::customShapes
+ * \return Numbers of all registered shapes
+ */
+QList<quint8> ShapeRegistry::customShapes()
+{
+    addBuiltins();
+    QList<quint8> shapes;
+    for (int i = 0; i < providers.size(); i++)
+        shapes.append(Shape::FirstCustom + i);
+    return shapes;
+}
+
+/*!
+ * \brief ShapeRegistry::provider
+ * \param shape
+ * \return nullptr for built-in or unknown shapes
+ */
+ShapeProvider *ShapeRegistry::provider(quint8 shape)
+{
+    addBuiltins();
+    int index = shape - Shape::FirstCustom;
+    return (index >= 0 && index < providers.size()) ? providers.at(index) : nullptr;
+}
+
+/*!
+ * \brief ShapeRegistry::name
+ * \param shape
+ * \return Empty for built-in or unknown shapes
+ */
+QString ShapeRegistry::name(quint8 shape)
+{
+    ShapeProvider *p = provider(shape);
+    return p ? p->name() : QString();
+}
+
+/*!
+ * \brief ShapeRegistry::find Shape number of a provider by name, numbers can change when plugins are added
+ * \param name
+ * \return Shape::Ellipse if there is no such provider
+ */
+quint8 ShapeRegistry::find(const QString &name)
+{
+    addBuiltins();
+    for (int i = 0; i < providers.size(); i++)
+        if (providers.at(i)->name() == name) return Shape::FirstCustom + i;
+    return Shape::Ellipse;
+}
+
+/*!
+ * \brief ShapeRegistry::isArtwork Whether a shape is drawn from an image rather than filled
+ * \param shape
+ * \return
+ */
+bool ShapeRegistry::isArtwork(quint8 shape)
+{
+    return artwork.contains(shape);
+}
+
+/*!
+ * \brief ShapeRegistry::bucket Round a size up to the size bucket its path is cached for
+ * \param size
+ * \return
+ */
+QSize ShapeRegistry::bucket(const QSize &size)
+{
+    auto up = [](int v) { return qMax(BUCKET_PX, (v + BUCKET_PX - 1) / BUCKET_PX * BUCKET_PX); };
+    return QSize(up(size.width()), up(size.height()));
+}
+
+/*!
+ * \brief ShapeRegistry::path Cached outline of a shape for a size bucket, built on first use
+ *  A full cache drops its least recently used path, so the buckets of the running cycle stay.
+ * \param shape
+ * \param bucket A size returned by bucket()
+ * \return Empty for built-in or unknown shapes
+ */
+QPainterPath ShapeRegistry::path(quint8 shape, const QSize &bucket)
+{
+    ShapeProvider *p = provider(shape);
+    if (!p) return QPainterPath();
+    quint32 key = quint32(shape) << 24 | quint32(bucket.width()/BUCKET_PX & 0xFFF) << 12 | quint32(bucket.height()/BUCKET_PX & 0xFFF);
+    QMutexLocker lock(&cacheMutex);
+    auto cached = pathCache.find(key);
+    if (cached != pathCache.end())
+    {
+        cached->lastUse = ++pathUseCounter;
+        return cached->path;
+    }
+    if (pathCache.size() >= MAX_CACHED_PATHS)
+    {
+        auto oldest = pathCache.begin();
+        for (auto it = pathCache.begin(); it != pathCache.end(); ++it)
+            if (it->lastUse < oldest->lastUse) oldest = it;
+        pathCache.erase(oldest);
+    }
+    CachedPath built;
+    built.path = p->path(bucket);
+    built.lastUse = ++pathUseCounter;
+    pathCache.insert(key, built);
+    return built.path;
+}
+
+/*!
+ * \brief ShapeRegistry::path Outline of a shape placed on a rect, for clipping and region math
+ * \param shape
+ * \param xywh
+ * \return
+ */
+QPainterPath ShapeRegistry::path(quint8 shape, const QRect &xywh)
+{
+    QSize size = bucket(xywh.size());
+    QTransform toRect;
+    toRect.translate(xywh.x(), xywh.y());
+    toRect.scale(qreal(xywh.width())/size.width(), qreal(xywh.height())/size.height());
+    return toRect.map(path(shape, size));
+}
+
+/*!
+ * \brief ShapeRegistry::draw Draw a custom shape with the painter's pen and brush
+ *  The cached bucket path is scaled onto the rect by the painter instead of being rebuilt.
+ * \param qp
+ * \param xywh
+ * \param shape
+ */
+void ShapeRegistry::draw(QPainter &qp, const QRect &xywh, quint8 shape)
+{
+    if (xywh.isEmpty()) return;
+    if (ArtworkCache *cache = artwork.value(shape))
+    {
+        cache->draw(qp, xywh);
+        return;
+    }
+    QSize size = bucket(xywh.size());
+    QPainterPath outline = path(shape, size);
+    if (outline.isEmpty()) return;
+    qp.save();
+    qp.translate(xywh.topLeft());
+    qp.scale(qreal(xywh.width())/size.width(), qreal(xywh.height())/size.height());
+    qp.drawPath(outline);
+    qp.restore();
+}
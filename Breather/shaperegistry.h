@@ -0,0 +1,40 @@
+#ifndef SHAPEREGISTRY_H
+#define SHAPEREGISTRY_H
+
+#include <QList>
+#include <QRect>
+#include <QPainterPath>
+
+class QPainter;
+class ShapeProvider;
+
+/*!
+ * \brief The ShapeRegistry class Custom shapes, numbered from Shape::FirstCustom on
+ *  Paths are cached per shape and size bucket: a size is rounded up to the next multiple of
+ *  BUCKET_PX and the cached path is scaled onto the exact rect by the painter, so an animated
+ *  shape only builds a new path every few pixels of growth and never while it stays the same size.
+ *  When full, the least recently used path is dropped. The cache is shared by the GUI, export
+ *  and cycle cache threads and guarded by a mutex.
+ */
+class ShapeRegistry
+{
+public:
+    static const int BUCKET_PX = 8;
+
+    static quint8 add(ShapeProvider *provider);
+    static int loadPlugins(const QString &directory);
+    static int loadArtwork(const QString &directory);
+
+    static QList<quint8> customShapes();
+    static ShapeProvider *provider(quint8 shape);
+    static QString name(quint8 shape);
+    static quint8 find(const QString &name);
+    static bool isArtwork(quint8 shape);
+
+    static QSize bucket(const QSize &size);
+    static QPainterPath path(quint8 shape, const QSize &bucket);
+    static QPainterPath path(quint8 shape, const QRect &xywh);
+    static void draw(QPainter &qp, const QRect &xywh, quint8 shape);
+};
+
+#endif // SHAPEREGISTRY_H
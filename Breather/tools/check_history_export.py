@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Round-trip check of a history export against the event log it came from.
+
+    Breather --event-log <dir> --export-history history.parquet
+    Breather --dump-events <dir> > events.tsv
+    python3 check_history_export.py history.parquet events.tsv
+
+Loads the Parquet file with the installed pyarrow and compares every row with
+the tab separated dump. Without a dump it only loads the file and prints its
+schema and row groups. Exits non-zero on the first mismatch.
+"""
+import datetime
+import sys
+
+import pyarrow.parquet as pq
+
+PHASES = {0: "inhale", 1: "hold-in", 2: "exhale", 3: "hold-out"}
+PHASED = {"phase", "adherence"}
+
+
+def dump_rows(path):
+    with open(path, encoding="utf-8") as dump:
+        for line in dump:
+            if line.startswith("#"):
+                continue
+            sequence, time, event, mode, value, arg = line.rstrip("\n").split("\t")
+            ms = round(datetime.datetime.fromisoformat(time).timestamp() * 1000)
+            yield int(sequence), ms, event, int(mode), float(value), int(arg)
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__)
+    parquet = pq.ParquetFile(sys.argv[1])
+    print(parquet.schema_arrow)
+    for group in range(parquet.num_row_groups):
+        meta = parquet.metadata.row_group(group)
+        print("row group %d: %d rows, %d bytes" % (group, meta.num_rows, meta.total_byte_size))
+    if len(sys.argv) == 2:
+        return
+
+    table = parquet.read()
+    times = table.column("time").cast("int64").to_pylist()
+    events = table.column("event").to_pylist()
+    phases = table.column("phase").to_pylist()
+    lengths = table.column("length_ms").to_pylist()
+    values = table.column("value").to_pylist()
+
+    count = 0
+    for row, (sequence, ms, event, mode, value, arg) in enumerate(dump_rows(sys.argv[2])):
+        if row >= table.num_rows:
+            sys.exit("export ends before event %d" % sequence)
+        phase = PHASES.get(mode, "") if event in PHASED else ""
+        got = (times[row], events[row], phases[row], lengths[row])
+        if got != (ms, event, phase, arg) or abs(values[row] - value) > 1e-5 * max(1.0, abs(value)):
+            sys.exit("event %d differs: %r, expected %r" % (sequence, got + (values[row],), (ms, event, phase, arg, value)))
+        count += 1
+    if count != table.num_rows:
+        sys.exit("export has %d rows, the log %d events" % (table.num_rows, count))
+    print("%d events match" % count)
+
+
+if __name__ == "__main__":
+    main()
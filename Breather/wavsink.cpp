@@ -0,0 +1,123 @@
+#include "wavsink.h"
+#include "logging.h"
+#include <QThread>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QVector>
+#include <cstring>
+#include <atomic>
+
+/*!
+ * \brief The WavWriter class Pulls frames at the sample rate and appends them to the file
+ */
+class WavWriter : public QThread
+{
+public:
+    QFile file;
+    AudioStream *stream = nullptr;
+    std::atomic<bool> running {true};
+    quint64 written = 0; ///< Frames in the file
+
+    static const quint32 TICK_MS = 5;
+
+    /*!
+     * \brief header Canonical 44 byte header of a mono 16 bit PCM file
+     */
+    static QByteArray header(quint64 frames)
+    {
+        QByteArray out(44, 0);
+        char *h = out.data();
+        quint32 dataBytes = quint32(frames * 2);
+        memcpy(h, "RIFF", 4);
+        qToLittleEndian<quint32>(36 + dataBytes, h + 4);
+        memcpy(h + 8, "WAVEfmt ", 8);
+        qToLittleEndian<quint32>(16, h + 16);
+        qToLittleEndian<quint16>(1, h + 20);                             // PCM
+        qToLittleEndian<quint16>(1, h + 22);                             // mono
+        qToLittleEndian<quint32>(AudioSink::SAMPLE_RATE, h + 24);
+        qToLittleEndian<quint32>(AudioSink::SAMPLE_RATE * 2, h + 28);    // bytes per second
+        qToLittleEndian<quint16>(2, h + 32);                             // bytes per frame
+        qToLittleEndian<quint16>(16, h + 34);
+        memcpy(h + 36, "data", 4);
+        qToLittleEndian<quint32>(dataBytes, h + 40);
+        return out;
+    }
+
+protected:
+    void run() override
+    {
+        QElapsedTimer clock;
+        clock.start();
+        QVector<qint16> block;
+        while (running.load(std::memory_order_acquire))
+        {
+            quint64 due = quint64(clock.nsecsElapsed()) * AudioSink::SAMPLE_RATE / 1000000000;
+            if (due > written)
+            {
+                block.resize(int(due - written));
+                AudioSink::pull(stream, block.data(), quint32(block.size()));
+                for (qint16 &sample : block) sample = qToLittleEndian(sample);
+                file.write(reinterpret_cast<const char*>(block.constData()), block.size() * 2);
+                written = due;
+            }
+            msleep(TICK_MS);
+        }
+    }
+};
+
+/*!
+ * \brief WavSink::WavSink Constructor
+ * \param path File to write, replaced if it exists
+ */
+WavSink::WavSink(const QString &path)
+    : path(path)
+{
+}
+
+/*!
+ * \brief WavSink::~WavSink Destructor, finishes the file
+ */
+WavSink::~WavSink()
+{
+    stop();
+}
+
+/*!
+ * \brief WavSink::start Open the file and start taking frames
+ * \param stream
+ * \return False when the file cannot be written
+ */
+bool WavSink::start(AudioStream *stream)
+{
+    stop();
+    writer = new WavWriter;
+    writer->stream = stream;
+    writer->file.setFileName(path);
+    if (!writer->file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        qCWarning(lcMain) << "Audio file could not be written" << path << writer->file.errorString();
+        delete writer;
+        writer = nullptr;
+        return false;
+    }
+    writer->file.write(WavWriter::header(0));
+    writer->start(QThread::TimeCriticalPriority);
+    return true;
+}
+
+/*!
+ * \brief WavSink::stop Stop taking frames and fill in the sizes in the header
+ */
+void WavSink::stop()
+{
+    if (!writer) return;
+    writer->running.store(false, std::memory_order_release);
+    writer->wait();
+    writer->file.seek(0);
+    writer->file.write(WavWriter::header(writer->written));
+    writer->file.close();
+    qCInfo(lcMain) << "Audio written to" << path << writer->written << "frames";
+    delete writer;
+    writer = nullptr;
+}
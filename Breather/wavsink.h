@@ -0,0 +1,30 @@
+#ifndef WAVSINK_H
+#define WAVSINK_H
+
+#include "audiosink.h"
+#include <QString>
+
+class WavWriter;
+
+/*!
+ * \brief The WavSink class Plays into a WAV file in real time, like a sound device without latency
+ *  Frames are taken at the pace of a monotonic clock, so what ends up in the file is what a device
+ *  would have played, underruns included. Cue sample positions can then be checked against the
+ *  session clock without any audio hardware.
+ */
+class WavSink : public AudioSink
+{
+public:
+    WavSink(const QString &path);
+    ~WavSink() override;
+
+    bool start(AudioStream *stream) override;
+    void stop() override;
+
+private:
+    QString path;
+    WavWriter *writer = nullptr;
+    Q_DISABLE_COPY(WavSink)
+};
+
+#endif // WAVSINK_H
@@ -0,0 +1,169 @@
+#include "wavsource.h"
+#include "logging.h"
+#include <QThread>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <QVector>
+#include <atomic>
+
+/*!
+ * \brief The WavReader class Feeds the samples of the data chunk into the stream
+ */
+class WavReader : public QThread
+{
+public:
+    QFile file;
+    AudioStream *stream = nullptr;
+    quint32 rate = 0;
+    quint16 channels = 1;
+    qint64 dataLeft = 0;   ///< Bytes of the data chunk not read yet
+    bool paced = true;
+    std::atomic<bool> running {true};
+    std::atomic<bool> finished {false};
+
+    static const quint32 TICK_MS = 5;
+
+    /*!
+     * \brief open Check the format and move to the start of the samples
+     * \return
+     */
+    bool open()
+    {
+        if (!file.open(QIODevice::ReadOnly)) return false;
+        QByteArray riff = file.read(12);
+        if (riff.size() < 12 || !riff.startsWith("RIFF") || riff.mid(8, 4) != "WAVE") return false;
+        bool format = false;
+        while (!file.atEnd())
+        {
+            QByteArray chunk = file.read(8);
+            if (chunk.size() < 8) return false;
+            quint32 size = qFromLittleEndian<quint32>(chunk.constData() + 4);
+            if (chunk.startsWith("fmt "))
+            {
+                QByteArray fmt = file.read(size + (size & 1));
+                if (fmt.size() < 16) return false;
+                quint16 type = qFromLittleEndian<quint16>(fmt.constData());
+                channels = qFromLittleEndian<quint16>(fmt.constData() + 2);
+                rate = qFromLittleEndian<quint32>(fmt.constData() + 4);
+                quint16 bits = qFromLittleEndian<quint16>(fmt.constData() + 14);
+                format = type == 1 && bits == 16 && channels >= 1 && rate > 0;
+                if (!format) return false;
+            }
+            else if (chunk.startsWith("data"))
+            {
+                dataLeft = size;
+                return format;
+            }
+            else file.seek(file.pos() + size + (size & 1));
+        }
+        return false;
+    }
+
+protected:
+    void run() override
+    {
+        QElapsedTimer clock;
+        clock.start();
+        quint64 sent = 0;
+        QVector<qint16> interleaved, mono;
+        const int frameBytes = 2 * channels;
+        while (running.load(std::memory_order_acquire) && dataLeft >= frameBytes)
+        {
+            quint64 due = paced ? quint64(clock.nsecsElapsed()) * rate / 1000000000 : sent + stream->ring.space();
+            quint64 frames = qMin<quint64>(due - qMin(due, sent), quint64(dataLeft / frameBytes));
+            if (frames)
+            {
+                interleaved.resize(int(frames * channels));
+                file.read(reinterpret_cast<char*>(interleaved.data()), qint64(frames) * frameBytes);
+                dataLeft -= qint64(frames) * frameBytes;
+                mono.resize(int(frames));
+                for (quint64 i = 0; i < frames; i++)
+                {
+                    qint32 sum = 0;
+                    for (quint16 c = 0; c < channels; c++) sum += qFromLittleEndian(interleaved[int(i*channels + c)]);
+                    mono[int(i)] = qint16(sum / channels);
+                }
+                // A paced source drops what the analysis has no room for, like a device would
+                quint32 taken = stream->ring.write(mono.constData(), quint32(frames));
+                if (taken < frames) stream->underrunFrames.fetch_add(frames - taken, std::memory_order_relaxed);
+                sent += frames;
+            }
+            msleep(paced ? TICK_MS : 1);
+        }
+        finished.store(true, std::memory_order_release);
+    }
+};
+
+/*!
+ * \brief WavSource::WavSource Constructor
+ * \param path
+ * \param paced Deliver at the file's sample rate instead of as fast as possible
+ */
+WavSource::WavSource(const QString &path, bool paced)
+    : path(path)
+    , paced(paced)
+{
+}
+
+/*!
+ * \brief WavSource::~WavSource Destructor
+ */
+WavSource::~WavSource()
+{
+    stop();
+}
+
+/*!
+ * \brief WavSource::start Open the file and start delivering its samples
+ * \param stream
+ * \return False when the file is not a 16 bit PCM WAV file
+ */
+bool WavSource::start(AudioStream *stream)
+{
+    stop();
+    reader = new WavReader;
+    reader->file.setFileName(path);
+    reader->stream = stream;
+    reader->paced = paced;
+    if (!reader->open())
+    {
+        qCWarning(lcBreath) << "Not a 16 bit PCM WAV file" << path;
+        delete reader;
+        reader = nullptr;
+        return false;
+    }
+    rate = reader->rate;
+    reader->start();
+    return true;
+}
+
+/*!
+ * \brief WavSource::stop
+ */
+void WavSource::stop()
+{
+    if (!reader) return;
+    reader->running.store(false, std::memory_order_release);
+    reader->wait();
+    delete reader;
+    reader = nullptr;
+}
+
+/*!
+ * \brief WavSource::sampleRate Rate of the file, known once started
+ * \return
+ */
+quint32 WavSource::sampleRate() const
+{
+    return rate;
+}
+
+/*!
+ * \brief WavSource::isFinished Whether every sample of the file has been delivered
+ * \return
+ */
+bool WavSource::isFinished() const
+{
+    return !reader || reader->finished.load(std::memory_order_acquire);
+}
@@ -0,0 +1,33 @@
+#ifndef WAVSOURCE_H
+#define WAVSOURCE_H
+
+#include "audiosource.h"
+#include <QString>
+
+class WavReader;
+
+/*!
+ * \brief The WavSource class Plays a 16 bit PCM WAV file into the stream in place of a microphone
+ *  Paced, frames arrive at the file's sample rate like from a real device. Unpaced, they arrive
+ *  as fast as the analysis takes them, for benchmarks. Stereo files are mixed down to mono.
+ */
+class WavSource : public AudioSource
+{
+public:
+    WavSource(const QString &path, bool paced = true);
+    ~WavSource() override;
+
+    bool start(AudioStream *stream) override;
+    void stop() override;
+    quint32 sampleRate() const override;
+    bool isFinished() const override;
+
+private:
+    QString path;
+    bool paced;
+    quint32 rate = 0;
+    WavReader *reader = nullptr;
+    Q_DISABLE_COPY(WavSource)
+};
+
+#endif // WAVSOURCE_H